@@ -66,3 +66,50 @@ std::string AESWrapper::decrypt(const char* cipher, unsigned int length)
 
     return decrypted;
 }
+
+
+AESStreamEncryptor::AESStreamEncryptor(const std::string& key)
+{
+    if (key.size() != 32)
+        throw std::length_error("key length must be 32 bytes");
+
+    uint8_t iv[CryptoPP::AES::BLOCKSIZE] = { 0 }; // Must match the fixed IV used by AESWrapper::encrypt
+    _cbc.SetKeyWithIV(reinterpret_cast<const uint8_t*>(key.data()), key.size(), iv);
+}
+
+AESStreamEncryptor::AESStreamEncryptor(const std::string& key, const uint8_t* iv)
+{
+    if (key.size() != 32)
+        throw std::length_error("key length must be 32 bytes");
+
+    _cbc.SetKeyWithIV(reinterpret_cast<const uint8_t*>(key.data()), key.size(), iv);
+}
+
+AESStreamEncryptor::~AESStreamEncryptor()
+{
+}
+
+size_t AESStreamEncryptor::update(const uint8_t* plain, size_t length, uint8_t* out)
+{
+    if (length % CryptoPP::AES::BLOCKSIZE != 0)
+        throw std::invalid_argument("stream update length must be a multiple of the AES block size");
+
+    _cbc.ProcessData(out, plain, length);
+    return length;
+}
+
+size_t AESStreamEncryptor::finalize(const uint8_t* plain, size_t length, uint8_t* out)
+{
+    size_t aligned = length - length % CryptoPP::AES::BLOCKSIZE;
+    _cbc.ProcessData(out, plain, aligned);
+
+    // PKCS7: always emit one padded block, a full one when the input is block aligned
+    uint8_t last[CryptoPP::AES::BLOCKSIZE];
+    size_t remainder = length - aligned;
+    uint8_t pad = static_cast<uint8_t>(CryptoPP::AES::BLOCKSIZE - remainder);
+    std::memcpy(last, plain + aligned, remainder);
+    std::memset(last + remainder, pad, pad);
+    _cbc.ProcessData(out + aligned, last, CryptoPP::AES::BLOCKSIZE);
+
+    return aligned + CryptoPP::AES::BLOCKSIZE;
+}
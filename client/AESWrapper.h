@@ -27,3 +27,25 @@ public:
     std::string encrypt(const char* plain, unsigned int length);
     std::string decrypt(const char* cipher, unsigned int length);
 };
+
+// Stateful AES-CBC encryptor for streaming a file through in blocks. The output of
+// every update() followed by one finalize() is identical to a single AESWrapper::encrypt
+// over the concatenated input, so the server can keep decrypting the upload in one go.
+class AESStreamEncryptor {
+private:
+    CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption _cbc;
+
+    AESStreamEncryptor(const AESStreamEncryptor& other);
+    AESStreamEncryptor& operator=(const AESStreamEncryptor& other);
+
+public:
+    AESStreamEncryptor(const std::string& key);
+    // Continues a stream from the middle: iv is the last ciphertext block before the resumed data
+    AESStreamEncryptor(const std::string& key, const uint8_t* iv);
+    ~AESStreamEncryptor();
+
+    // Encrypts length bytes (a multiple of the AES block size) into out; returns the bytes written
+    size_t update(const uint8_t* plain, size_t length, uint8_t* out);
+    // Encrypts the tail of the stream with PKCS7 padding; out needs room for length + BLOCKSIZE bytes
+    size_t finalize(const uint8_t* plain, size_t length, uint8_t* out);
+};
@@ -1,10 +1,34 @@
 #pragma once
 
 #include <cstddef>    // For size_t
+#include <cstdint>    // For uint32_t
 #include <string>     // For std::string
+#include <filesystem> // For std::filesystem::path
+#include "CrcKernel.h"
+#include "FastHash.h"
 
-// Function to compute the CRC for a memory block
-unsigned long memcrc(char* b, size_t n);
+// memcrc split into segments CRCed on worker threads and combined; bit-identical to memcrc.
+// threads == 0 uses every hardware thread.
+unsigned long memcrcParallel(const char* b, size_t n, size_t threads = 0);
+
+// memcrc of a whole file; every worker reads and CRCs its own segments of it
+uint32_t filecrcParallel(const std::filesystem::path& path, size_t threads = 0);
+
+// Reflected CRC-32 (polynomial 0xEDB88320, the one zlib.crc32 computes), used for the
+// per-chunk checks of SEND_FILE_CHUNK frames. Unrelated to the cksum CRC of CrcKernel.h.
+uint32_t chunkcrc(const char* b, size_t n);
+
+struct FileDigest {
+    uint64_t size;
+    FileHash hash;       // In the algorithm the file was digested for, what the server confirms
+    std::string sha256;  // 32 byte SHA-256 of the whole file
+};
+
+// One read pass over a file computing its SHA-256 and its cksum CRC or XXH3-64, whichever
+// hashAlgorithm names; the upload compares the server's answer against it, so no other pass
+// hashes the file. With XXH3_64 the slow CRC is never computed; otherwise the CRC of each
+// read batch is spread over every hardware thread while SHA-256 runs on the calling one.
+FileDigest digestFile(const std::filesystem::path& path, HashAlgorithm hashAlgorithm);
 
 // Function to read a file and return a CRC checksum with additional info
-std::string readfile(std::string fname);
\ No newline at end of file
+std::string readfile(std::string fname);
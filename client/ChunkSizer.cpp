@@ -0,0 +1,61 @@
+#include "ChunkSizer.h"
+#include <algorithm>
+
+constexpr double SMOOTHING = 0.25;
+
+ChunkSizer::ChunkSizer(size_t minSize, size_t maxSize, size_t initialSize)
+    : minSize(minSize), maxSize(std::max(minSize, maxSize)), current(std::clamp(initialSize, minSize, std::max(minSize, maxSize))),
+      bytesSent(0), bytesAtLastAck(0), throughput(0), ackOutstanding(false), ackOffset(0),
+      ackSentAt(), lastAck(Clock::now()), rtt(0)
+{
+}
+
+size_t ChunkSizer::next() const {
+    return this->current;
+}
+
+bool ChunkSizer::onSent(uint64_t offset, size_t size) {
+    auto now = Clock::now();
+    this->bytesSent += size;
+    this->chosenSizes[size]++;
+
+    if (this->ackOutstanding or now - this->lastAck < ACK_INTERVAL)
+        return false;
+    this->ackOutstanding = true;
+    this->ackOffset = offset;
+    this->ackSentAt = now;
+    return true;
+}
+
+void ChunkSizer::onAck(uint64_t offset) {
+    if (!this->ackOutstanding or offset != this->ackOffset)
+        return;
+    auto now = Clock::now();
+    double interval = std::chrono::duration<double>(now - this->lastAck).count();
+    this->ackOutstanding = false;
+    this->lastAck = now;
+
+    double sample = std::chrono::duration<double>(now - this->ackSentAt).count();
+    this->rtt = this->rtt == 0 ? sample : (1 - SMOOTHING) * this->rtt + SMOOTHING * sample;
+    if (interval > 0) {
+        double rate = (this->bytesSent - this->bytesAtLastAck) / interval;
+        this->throughput = this->throughput == 0 ? rate : (1 - SMOOTHING) * this->throughput + SMOOTHING * rate;
+    }
+    this->bytesAtLastAck = this->bytesSent;
+
+    double desired = std::max(this->throughput * TARGET_FRAME_SECONDS, this->throughput * this->rtt / FRAMES_PER_ROUND_TRIP);
+
+    double stepped = std::clamp(desired, this->current / 2.0, this->current * 2.0);
+    size_t size = static_cast<size_t>(stepped) & ~static_cast<size_t>(15); // Whole AES blocks
+    this->current = std::clamp(size, this->minSize, this->maxSize);
+}
+
+bool ChunkSizer::isAckOutstanding() const {
+    return this->ackOutstanding;
+}
+
+void ChunkSizer::record(TransferStats& stats) const {
+    stats.chunkSizes = this->chosenSizes;
+    stats.ackRtt = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(this->rtt));
+    stats.linkThroughput = this->throughput;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include "TransferPipeline.h"
+
+constexpr size_t CLIENT_MIN_CHUNK_SIZE = 1024;
+constexpr size_t CLIENT_MAX_CHUNK_SIZE = PIPELINE_BLOCK_SIZE; // Chunks are cut from one pipeline block
+constexpr double TARGET_FRAME_SECONDS = 0.005;                // Wire time one frame should take
+constexpr double FRAMES_PER_ROUND_TRIP = 8;                   // Frames that should fit in one round trip
+constexpr std::chrono::milliseconds ACK_INTERVAL{ 20 };       // At most one acknowledgement in flight, this often
+
+// Picks the size of the next SEND_FILE_CHUNK frame from what the transfer achieves so far.
+// Frames aim at TARGET_FRAME_SECONDS of wire time at the measured throughput, so a fast LAN
+// gets large frames with little header overhead while a slow link keeps them small enough
+// for fine grained resends and rate limiting. On high latency paths they also grow to an
+// eighth of the bandwidth-delay product (throughput times acknowledgement round trip), so
+// per-frame costs never dominate. Sizes move at most a factor of two per acknowledgement
+// and stay within the negotiated bounds.
+class ChunkSizer {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    size_t minSize;
+    size_t maxSize;
+    size_t current;
+
+    uint64_t bytesSent;
+    uint64_t bytesAtLastAck;
+    double throughput; // Smoothed bytes per second between acknowledgements
+
+    bool ackOutstanding;
+    uint64_t ackOffset;
+    Clock::time_point ackSentAt;
+    Clock::time_point lastAck;
+    double rtt;        // Smoothed round trip, seconds
+
+    std::map<size_t, uint64_t> chosenSizes;
+
+public:
+    ChunkSizer(size_t minSize, size_t maxSize, size_t initialSize);
+
+    size_t next() const;
+    // Call for every frame sent; returns true if this frame should ask for an acknowledgement
+    bool onSent(uint64_t offset, size_t size);
+    // Call when the acknowledgement for offset arrives
+    void onAck(uint64_t offset);
+    bool isAckOutstanding() const;
+
+    // Adds the chosen sizes and measured link figures to stats
+    void record(TransferStats& stats) const;
+};
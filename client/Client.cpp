@@ -7,19 +7,111 @@
 #include <fstream>
 #include "RequestManager.h"
 #include "ResponseUnpacker.h"
-#include <iostream>
+#include "Logger.h"
 #include "Checksum.h"
 #include "Base64Wrapper.h"
+#include "TransferPipeline.h"
+#include "ChunkSizer.h"
+#include "Tracer.h"
+#include <algorithm>
 
 constexpr size_t SERVER_HEADER_SIZE = 7;
 constexpr size_t NAME_SIZE = 255;
+constexpr size_t PACKET_CONTENT_SIZE = 1024;
+constexpr size_t DEFAULT_CONNECTIONS = 4;
+constexpr size_t MAX_CONNECTIONS = 64;
+constexpr int MAX_CHUNK_RESEND_ROUNDS = 5;
 
 Client::Client(boost::asio::io_context& io_context)
-    : socket(io_context), resolver(io_context), address(""), port(""), RSAPublicKey(""), RSAPrivateKey(""), AESKey(""), clientID(""), name(""), path("") 
+    : socket(io_context), resolver(io_context), address(""), port(""), RSAPublicKey(""), RSAPrivateKey(""), AESKey(""), clientID(""), name(""), path(""), connections(DEFAULT_CONNECTIONS),
+      priority(TransferPriority::BULK), limiter(&RateLimiter::global()), chunkMinSize(0), chunkMaxSize(0), chunkSize(0),
+      hashAlgorithm(HashAlgorithm::CKSUM_CRC), progress(nullptr)
 {}
 
+void Client::copyIdentity(const Client& other) {
+    // Everything needed to log in again on another connection; the AES key is per session
+    this->address = other.address;
+    this->port = other.port;
+    this->RSAPublicKey = other.RSAPublicKey;
+    this->RSAPrivateKey = other.RSAPrivateKey;
+    this->clientID = other.clientID;
+    this->priority = other.priority;
+    this->limiter = other.limiter;
+    this->name = other.name;
+    this->path = other.path;
+    this->connections = other.connections;
+}
+
+void Client::setPriority(TransferPriority priority) {
+    this->priority = priority;
+}
+
+void Client::setRateLimiter(RateLimiter& limiter) {
+    this->limiter = &limiter;
+}
+
+void Client::setProgress(TransferProgress* progress) {
+    this->progress = progress;
+}
+
+void Client::setIdentity(const string& name, const string& clientID, const string& privateKey) {
+    if (clientID.size() != 16)
+        throw std::invalid_argument("Client ID must be 16 bytes");
+    setName(name);
+    this->clientID = clientID;
+    this->RSAPrivateKey = privateKey;
+    RSAPrivateWrapper privateKeyWrapper(this->RSAPrivateKey);
+    this->RSAPublicKey = privateKeyWrapper.getPublicKey();
+}
+
+string Client::getName() const {
+    return removeNullPadding(this->name);
+}
+
+const string& Client::getPrivateKey() const {
+    return this->RSAPrivateKey;
+}
+
+const std::filesystem::path& Client::getPath() const {
+    return this->path;
+}
+
+size_t Client::getConnectionCount() const {
+    return this->connections;
+}
+
+const string& Client::getClientID() const {
+    return this->clientID;
+}
+
+bool Client::isDirectoryUpload() const {
+    return std::filesystem::is_directory(this->path);
+}
+
 void Client::connect() {
     boost::asio::connect(this->socket, this->resolver.resolve(this->address, this->port));
+    // Small frames sent back to back would otherwise wait on the server's delayed ACK
+    this->socket.set_option(tcp::no_delay(true));
+    // Chunk sizes and the hash are agreed on per connection, a new one negotiates again
+    this->chunkMinSize = 0;
+    this->chunkMaxSize = 0;
+    this->hashAlgorithm = HashAlgorithm::CKSUM_CRC;
+}
+
+bool Client::isConnectionAlive() {
+    if (!this->socket.is_open())
+        return false;
+    // Between requests the server sends nothing, so a readable socket means it closed the
+    // connection (or broke the protocol); either way the connection can not be used
+    boost::system::error_code error;
+    this->socket.non_blocking(true, error);
+    if (error)
+        return false;
+    char byte;
+    this->socket.receive(boost::asio::buffer(&byte, 1), tcp::socket::message_peek, error);
+    boost::system::error_code ignored;
+    this->socket.non_blocking(false, ignored);
+    return error == boost::asio::error::would_block;
 }
 
 void Client::sendPacket(unique_ptr<Packet> packet) {
@@ -30,10 +122,16 @@ void Client::sendPacket(unique_ptr<Packet> packet) {
     // Combine header and payload into one packet to send
     serializedData.insert(serializedData.end(), serializedPayload.begin(), serializedPayload.end());
 
-    // Send the packet over the socket
+    // Wait for the rate limiter, then send the packet over the socket
+    this->limiter->acquire(serializedData.size(), this->priority);
     boost::asio::write(this->socket, boost::asio::buffer(serializedData));
 }
 
+void Client::setServer(const string& address, const string& port) {
+    this->address = address;
+    this->port = port;
+}
+
 void Client::setName(const string& name) {
     if (name.length() > 100)
         throw std::runtime_error("Name too long (more than 100 character)");
@@ -48,11 +146,11 @@ void Client::registrate() {
         boost::system::error_code error;
         // Read exactly 7 bytes
 
-        std::cout << "Reading header: " << std::endl;
+        LOG_DEBUG("Reading header: ");
 
         size_t bytesRead = boost::asio::read(this->socket, boost::asio::buffer(responseHeaderData), error);
 
-        std::cout << "Read " << bytesRead << " bytes" << std::endl;
+        LOG_DEBUG("Read " << bytesRead << " bytes");
 
         // Handle errors
         if (error) {
@@ -64,27 +162,27 @@ void Client::registrate() {
         }
 
 
-        std::cout << "Checking that registration was a success: " << std::endl;
+        LOG_DEBUG("Checking that registration was a success: ");
 
         auto header = ResponseHeader::deserializeHeader(responseHeaderData);
-        std::cout << "Response code: " << static_cast<int>(header.getResponseCode()) << std::endl;
+        LOG_DEBUG("Response code: " << static_cast<int>(header.getResponseCode()));
 
         if (header.getResponseCode() == ResponseCode::REGISTER_FAIL or header.getResponseCode() == ResponseCode::GENERAL_ERROR) {
             if (i == 2) {
-                std::cout << ("Registration failed for third time - exiting.") << std::endl;
+                LOG_ERROR("Registration failed for third time - exiting.");
                 break;
             }
             else
-                std::cout << ("Registration failed. Trying again!") << std::endl;
+                LOG_WARN("Registration failed. Trying again!");
             continue;
         }
 
-        std::cout << "Reading payload:" << std::endl;
+        LOG_DEBUG("Reading payload:");
 
         vector<uint8_t> responsePayloadData(header.getPayloadSize());
         bytesRead = boost::asio::read(this->socket, boost::asio::buffer(responsePayloadData), error);
 
-        std::cout << "Read " << bytesRead << " bytes into payload" << std::endl;
+        LOG_DEBUG("Read " << bytesRead << " bytes into payload");
 
         if (error) {
             throw std::runtime_error("Error reading from socket: " + error.message());
@@ -95,7 +193,7 @@ void Client::registrate() {
         }
 
         if (header.getResponseCode() == ResponseCode::REGISTER_OK) {
-            std::cout << "Registering you!" << std::endl;
+            LOG_INFO("Registering you!");
             auto payload = RegisterOkPayload::deserialize(responsePayloadData);
             this->clientID = payload.getClientID();
             return;
@@ -113,27 +211,23 @@ void Client::sendRSAreceiveAES() {
     RSAPrivateWrapper privateWrapper; // Generates a new RSA key pair
     RSAPublicWrapper publicWrapper(privateWrapper.getPublicKey()); // Get the public key from the private key
 
-    std::cout << "Generating RSA keys." << std::endl;
+    LOG_INFO("Generating RSA keys.");
 
     // Set the generated keys in the object parameters
     RSAPublicKey = publicWrapper.getPublicKey(); // Set the public key
     RSAPrivateKey = privateWrapper.getPrivateKey(); // Set the private key
 
-    // Create priv.key 
-    std::cout << "Saving private key in priv.key." << std::endl;
-    savePrivateKey();
-
     for (int i = 0; i < 3; i++) {
         auto packet = sendKeyPacket(this->clientID, this->name, this->RSAPublicKey);
-        std::cout << "Sending public RSA key to server." << std::endl;
+        LOG_INFO("Sending public RSA key to server.");
         sendPacket(std::move(packet));
 
         vector<uint8_t> responseHeaderData(SERVER_HEADER_SIZE);
         boost::system::error_code error;
 
-        std::cout << "Reading header: " << std::endl;
+        LOG_DEBUG("Reading header: ");
         size_t bytesRead = boost::asio::read(this->socket, boost::asio::buffer(responseHeaderData), error);
-        std::cout << "Read " << bytesRead << " bytes from response header" << std::endl;
+        LOG_DEBUG("Read " << bytesRead << " bytes from response header");
         // Handle errors
         if (error) {
             throw std::runtime_error("Error reading from socket: " + error.message());
@@ -145,9 +239,9 @@ void Client::sendRSAreceiveAES() {
         }
 
         auto header = ResponseHeader::deserializeHeader(responseHeaderData);
-        std::cout << "Header response code: " << static_cast<int>(header.getResponseCode()) << std::endl;
+        LOG_DEBUG("Header response code: " << static_cast<int>(header.getResponseCode()));
         if (header.getResponseCode() == ResponseCode::GENERAL_ERROR and i < 2) {
-            std::cout << "Server failure trying to send AES key. Trying again!" << std::endl;
+            LOG_WARN("Server failure trying to send AES key. Trying again!");
             continue;
         }
         else if (header.getResponseCode() == ResponseCode::GENERAL_ERROR and i == 2) {
@@ -159,9 +253,9 @@ void Client::sendRSAreceiveAES() {
 
         // Read the payload data
         vector<uint8_t> responsePayloadData(header.getPayloadSize());
-        std::cout << "Reading payload: " << std::endl;
+        LOG_DEBUG("Reading payload: ");
         bytesRead = boost::asio::read(this->socket, boost::asio::buffer(responsePayloadData), error);
-        std::cout << "Read " << bytesRead << " bytes into payload." << std::endl;
+        LOG_DEBUG("Read " << bytesRead << " bytes into payload.");
 
         if (error) {
             throw std::runtime_error("Error reading from socket: " + error.message());
@@ -175,7 +269,7 @@ void Client::sendRSAreceiveAES() {
         auto payload = AESSendKeyPayload::deserialize(responsePayloadData);
 
         // Decrypt the AES key using the RSA private key
-        std::cout << "Received encrypted AES key." << std::endl;
+        LOG_INFO("Received encrypted AES key.");
         string encryptedAESKey = payload.getAesKey(); // Assuming this retrieves the encrypted AES key
         string aesKey;
 
@@ -188,7 +282,7 @@ void Client::sendRSAreceiveAES() {
 
         // Now aesKey holds the decrypted AES key. You can store it or use it as needed.
         this->AESKey = aesKey; // Set the decrypted AES key in the client
-        std::cout << "Successfully decrypted AES key." << std::endl;
+        LOG_INFO("Successfully decrypted AES key.");
         break;
     }
 }
@@ -216,7 +310,7 @@ void Client::login() {
             if (i == 2)
                 throw std::runtime_error("Login failed for third time - aborting.");
             else
-                std::cout << ("Login failed. Trying again!") << std::endl;
+                LOG_WARN("Login failed. Trying again!");
             continue;
         }
         vector<uint8_t> responsePayloadData(header.getPayloadSize());
@@ -231,7 +325,7 @@ void Client::login() {
         }
 
         if (header.getResponseCode() == ResponseCode::LOGIN_OK_SEND_AES) {
-            std::cout << "Attempting to login:" << std::endl;
+            LOG_INFO("Attempting to login:");
             auto payload = LoginOkPayload::deserialize(responsePayloadData);
             string encryptedAESKey = payload.getEncryptedAESKey(); // Assuming this retrieves the encrypted AES key
 
@@ -246,7 +340,7 @@ void Client::login() {
                 throw std::runtime_error("Error in decrypting aes key after login. " + string(e.what()));
             }
 
-            std::cout << "Login succesful. New AES key received and updated." << std::endl;
+            LOG_INFO("Login succesful. New AES key received and updated.");
             return;
         }
         else {
@@ -256,110 +350,355 @@ void Client::login() {
 }
 
 
-void Client::sendFile() {
-    // Step 1: Read the file contents
-    if (!std::filesystem::exists(this->path)) {
+FileHash Client::sendFile() {
+    return sendFile(this->path, this->path.filename().string());
+}
+
+FileHash Client::sendFile(const std::filesystem::path& filePath, const string& fileName) {
+    if (!std::filesystem::exists(filePath)) {
         throw std::runtime_error("File does not exist");
     }
+    if (fileName.empty() or fileName.length() >= NAME_SIZE) {
+        throw std::runtime_error("File name must be between 1 and " + std::to_string(NAME_SIZE - 1) + " characters: " + fileName);
+    }
 
-    // Open the file as binary and read the contents
-    std::ifstream file(path, std::ios::binary | std::ios::ate); // Open and move to the end to get size
-    if (!file.is_open()) {
-        throw std::runtime_error("Unable to open file");
+    string paddedName = adjustStringSize(fileName, NAME_SIZE);
+    // The hash the upload is confirmed with is agreed on together with the chunk sizes
+    if (this->chunkMaxSize == 0) {
+        negotiateChunkBounds();
     }
 
-    // Get the file size
-    size_t fileSize = file.tellg();
-    file.seekg(0, std::ios::beg); // Go back to the beginning of the file
+    // Set by the digest of each attempt; chunks carry their byte offset, so the ciphertext size is
+    // the only thing fixed up front
+    FileDigest digest;
+    bool digestCurrent = false;
+    uint64_t fileSize = 0;
+    uint64_t encryptedSize = 0;
+    ScopedTransfer transfer(*this->limiter, this->priority);
+
+    auto sendChunk = [&](const char* data, size_t size, uint64_t offset, uint8_t flags, uint16_t code) {
+        uint32_t checksum;
+        {
+            TraceSpan span("chunk crc", size);
+            checksum = chunkcrc(data, size);
+        }
+        auto packet = sendFileChunkPacket(
+            adjustStringSize(this->clientID, 16),       // 16-byte client ID
+            static_cast<uint32_t>(size),                // Content size: size of the chunk
+            fileSize,                                   // Original file size
+            encryptedSize,                              // Size of the whole ciphertext
+            offset,                                     // Where the chunk goes in the ciphertext
+            checksum,                                   // Lets the server spot a corrupted chunk on its own
+            flags,                                      // Last frame of this pass, acknowledgement wanted
+            paddedName,                                 // 255-byte file name
+            string(data, size),                         // Chunk data as string
+            CLIENT_VERSION,
+            code
+        );
+        LOG_TRACE("Chunk at " << offset << ", " << size << " bytes, flags " << static_cast<int>(flags));
+        TraceSpan span(code == SEND_FILE_CHUNK_CODE ? "send chunk" : "resend chunk", size);
+        sendPacket(std::move(packet));
+        // Ciphertext offsets match plaintext ones up to the final padding; a new attempt starts over at 0
+        if (this->progress != nullptr and code == SEND_FILE_CHUNK_CODE)
+            this->progress->bytesDone.store(std::min(offset + size, fileSize), std::memory_order_relaxed);
+    };
 
-    // Read the entire file into a vector of bytes
-    vector<uint8_t> fileContent(fileSize);
-    file.read(reinterpret_cast<char*>(fileContent.data()), fileSize);
-    file.close();
+    for (int i = 0; i < 3; i++) {
+        // Content the server already holds is linked under the new name instead of being sent again; the
+        // SHA-256 it is found by and the hash the server confirms the upload with come from a single read
+        if (!digestCurrent) {
+            {
+                TraceSpan span("digest");
+                digest = digestFile(filePath, this->hashAlgorithm);
+                span.setBytes(digest.size);
+            }
+            digestCurrent = true;
+            fileSize = digest.size;
+            encryptedSize = TransferPipeline::encryptedSize(static_cast<size_t>(fileSize));
+            if (this->progress != nullptr) {
+                this->progress->bytesDone.store(0, std::memory_order_relaxed);
+                this->progress->bytesTotal.store(fileSize, std::memory_order_relaxed);
+            }
+            if (tryInstantUpload(digest, paddedName)) {
+                if (this->progress != nullptr)
+                    this->progress->bytesDone.store(fileSize, std::memory_order_relaxed);
+                return digest.hash;
+            }
+            LOG_INFO("File will be sent in chunks of " << this->chunkMinSize << " to " << this->chunkMaxSize << " bytes.");
+        }
+
+        // Read, encrypt, and send run on their own threads so disk, CPU and socket overlap
+        uint64_t offset = 0;
+        ChunkSizer sizer(this->chunkMinSize, this->chunkMaxSize, this->chunkSize);
+        TransferPipeline pipeline(filePath, this->AESKey);
+        pipeline.run([&](const uint8_t* data, size_t size, bool last) {
+            // Split each encrypted block into chunks sized from the throughput and round trips so far
+            for (size_t start = 0; start < size;) {
+                size_t chunkSize = std::min(sizer.next(), size - start);
+                uint8_t flags = last and start + chunkSize == size ? CHUNK_FLAG_LAST : 0;
+                if (sizer.onSent(offset, chunkSize))
+                    flags |= CHUNK_FLAG_ACK_REQUESTED;
+                sendChunk(reinterpret_cast<const char*>(data + start), chunkSize, offset, flags, SEND_FILE_CHUNK_CODE);
+                pollChunkAck(sizer, false);
+                start += chunkSize;
+                offset += chunkSize;
+            }
+        });
+        // The acknowledgement always arrives before the response to the last frame
+        while (sizer.isAckOutstanding())
+            pollChunkAck(sizer, true);
+        this->chunkSize = sizer.next();  // The next file on this connection starts where this one ended
+
+        TransferStats stats = pipeline.getStats();
+        sizer.record(stats);
+        std::ostringstream statsText;
+        stats.print(statsText);
+        string statsLine = statsText.str();
+        if (!statsLine.empty() and statsLine.back() == '\n')
+            statsLine.pop_back();
+        LOG_INFO(statsLine);
+
+        LOG_DEBUG("Reading server response to file");
+        TraceSpan waiting("wait for server");  // The server decrypts, verifies and stores the file meanwhile
+        auto header = readResponseHeader();
+        waiting.finish();
+
+        // Chunks that failed their CRC on the server are re-encrypted and patched in place
+        for (int round = 0; header.getResponseCode() == ResponseCode::CHUNKS_BAD; round++) {
+            auto badChunks = ChunksBadPayload::deserialize(readResponsePayload(header)).getChunks();
+            if (round == MAX_CHUNK_RESEND_ROUNDS or badChunks.empty()) {
+                throw std::runtime_error("Server still reports corrupted chunks after " + std::to_string(round) + " resends");
+            }
+            LOG_WARN("Server reported " << badChunks.size() << " corrupted chunks, resending only those.");
+            for (size_t k = 0; k < badChunks.size(); k++) {
+                string chunk = pipeline.ciphertextRange(badChunks[k].offset, badChunks[k].length);
+                sendChunk(chunk.data(), chunk.size(), badChunks[k].offset, k + 1 == badChunks.size() ? CHUNK_FLAG_LAST : 0, RESEND_CHUNK_CODE);
+            }
+            header = readResponseHeader();
+        }
 
-    uint32_t checksum = static_cast<uint32_t>(memcrc(reinterpret_cast<char*>(fileContent.data()), fileSize));
+        if (header.getResponseCode() == ResponseCode::GENERAL_ERROR) {
+            LOG_WARN("Server failure trying to send CRC. Trying again!");
+            continue;
+        }
+        // Every chunk arrived intact; the whole-file CRC or hash still catches anything else, including
+        // a file that changed since it was digested
+        uint64_t serverHash;
+        if (header.getResponseCode() == ResponseCode::FILE_HASH_OK) {
+            auto payload = FileHashOkPayload::deserialize(readResponsePayload(header));
+            if (payload.getHashAlgorithm() != static_cast<uint8_t>(this->hashAlgorithm))
+                throw std::runtime_error("Server verified the file with a hash that was not agreed on.");
+            serverHash = payload.getHash();
+        }
+        else if (header.getResponseCode() == ResponseCode::FILE_OK and this->hashAlgorithm == HashAlgorithm::CKSUM_CRC) {
+            serverHash = FileOkPayload::deserialize(readResponsePayload(header)).getChecksum();
+        }
+        else {
+            throw std::runtime_error("Illegal header response code for send file request.");
+        }
 
-    // Step 2: Encrypt the file content using AES encryption
-    std::cout << "Encrypting file using AES key:" << std::endl;
-    AESWrapper aes(this->AESKey); 
-    string encryptedContent = aes.encrypt(reinterpret_cast<const char*>(fileContent.data()), fileContent.size());
+        if (serverHash != digest.hash.value) {
+            // Most likely the file changed after it was digested; the next attempt digests what it sends
+            digestCurrent = false;
+            if (i < 2)
+                handleCRCFailure();
+            else if (i == 2)
+                handleCRCShutdown();
+        }
+        else {
+            handleCRCSuccess();
+            return digest.hash;
+        }
+    }
+    throw std::runtime_error("Failed to send file three times. aborting");
+}
 
-    // Step 3: Split the encrypted content into chunks of 1024 bytes
-    std::cout << "Splitting encrypted file into chunks: " << std::endl;
-    vector<uint8_t> encryptedData(encryptedContent.begin(), encryptedContent.end());
-    vector<vector<uint8_t>> chunks = splitIntoChunks(encryptedData, 1024);
+bool Client::tryInstantUpload(const FileDigest& digest, const string& paddedName) {
+    // Matched on the SHA-256 and size; the CRC field stays 0 when it was not computed
+    uint32_t checksum = digest.hash.algorithm == HashAlgorithm::CKSUM_CRC ? static_cast<uint32_t>(digest.hash.value) : 0;
+    auto packet = uploadPrecheckPacket(adjustStringSize(this->clientID, 16), digest.size, checksum, digest.sha256, paddedName);
+    sendPacket(std::move(packet));
 
-    // Step 4: Prepare and send packets
-    uint16_t totalPackets = static_cast<uint16_t>(chunks.size());
-    std::cout << "File split into " << totalPackets << " chunks." << std::endl;
-    uint16_t packetNumber = 1;
-    string fileName = path.filename().string();
-    for (int i = 0; i < 3; i++) {
-        for (const auto& chunk : chunks) {
-            // Create the packet payload
-            auto packet = sendFilePacket(
-                adjustStringSize(this->clientID, 16),             // 16-byte client ID
-                static_cast<uint32_t>(chunk.size()),              // Content size: size of the chunk
-                static_cast<uint32_t>(fileSize),                  // Original file size
-                packetNumber,                                     // Current packet number
-                totalPackets,                                     // Total number of packets
-                adjustStringSize(fileName, NAME_SIZE),                  // 255-byte file name
-                string(chunk.begin(), chunk.end())           // Chunk data as string
-            );
+    auto header = readResponseHeader();
+    if (header.getResponseCode() == ResponseCode::UPLOAD_NEEDED) {
+        UploadNeededPayload::deserialize(readResponsePayload(header));
+        return false;
+    }
+    if (header.getResponseCode() == ResponseCode::GENERAL_ERROR) {
+        LOG_WARN("Server failure checking for identical content, uploading the file.");
+        return false;
+    }
+    if (header.getResponseCode() != ResponseCode::FILE_OK) {
+        throw std::runtime_error("Illegal header response code for upload precheck request.");
+    }
 
-            sendPacket(std::move(packet));  // Send the packet
-            packetNumber++;                 // Increment packet number
-        }
+    // The server linked the name to content it already had, found by its SHA-256; confirm it like any upload.
+    // The checksum in the answer is the one the content is stored with, nothing to compare it against.
+    FileOkPayload::deserialize(readResponsePayload(header));
+    LOG_INFO("Server already holds identical content, nothing to send.");
+    handleCRCSuccess();
+    return true;
+}
 
-        vector<uint8_t> responseHeaderData(SERVER_HEADER_SIZE);
-        boost::system::error_code error;
-        std::cout << "Reading server response to file" << std::endl;
-        size_t bytesRead = boost::asio::read(this->socket, boost::asio::buffer(responseHeaderData), error);
+void Client::negotiateChunkBounds() {
+    // Hashes this client verifies files with, preferred first; the CRC is always understood
+    vector<uint8_t> hashAlgorithms = { static_cast<uint8_t>(HashAlgorithm::XXH3_64), static_cast<uint8_t>(HashAlgorithm::CKSUM_CRC) };
+    auto packet = negotiateChunksPacket(adjustStringSize(this->clientID, 16), CLIENT_MIN_CHUNK_SIZE, CLIENT_MAX_CHUNK_SIZE, hashAlgorithms);
+    sendPacket(std::move(packet));
 
-        // Handle errors
-        if (error) {
-            throw std::runtime_error("Error reading from socket: " + error.message());
-        }
+    auto header = readResponseHeader();
+    if (header.getResponseCode() != ResponseCode::CHUNK_BOUNDS) {
+        throw std::runtime_error("Illegal header response code for chunk size negotiation.");
+    }
+    auto payload = ChunkBoundsPayload::deserialize(readResponsePayload(header));
+    if (payload.getMinChunkSize() == 0 or payload.getMinChunkSize() > payload.getMaxChunkSize()
+        or payload.getMinChunkSize() < CLIENT_MIN_CHUNK_SIZE or payload.getMaxChunkSize() > CLIENT_MAX_CHUNK_SIZE) {
+        throw std::runtime_error("Server answered chunk size bounds outside of the requested ones.");
+    }
+    this->chunkMinSize = payload.getMinChunkSize();
+    this->chunkMaxSize = payload.getMaxChunkSize();
+    this->chunkSize = this->chunkMinSize;
 
-        // Ensure we read exactly SERVER_HEADER_SIZE bytes
-        if (bytesRead != SERVER_HEADER_SIZE) {
-            throw std::runtime_error("Expected to read " + std::to_string(SERVER_HEADER_SIZE) + " bytes, but got " + std::to_string(bytesRead) + " bytes.");
+    if (std::find(hashAlgorithms.begin(), hashAlgorithms.end(), payload.getHashAlgorithm()) == hashAlgorithms.end()) {
+        throw std::runtime_error("Server picked a hash algorithm that was not offered.");
+    }
+    this->hashAlgorithm = static_cast<HashAlgorithm>(payload.getHashAlgorithm());
+    LOG_INFO("Files are verified with " << hashAlgorithmName(this->hashAlgorithm) << ".");
+}
+
+void Client::pollChunkAck(ChunkSizer& sizer, bool wait) {
+    // Called from the sending thread while frames are still going out, so it must not block unless asked to
+    if (!sizer.isAckOutstanding() or (!wait and this->socket.available() < SERVER_HEADER_SIZE)) {
+        return;
+    }
+    TraceSpan span(wait ? "wait for ack" : "read ack");
+    auto header = readResponseHeader();
+    if (header.getResponseCode() != ResponseCode::CHUNK_ACK) {
+        throw std::runtime_error("Illegal header response code while sending file chunks.");
+    }
+    uint64_t acknowledged = ChunkAckPayload::deserialize(readResponsePayload(header)).getOffset();
+    LOG_TRACE("Chunks acknowledged up to " << acknowledged);
+    sizer.onAck(acknowledged);
+}
+
+FileInfoPayload Client::requestFileInfo(const string& fileName) {
+    if (fileName.empty() or fileName.length() >= NAME_SIZE) {
+        throw std::runtime_error("File name must be between 1 and " + std::to_string(NAME_SIZE - 1) + " characters: " + fileName);
+    }
+    auto packet = requestFileInfoPacket(adjustStringSize(this->clientID, 16), adjustStringSize(fileName, NAME_SIZE));
+    sendPacket(std::move(packet));
+
+    auto header = readResponseHeader();
+    if (header.getResponseCode() == ResponseCode::GENERAL_ERROR) {
+        throw std::runtime_error("Server has no verified file named " + fileName);
+    }
+    if (header.getResponseCode() != ResponseCode::FILE_INFO) {
+        throw std::runtime_error("Illegal header response code for file info request.");
+    }
+    return FileInfoPayload::deserialize(readResponsePayload(header));
+}
+
+void Client::requestRange(const string& fileName, uint64_t offset, uint32_t length) {
+    auto packet = readRangePacket(adjustStringSize(this->clientID, 16), offset, length, adjustStringSize(fileName, NAME_SIZE));
+    sendPacket(std::move(packet));
+}
+
+uint64_t Client::readRange(string& data) {
+    auto header = readResponseHeader();
+    if (header.getResponseCode() == ResponseCode::GENERAL_ERROR) {
+        throw std::runtime_error("Server failed to read a range of the file.");
+    }
+    if (header.getResponseCode() != ResponseCode::FILE_RANGE) {
+        throw std::runtime_error("Illegal header response code for read range request.");
+    }
+
+    auto payload = FileRangePayload::deserialize(readResponsePayload(header));
+    AESWrapper aes(this->AESKey);
+    data = aes.decrypt(payload.getContent().data(), static_cast<unsigned int>(payload.getContent().size()));
+    if (data.size() != payload.getLength()) {
+        throw std::runtime_error("Range at offset " + std::to_string(payload.getOffset()) + " decrypted to the wrong length.");
+    }
+    return payload.getOffset();
+}
+
+vector<PackFailure> Client::sendPack(vector<PackEntry>& entries, vector<string>& skipped) {
+    // Step 1: Build and encrypt the whole pack, it is bounded by PACK_MAX_BYTES
+    uint32_t entryCount = 0;
+    string pack = serializePack(entries, skipped, entryCount);
+    if (entryCount == 0) {
+        return {};
+    }
+
+    ScopedTransfer transfer(*this->limiter, this->priority);
+    AESWrapper aes(this->AESKey);
+    string encryptedPack = aes.encrypt(pack.data(), static_cast<unsigned int>(pack.size()));
+    size_t packetCount = (encryptedPack.size() + PACKET_CONTENT_SIZE - 1) / PACKET_CONTENT_SIZE;
+    if (packetCount > UINT16_MAX) {
+        throw std::runtime_error("Pack too large to be sent in " + std::to_string(UINT16_MAX) + " packets");
+    }
+    uint16_t totalPackets = static_cast<uint16_t>(packetCount);
+
+    for (int i = 0; i < 3; i++) {
+        // Step 2: Send the encrypted pack in 1024 byte packets
+        uint16_t packetNumber = 1;
+        for (size_t offset = 0; offset < encryptedPack.size(); offset += PACKET_CONTENT_SIZE) {
+            size_t chunkSize = std::min(PACKET_CONTENT_SIZE, encryptedPack.size() - offset);
+            auto packet = sendPackPacket(
+                adjustStringSize(this->clientID, 16),
+                static_cast<uint32_t>(chunkSize),
+                entryCount,
+                packetNumber,
+                totalPackets,
+                encryptedPack.substr(offset, chunkSize)
+            );
+            sendPacket(std::move(packet));
+            packetNumber++;
         }
 
-        auto header = ResponseHeader::deserializeHeader(responseHeaderData);
+        // Step 3: One acknowledgement covers the whole pack
+        auto header = readResponseHeader();
         if (header.getResponseCode() == ResponseCode::GENERAL_ERROR) {
-            std::cout << "Server failure trying to send CRC. Trying again!" << std::endl;
+            LOG_WARN("Server failure trying to store pack. Trying again!");
             continue;
         }
-        if (header.getResponseCode() != ResponseCode::FILE_OK)
-            throw std::runtime_error("Illegal header response code for send file request.");
-        else {
-            vector<uint8_t> responsePayloadData(header.getPayloadSize());
-            bytesRead = boost::asio::read(this->socket, boost::asio::buffer(responsePayloadData), error);
+        if (header.getResponseCode() != ResponseCode::PACK_OK) {
+            throw std::runtime_error("Illegal header response code for send pack request.");
+        }
 
-            if (error) {
-                throw std::runtime_error("Error reading from socket: " + error.message());
-            }
+        auto payload = PackOkPayload::deserialize(readResponsePayload(header));
+        LOG_INFO("Pack of " << entryCount << " files sent, " << payload.getStoredCount() << " stored, "
+                 << payload.getFailures().size() << " rejected.");
+        return payload.getFailures();
+    }
+    throw std::runtime_error("Failed to send pack three times. aborting");
+}
 
-            if (bytesRead != header.getPayloadSize()) {
-                throw std::runtime_error("Expected to read " + std::to_string(header.getPayloadSize()) + " bytes, but got " + std::to_string(bytesRead) + " bytes.");
-            }
+ResponseHeader Client::readResponseHeader() {
+    vector<uint8_t> responseHeaderData(SERVER_HEADER_SIZE);
+    boost::system::error_code error;
+    size_t bytesRead = boost::asio::read(this->socket, boost::asio::buffer(responseHeaderData), error);
 
-            // Deserialize the payload
-            auto payload = FileOkPayload::deserialize(responsePayloadData);
-            if (payload.getChecksum() != checksum) {
-                if (i < 2)
-                    handleCRCFailure();
-                else if (i == 2)
-                    handleCRCShutdown();
-            }
-            else {
-                handleCRCSuccess();
-                return;
-            }
-        }
+    if (error) {
+        throw std::runtime_error("Error reading from socket: " + error.message());
     }
-    throw std::runtime_error("Failed to send file three times. aborting");
+    if (bytesRead != SERVER_HEADER_SIZE) {
+        throw std::runtime_error("Expected to read " + std::to_string(SERVER_HEADER_SIZE) + " bytes, but got " + std::to_string(bytesRead) + " bytes.");
+    }
+    return ResponseHeader::deserializeHeader(responseHeaderData);
+}
+
+vector<uint8_t> Client::readResponsePayload(const ResponseHeader& header) {
+    vector<uint8_t> responsePayloadData(header.getPayloadSize());
+    boost::system::error_code error;
+    size_t bytesRead = boost::asio::read(this->socket, boost::asio::buffer(responsePayloadData), error);
+
+    if (error) {
+        throw std::runtime_error("Error reading from socket: " + error.message());
+    }
+    if (bytesRead != header.getPayloadSize()) {
+        throw std::runtime_error("Expected to read " + std::to_string(header.getPayloadSize()) + " bytes, but got " + std::to_string(bytesRead) + " bytes.");
+    }
+    return responsePayloadData;
 }
 
 void Client::handleCRCSuccess() {
@@ -382,21 +721,28 @@ void Client::handleCRCSuccess() {
 
         auto header = ResponseHeader::deserializeHeader(responseHeaderData);
         if (header.getResponseCode() == ResponseCode::GENERAL_ERROR) {
-            std::cout << "Server failure trying to confirm CRC. Trying again!" << std::endl;
+            LOG_WARN("Server failure trying to confirm CRC. Trying again!");
             continue;
         }
         if (header.getResponseCode() != ResponseCode::MESSAGE_OK)
             throw std::runtime_error("Illegal header response code received in handle crc success.");
         else {
-            std::cout << "File received succesfully, checksum ok, done!" << std::endl;
-            closeConnection();
+            // Consume the MessageOk payload so the connection stays framed for the next request
+            vector<uint8_t> responsePayloadData(header.getPayloadSize());
+            bytesRead = boost::asio::read(this->socket, boost::asio::buffer(responsePayloadData), error);
+            if (error) {
+                throw std::runtime_error("Error reading from socket: " + error.message());
+            }
+            MessageOkPayload::deserialize(responsePayloadData);
+
+            LOG_INFO("File received succesfully, checksum ok, done!");
             return;
         }
     }
 }
 
 void Client::handleCRCFailure() {
-    std::cout << "Checksum failed. Trying again." << std::endl;
+    LOG_WARN("Checksum failed. Trying again.");
     auto packet = checksumFailedPacket(this->clientID, this->name);
     sendPacket(std::move(packet));
 }
@@ -421,13 +767,21 @@ void Client::handleCRCShutdown() {
 
         auto header = ResponseHeader::deserializeHeader(responseHeaderData);
         if (header.getResponseCode() == ResponseCode::GENERAL_ERROR) {
-            std::cout << "Server failure trying to fix CRC. Trying again!" << std::endl;
+            LOG_WARN("Server failure trying to fix CRC. Trying again!");
             continue;
         }
         if (header.getResponseCode() != ResponseCode::MESSAGE_OK)
             throw std::runtime_error("Illegal header response code received in handle crc success.");
         else {
-            std::cout << "Checksum invalid for third time - exiting." << std::endl;
+            // Consume the MessageOk payload so the connection stays framed for the next request
+            vector<uint8_t> responsePayloadData(header.getPayloadSize());
+            bytesRead = boost::asio::read(this->socket, boost::asio::buffer(responsePayloadData), error);
+            if (error) {
+                throw std::runtime_error("Error reading from socket: " + error.message());
+            }
+            MessageOkPayload::deserialize(responsePayloadData);
+
+            LOG_ERROR("Checksum invalid for third time - exiting.");
             closeConnection();
             break;
         }
@@ -455,8 +809,8 @@ void Client::closeConnection() {
     }
 }
 
-void Client::loadTransferInfo() {
-    std::filesystem::path transferFilePath = std::filesystem::current_path() / "transfer.info";
+void Client::loadTransferInfo(bool requirePath, const std::filesystem::path& directory) {
+    std::filesystem::path transferFilePath = directory / "transfer.info";
 
     std::ifstream transferFile(transferFilePath);
 
@@ -494,28 +848,43 @@ void Client::loadTransferInfo() {
         std::filesystem::path filePath = std::filesystem::path(trimString(line));
 
         // Ensure the file exists
-        if (!std::filesystem::exists(filePath)) {
+        if (requirePath and !std::filesystem::exists(filePath)) {
             throw std::runtime_error("The file specified in transfer.info does not exist: " + filePath.string());
         }
 
-        this->path = filePath;  // Set the path for the file to be sent
+        this->path = filePath;  // Set the path for the file (or directory) to be sent
     }
     else {
         throw std::runtime_error("transfer.info file is missing the file path line.");
     }
 
+    // Step 4: Optional fourth line - number of parallel connections for directory uploads
+    if (std::getline(transferFile, line) and !trimString(line).empty()) {
+        try {
+            this->connections = std::stoul(trimString(line));
+        }
+        catch (const std::exception&) {
+            throw std::runtime_error("Invalid connection count in transfer.info: " + line);
+        }
+        if (this->connections == 0 or this->connections > MAX_CONNECTIONS) {
+            throw std::runtime_error("Connection count in transfer.info must be between 1 and " + std::to_string(MAX_CONNECTIONS));
+        }
+    }
+
     // Close the file after reading
     transferFile.close();
 
-    std::cout << "Transfer info loaded successfully:\n";
-    std::cout << "Address: " << this->address << "\n";
-    std::cout << "Port: " << this->port << "\n";
-    std::cout << "Client Name: " << this->name << "\n";
-    std::cout << "File Path: " << this->path << "\n";
+    LOG_INFO("Transfer info loaded successfully:\n"
+             << "Address: " << this->address << "\n"
+             << "Port: " << this->port << "\n"
+             << "Client Name: " << this->name << "\n"
+             << "File Path: " << this->path);
+    if (isDirectoryUpload())
+        LOG_INFO("Directory upload over " << this->connections << " connections");
 }
 
-void Client::loadMeInfo() {
-    std::filesystem::path meFilePath = std::filesystem::current_path() / "me.info";
+void Client::loadMeInfo(const std::filesystem::path& directory) {
+    std::filesystem::path meFilePath = directory / "me.info";
 
     std::ifstream meFile(meFilePath);
 
@@ -547,16 +916,16 @@ void Client::loadMeInfo() {
 
     meFile.close();
 
-    std::cout << "Me info loaded successfully:\n";
-    std::cout << "Client Name: " << this->name << "\n";
-    std::cout << "Client ID in hex: " << line << "\n";  // Display hex, but clientID is in byte form internally
+    LOG_INFO("Me info loaded successfully:\n"
+             << "Client Name: " << this->name << "\n"
+             << "Client ID in hex: " << line);  // Display hex, but clientID is in byte form internally
 }
 
 
-void Client::saveClientInfo() {
-    // Create or open the "me.info" file in the current directory
-    std::cout << "Saving client information into me.info:" << std::endl;
-    std::filesystem::path meInfoPath = std::filesystem::current_path() / "me.info";
+void Client::saveClientInfo(const std::filesystem::path& directory) {
+    // Create or open the "me.info" file in directory
+    LOG_INFO("Saving client information into me.info:");
+    std::filesystem::path meInfoPath = directory / "me.info";
     std::ofstream meInfoFile(meInfoPath);
 
     if (!meInfoFile.is_open()) {
@@ -564,7 +933,7 @@ void Client::saveClientInfo() {
     }
 
     // Write client name
-    std::cout << "Saving client name." << std::endl;
+    LOG_INFO("Saving client name.");
     meInfoFile << removeNullPadding(this->name) << "\n";
 
     // Write client ID as hex (16 bytes = 32 hex characters)
@@ -572,20 +941,20 @@ void Client::saveClientInfo() {
     for (unsigned char c : this->clientID) {
         ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(c);
     }
-    std::cout << "Saving client ID in hex." << std::endl;
+    LOG_INFO("Saving client ID in hex.");
     meInfoFile << ss.str() << "\n";
 
     // Write RSA private key as base64
     string encodedPrivateKey = Base64Wrapper::encode(this->RSAPrivateKey);
-    std::cout << "Saving base64 private key." << std::endl;
+    LOG_INFO("Saving base64 private key.");
     meInfoFile << encodedPrivateKey << "\n";
 
     meInfoFile.close();
 }
 
-void Client::savePrivateKey() {
-    // Create or open the "priv.key" file in the current directory
-    std::filesystem::path privKeyPath = std::filesystem::current_path() / "priv.key";
+void Client::savePrivateKey(const std::filesystem::path& directory) {
+    // Create or open the "priv.key" file in directory
+    std::filesystem::path privKeyPath = directory / "priv.key";
     std::ofstream privKeyFile(privKeyPath);
 
     if (!privKeyFile.is_open()) {
@@ -597,12 +966,12 @@ void Client::savePrivateKey() {
     privKeyFile << encodedPrivateKey;
 
     privKeyFile.close();
-    std::cout << "Saved private key to priv.key." << std::endl;
+    LOG_INFO("Saved private key to priv.key.");
 }
 
-void Client::loadPrivateKey() {
-    // Open the "priv.key" file in the current directory
-    std::filesystem::path privKeyPath = std::filesystem::current_path() / "priv.key";
+void Client::loadPrivateKey(const std::filesystem::path& directory) {
+    // Open the "priv.key" file in directory
+    std::filesystem::path privKeyPath = directory / "priv.key";
     std::ifstream privKeyFile(privKeyPath);
 
     if (!privKeyFile.is_open()) {
@@ -618,5 +987,5 @@ void Client::loadPrivateKey() {
     this->RSAPublicKey = privateKeyWrapper.getPublicKey();
 
     privKeyFile.close();
-    std::cout << "Loaded private key from priv.key." << std::endl;
+    LOG_INFO("Loaded private key from priv.key.");
 }
\ No newline at end of file
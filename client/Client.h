@@ -3,6 +3,12 @@
 #include <boost/asio.hpp>
 #include <string>
 #include "RequestManager.h"
+#include "ResponseUnpacker.h"
+#include "SmallFilePack.h"
+#include "RateLimiter.h"
+#include "ChunkSizer.h"
+#include "Checksum.h"
+#include "TransferProgress.h"
 #include <filesystem>
 
 using boost::asio::ip::tcp, std::string;
@@ -19,25 +25,69 @@ private:
 	string clientID;
 	string name;
 	std::filesystem::path path;
+	size_t connections;
+	TransferPriority priority;
+	RateLimiter* limiter;
+	size_t chunkMinSize;  // Negotiated once per connection, 0 until then
+	size_t chunkMaxSize;
+	size_t chunkSize;     // Last size the adaptive sizer settled on
+	HashAlgorithm hashAlgorithm; // Whole-file verification, agreed on with the chunk sizes
+	TransferProgress* progress;  // Updated by sendFile when set, not copied by copyIdentity
+
+	ResponseHeader readResponseHeader();
+	vector<uint8_t> readResponsePayload(const ResponseHeader& header);
+	void negotiateChunkBounds();
+	bool tryInstantUpload(const FileDigest& digest, const string& paddedName);
+	void pollChunkAck(ChunkSizer& sizer, bool wait);
 
 public:
 	Client(boost::asio::io_context& io_context);
 	
 	void setName(const string& name);
+	// In place of the first line of transfer.info
+	void setServer(const string& address, const string& port);
+	// Also copies the priority and rate limiter, so extra connections share the same budget
+	void copyIdentity(const Client& other);
+	void setPriority(TransferPriority priority);
+	void setRateLimiter(RateLimiter& limiter);
+	void setProgress(TransferProgress* progress);
+	// In place of me.info and priv.key; clientID is the 16 raw bytes, privateKey the raw RSA key
+	void setIdentity(const string& name, const string& clientID, const string& privateKey);
+	string getName() const;
+	const string& getPrivateKey() const;
+	const std::filesystem::path& getPath() const;
+	size_t getConnectionCount() const;
+	const string& getClientID() const;
+	bool isDirectoryUpload() const;
 
-	void sendFile();
+	FileHash sendFile();
+	// Returns the hash the server confirmed the file with: its cksum CRC, or the XXH3-64 agreed in its place
+	FileHash sendFile(const std::filesystem::path& filePath, const string& fileName);
+	// Fills in each sent entry's checksum
+	vector<PackFailure> sendPack(vector<PackEntry>& entries, vector<string>& skipped);
+	// Size and checksum of a file this client stored earlier
+	FileInfoPayload requestFileInfo(const string& fileName);
+	// Range reads are pipelined: requestRange only sends the request, readRange waits for
+	// the oldest unanswered one, decrypts it into data and returns its offset
+	void requestRange(const string& fileName, uint64_t offset, uint32_t length);
+	uint64_t readRange(string& data);
 	void connect();
+	// Checks without a round trip that the server has not closed the idle connection
+	bool isConnectionAlive();
 	void sendPacket(unique_ptr<Packet> packet);
 	void registrate();
 	void login();
+	// The new key pair stays in memory, savePrivateKey writes it to priv.key
 	void sendRSAreceiveAES();
 	void handleCRCSuccess();
 	void handleCRCFailure();
 	void handleCRCShutdown();
 	void closeConnection();
-	void loadTransferInfo();
-	void loadMeInfo();
-	void saveClientInfo();
-	void savePrivateKey();
-	void loadPrivateKey();
+	// requirePath = false skips the existence check of the third line, downloads and --watch do not read it
+	// The files are read from and written to directory, the working directory by default
+	void loadTransferInfo(bool requirePath = true, const std::filesystem::path& directory = std::filesystem::current_path());
+	void loadMeInfo(const std::filesystem::path& directory = std::filesystem::current_path());
+	void saveClientInfo(const std::filesystem::path& directory = std::filesystem::current_path());
+	void savePrivateKey(const std::filesystem::path& directory = std::filesystem::current_path());
+	void loadPrivateKey(const std::filesystem::path& directory = std::filesystem::current_path());
 };
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>    // For size_t
+#include <cstdint>    // For uint32_t, uint64_t
+
+// Function to compute the CRC for a memory block
+unsigned long memcrc(char* b, size_t n);
+
+// Incremental form of memcrc: start from 0, feed each block through memcrcUpdate,
+// then call memcrcFinal with the total number of bytes fed
+unsigned long memcrcUpdate(unsigned long s, const char* b, size_t n);
+unsigned long memcrcFinal(unsigned long s, size_t n);
+
+// State memcrcUpdate reaches over A followed by B, from its states over A and over B alone
+// (both started from 0) and the length of B. The length suffix is left to memcrcFinal.
+unsigned long memcrcCombine(unsigned long stateA, unsigned long stateB, uint64_t lengthB);
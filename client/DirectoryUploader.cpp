@@ -0,0 +1,289 @@
+#include "DirectoryUploader.h"
+#include <algorithm>
+#include <chrono>
+#include "Logger.h"
+#include <stdexcept>
+#include <thread>
+
+void WorkStealingQueue::push(FileJob job) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->jobs.push_back(std::move(job));
+}
+
+bool WorkStealingQueue::take(FileJob& job, bool allowLarge, uint64_t threshold) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->jobs.empty())
+        return false;
+
+    if (allowLarge) {
+        job = std::move(this->jobs.front());
+        this->jobs.pop_front();
+        return true;
+    }
+    if (this->jobs.back().size < threshold) {
+        job = std::move(this->jobs.back());
+        this->jobs.pop_back();
+        return true;
+    }
+    return false;
+}
+
+size_t WorkStealingQueue::size() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->jobs.size();
+}
+
+DirectoryUploader::DirectoryUploader(Client& primary, const std::filesystem::path& root, size_t connectionCount, UploadIndex* uploadIndex)
+    : primary(primary), root(std::filesystem::absolute(root).lexically_normal()), connectionCount(connectionCount), uploadIndex(uploadIndex),
+      largeInFlight(0), bytesSent(0), filesSent(0), steals(0), unchangedFiles(0)
+{
+    if (connectionCount == 0)
+        throw std::invalid_argument("Directory upload needs at least one connection");
+    if (!std::filesystem::is_directory(this->root))
+        throw std::runtime_error("Not a directory: " + this->root.string());
+
+    // "dir/" normalizes to "dir/" with an empty filename; drop the separator so the root keeps its name
+    if (!this->root.has_filename())
+        this->root = this->root.parent_path();
+
+    for (size_t i = 0; i < connectionCount; i++)
+        this->queues.push_back(std::make_unique<WorkStealingQueue>());
+}
+
+vector<FileJob> DirectoryUploader::scan() {
+    vector<FileJob> jobs;
+    vector<PackEntry> smallFiles;
+    std::filesystem::path base = this->root.filename();
+    auto options = std::filesystem::directory_options::skip_permission_denied;
+
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(this->root, options)) {
+        if (!entry.is_regular_file())
+            continue;
+        // Keep the root directory's own name so the tree lands under files/<client_id>/<root>/
+        string remoteName = (base / entry.path().lexically_relative(this->root)).generic_string();
+        // Metadata only, taken before the upload reads the file so later edits are never hidden;
+        // without an index only the size is needed, which the directory entry already has
+        LocalFileState state;
+        if (this->uploadIndex == nullptr)
+            state.size = entry.file_size();
+        else {
+            state = LocalFileState::of(entry.path());
+            if (this->uploadIndex->isUnchanged(entry.path(), remoteName, state)) {
+                this->unchangedFiles++;
+                continue;
+            }
+        }
+        if (state.size < PACK_FILE_THRESHOLD)
+            smallFiles.push_back({ entry.path(), remoteName, state.size, state });
+        else
+            jobs.push_back({ entry.path(), remoteName, state.size, state, {} });
+    }
+
+    for (auto& pack : groupIntoPacks(std::move(smallFiles))) {
+        uint64_t packBytes = 0;
+        for (const auto& entry : pack)
+            packBytes += entry.size;
+        string description = "pack of " + std::to_string(pack.size()) + " files";
+        jobs.push_back({ std::filesystem::path(), description, packBytes, {}, std::move(pack) });
+    }
+    return jobs;
+}
+
+void DirectoryUploader::sendJob(Client& client, FileJob& job, size_t worker) {
+    if (job.pack.empty()) {
+        FileHash hash = client.sendFile(job.path, job.remoteName);
+        if (this->uploadIndex != nullptr)
+            this->uploadIndex->recordConfirmed(job.path, job.remoteName, job.state, hash);
+        this->bytesSent += job.size;
+        this->filesSent++;
+        return;
+    }
+
+    vector<string> skipped;
+    vector<PackFailure> rejected = client.sendPack(job.pack, skipped);
+    for (const auto& name : skipped)
+        recordFailure(name + ": could not be read");
+
+    uint64_t retriedBytes = 0;
+    size_t retriedFiles = 0;
+    for (const auto& failure : rejected) {
+        auto entry = std::find_if(job.pack.begin(), job.pack.end(), [&](const PackEntry& e) { return e.remoteName == failure.fileName; });
+        if (entry == job.pack.end() or failure.reason == PackFailureReason::INVALID_NAME) {
+            recordFailure(failure.fileName + ": rejected by the server in a pack");
+            continue;
+        }
+        // Anything else (e.g. a checksum mismatch) is queued again as a regular single-file upload
+        this->queues[worker]->push({ entry->path, entry->remoteName, entry->size, entry->state, {} });
+        retriedBytes += entry->size;
+        retriedFiles++;
+    }
+
+    uint64_t skippedBytes = 0;
+    for (const auto& entry : job.pack) {
+        bool wasSkipped = std::find(skipped.begin(), skipped.end(), entry.remoteName) != skipped.end();
+        bool wasRejected = std::any_of(rejected.begin(), rejected.end(), [&](const PackFailure& f) { return f.fileName == entry.remoteName; });
+        if (wasSkipped)
+            skippedBytes += entry.size;
+        else if (!wasRejected and this->uploadIndex != nullptr)
+            this->uploadIndex->recordConfirmed(entry.path, entry.remoteName, entry.state, { HashAlgorithm::CKSUM_CRC, entry.checksum });
+    }
+    this->bytesSent += job.size - retriedBytes - skippedBytes;
+    this->filesSent += job.pack.size() - skipped.size() - rejected.size();
+}
+
+bool DirectoryUploader::reserveLargeSlot() {
+    size_t budget = this->connectionCount > 1 ? this->connectionCount - 1 : 1;
+    size_t current = this->largeInFlight.load();
+    while (current < budget) {
+        if (this->largeInFlight.compare_exchange_weak(current, current + 1))
+            return true;
+    }
+    return false;
+}
+
+void DirectoryUploader::releaseLargeSlot() {
+    this->largeInFlight--;
+}
+
+bool DirectoryUploader::nextJob(size_t worker, FileJob& job, bool& holdsLargeSlot) {
+    bool largeSlot = reserveLargeSlot();
+
+    // Own queue first, then steal, starting with the neighbour
+    for (size_t k = 0; k < this->connectionCount; k++) {
+        WorkStealingQueue& queue = *this->queues[(worker + k) % this->connectionCount];
+        if (queue.take(job, largeSlot, LARGE_FILE_THRESHOLD)) {
+            if (k != 0)
+                this->steals++;
+            holdsLargeSlot = largeSlot and job.size >= LARGE_FILE_THRESHOLD;
+            if (largeSlot and !holdsLargeSlot)
+                releaseLargeSlot();
+            return true;
+        }
+    }
+
+    // No small files are left anywhere, so taking a large one cannot starve anything
+    if (!largeSlot) {
+        for (size_t k = 0; k < this->connectionCount; k++) {
+            WorkStealingQueue& queue = *this->queues[(worker + k) % this->connectionCount];
+            if (queue.take(job, true, LARGE_FILE_THRESHOLD)) {
+                if (k != 0)
+                    this->steals++;
+                holdsLargeSlot = false;
+                return true;
+            }
+        }
+    }
+    else {
+        releaseLargeSlot();
+    }
+    return false;
+}
+
+unique_ptr<Client> DirectoryUploader::openConnection(boost::asio::io_context& io_context) const {
+    auto client = std::make_unique<Client>(io_context);
+    client->copyIdentity(this->primary);
+    client->connect();
+    client->login();
+    return client;
+}
+
+void DirectoryUploader::recordFailure(const string& message) {
+    std::lock_guard<std::mutex> lock(this->failuresMutex);
+    this->failures.push_back(message);
+}
+
+void DirectoryUploader::worker(size_t index) {
+    boost::asio::io_context io_context;
+    unique_ptr<Client> owned;
+    Client* client = &this->primary;
+
+    if (index != 0) {
+        try {
+            owned = openConnection(io_context);
+            client = owned.get();
+        }
+        catch (const std::exception& e) {
+            // The other connections will steal this worker's queue
+            LOG_WARN("Connection " << index << " could not log in: " << e.what());
+            return;
+        }
+    }
+
+    FileJob job;
+    bool holdsLargeSlot = false;
+    while (nextJob(index, job, holdsLargeSlot)) {
+        try {
+            sendJob(*client, job, index);
+        }
+        catch (const std::exception& e) {
+            recordFailure(job.remoteName + ": " + e.what());
+            // The connection may be mid-frame after a failure, start a fresh session
+            try {
+                owned = openConnection(io_context);
+                client = owned.get();
+            }
+            catch (const std::exception& reconnectError) {
+                LOG_WARN("Connection " << index << " could not reconnect: " << reconnectError.what());
+                if (holdsLargeSlot)
+                    releaseLargeSlot();
+                return;
+            }
+        }
+        if (holdsLargeSlot)
+            releaseLargeSlot();
+    }
+
+    if (owned) {
+        try {
+            owned->closeConnection();
+        }
+        catch (const std::exception&) {
+        }
+    }
+}
+
+void DirectoryUploader::run() {
+    vector<FileJob> jobs = scan();
+    uint64_t totalBytes = 0;
+    size_t totalFiles = 0;
+    for (const auto& job : jobs) {
+        totalBytes += job.size;
+        totalFiles += job.pack.empty() ? 1 : job.pack.size();
+    }
+
+    // Deal largest-first round robin so every queue gets a similar number of bytes
+    std::sort(jobs.begin(), jobs.end(), [](const FileJob& a, const FileJob& b) { return a.size > b.size; });
+    for (size_t i = 0; i < jobs.size(); i++)
+        this->queues[i % this->connectionCount]->push(std::move(jobs[i]));
+
+    LOG_INFO("Uploading " << totalFiles << " files (" << totalBytes << " bytes, " << jobs.size() << " uploads) from "
+             << this->root << " over " << this->connectionCount << " connections.");
+
+    auto start = std::chrono::steady_clock::now();
+    vector<std::thread> workers;
+    for (size_t i = 0; i < this->connectionCount; i++)
+        workers.emplace_back(&DirectoryUploader::worker, this, i);
+    for (auto& worker : workers)
+        worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Anything still queued was abandoned by connections that went away
+    for (const auto& queue : this->queues) {
+        FileJob job;
+        while (queue->take(job, true, LARGE_FILE_THRESHOLD))
+            this->failures.push_back(job.remoteName + ": not sent, no connection left");
+    }
+
+    std::ostringstream skipped;
+    if (this->uploadIndex != nullptr)
+        skipped << ", " << this->unchangedFiles << " unchanged files skipped";
+    LOG_INFO("Directory upload finished: " << this->filesSent << " files, " << this->bytesSent << " bytes in "
+             << seconds << " s (" << (seconds > 0 ? this->bytesSent / (1024.0 * 1024.0) / seconds : 0.0) << " MB/s), "
+             << this->steals << " jobs stolen" << skipped.str() << ".");
+
+    if (!this->failures.empty()) {
+        for (const auto& failure : this->failures)
+            LOG_ERROR("Failed: " << failure);
+        throw std::runtime_error(std::to_string(this->failures.size()) + " failures during directory upload");
+    }
+}
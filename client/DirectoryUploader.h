@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Client.h"
+#include "SmallFilePack.h"
+#include "UploadIndex.h"
+
+using std::string, std::vector, std::unique_ptr;
+
+constexpr uint64_t LARGE_FILE_THRESHOLD = 8 * 1024 * 1024; // Files at least this big count against the large-file budget
+
+struct FileJob {
+    std::filesystem::path path;
+    string remoteName; // Path relative to the upload root, '/' separated
+    uint64_t size;
+    LocalFileState state;
+    vector<PackEntry> pack; // Non-empty for a batch of small files sent as one SEND_PACK upload
+};
+
+// Per-connection job deque, kept largest-first. The owner and thieves both take
+// from it, so it is guarded by a mutex; contention is one lock per file.
+class WorkStealingQueue {
+private:
+    std::mutex mutex;
+    std::deque<FileJob> jobs;
+
+public:
+    void push(FileJob job);
+    // Takes the largest job if allowLarge is set, otherwise the smallest one if it is below threshold
+    bool take(FileJob& job, bool allowLarge, uint64_t threshold);
+    size_t size();
+};
+
+// Uploads a directory tree over several authenticated connections. Files below
+// PACK_FILE_THRESHOLD are batched into packs first, the rest are sent one by one. Jobs are dealt
+// largest-first across per-connection queues; idle connections steal from busy ones.
+// At most connections - 1 connections work on large files at once, so small files
+// always keep moving instead of queueing behind multi-GB ones.
+class DirectoryUploader {
+private:
+    Client& primary;
+    std::filesystem::path root;
+    size_t connectionCount;
+    UploadIndex* uploadIndex;
+    vector<unique_ptr<WorkStealingQueue>> queues;
+
+    std::atomic<size_t> largeInFlight;
+    std::atomic<uint64_t> bytesSent;
+    std::atomic<uint64_t> filesSent;
+    std::atomic<uint64_t> steals;
+    uint64_t unchangedFiles;
+    std::mutex failuresMutex;
+    vector<string> failures;
+
+    vector<FileJob> scan();
+    void sendJob(Client& client, FileJob& job, size_t worker);
+    bool reserveLargeSlot();
+    void releaseLargeSlot();
+    bool nextJob(size_t worker, FileJob& job, bool& holdsLargeSlot);
+    unique_ptr<Client> openConnection(boost::asio::io_context& io_context) const;
+    void recordFailure(const string& message);
+    void worker(size_t index);
+
+public:
+    // primary must already be logged in; it becomes the first connection. With an index,
+    // files it reports unchanged are skipped and confirmed uploads are recorded in it.
+    DirectoryUploader(Client& primary, const std::filesystem::path& root, size_t connectionCount, UploadIndex* uploadIndex = nullptr);
+
+    // Returns once every file was attempted; throws if any file failed
+    void run();
+};
@@ -0,0 +1,375 @@
+#include "FastHash.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define FASTHASH_X86_64
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+// Layout of XXH3 as specified by xxHash 0.8; inputs are read little endian, like every
+// integer of the protocol
+constexpr size_t STRIPE_LEN = 64;
+constexpr size_t SECRET_CONSUME_RATE = 8;
+constexpr size_t SECRET_SIZE = 192;
+constexpr size_t STRIPES_PER_BLOCK = (SECRET_SIZE - STRIPE_LEN) / SECRET_CONSUME_RATE;
+constexpr size_t BUFFER_SIZE = 256;
+constexpr size_t MIDSIZE_MAX = 240;
+constexpr size_t SECRET_LASTACC_START = 7;
+constexpr size_t SECRET_MERGEACCS_START = 11;
+constexpr size_t MIDSIZE_STARTOFFSET = 3;
+constexpr size_t MIDSIZE_LASTOFFSET = 17;
+constexpr size_t SECRET_SIZE_MIN = 136;
+
+constexpr uint32_t PRIME32_1 = 0x9E3779B1U;
+constexpr uint32_t PRIME32_2 = 0x85EBCA77U;
+constexpr uint32_t PRIME32_3 = 0xC2B2AE3DU;
+constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+constexpr uint64_t PRIME_MX1 = 0x165667919E3779F9ULL;
+constexpr uint64_t PRIME_MX2 = 0x9FB21C651E98DF25ULL;
+
+alignas(64) static const unsigned char kSecret[SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+const char* hashAlgorithmName(HashAlgorithm algorithm) {
+    switch (algorithm) {
+    case HashAlgorithm::CKSUM_CRC:
+        return "cksum CRC";
+    case HashAlgorithm::XXH3_64:
+        return "XXH3-64";
+    }
+    return "unknown";
+}
+
+static inline uint64_t read64(const unsigned char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t read32(const unsigned char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint32_t swap32(uint32_t x) {
+    return ((x << 24) & 0xff000000) | ((x << 8) & 0x00ff0000) | ((x >> 8) & 0x0000ff00) | ((x >> 24) & 0x000000ff);
+}
+
+static inline uint64_t swap64(uint64_t x) {
+    return (static_cast<uint64_t>(swap32(static_cast<uint32_t>(x))) << 32) | swap32(static_cast<uint32_t>(x >> 32));
+}
+
+// Low and high halves of the 128-bit product, xored together
+static inline uint64_t mul128Fold64(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    uint64_t high;
+    uint64_t low = _umul128(a, b, &high);
+    return low ^ high;
+#else
+    uint64_t loLo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    uint64_t hiLo = (a >> 32) * (b & 0xFFFFFFFF);
+    uint64_t loHi = (a & 0xFFFFFFFF) * (b >> 32);
+    uint64_t hiHi = (a >> 32) * (b >> 32);
+    uint64_t cross = (loLo >> 32) + (hiLo & 0xFFFFFFFF) + loHi;
+    uint64_t upper = (hiLo >> 32) + (cross >> 32) + hiHi;
+    uint64_t lower = (cross << 32) | (loLo & 0xFFFFFFFF);
+    return lower ^ upper;
+#endif
+}
+
+static inline uint64_t xxh64Avalanche(uint64_t h) {
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    return h ^ (h >> 32);
+}
+
+static inline uint64_t avalanche(uint64_t h) {
+    h ^= h >> 37;
+    h *= PRIME_MX1;
+    return h ^ (h >> 32);
+}
+
+static inline uint64_t rrmxmx(uint64_t h, uint64_t length) {
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= PRIME_MX2;
+    h ^= (h >> 35) + length;
+    h *= PRIME_MX2;
+    return h ^ (h >> 28);
+}
+
+static inline uint64_t mix16B(const unsigned char* input, const unsigned char* secret) {
+    return mul128Fold64(read64(input) ^ read64(secret), read64(input + 8) ^ read64(secret + 8));
+}
+
+// Inputs of up to 240 bytes are hashed directly, without the stripe accumulators
+static uint64_t hashShort(const unsigned char* input, size_t n) {
+    if (n == 0)
+        return xxh64Avalanche(read64(kSecret + 56) ^ read64(kSecret + 64));
+    if (n <= 3) {
+        uint32_t combined = (static_cast<uint32_t>(input[0]) << 16) | (static_cast<uint32_t>(input[n >> 1]) << 24)
+            | input[n - 1] | (static_cast<uint32_t>(n) << 8);
+        uint64_t bitflip = read32(kSecret) ^ read32(kSecret + 4);
+        return xxh64Avalanche(combined ^ bitflip);
+    }
+    if (n <= 8) {
+        uint64_t bitflip = read64(kSecret + 8) ^ read64(kSecret + 16);
+        uint64_t input64 = read32(input + n - 4) + (static_cast<uint64_t>(read32(input)) << 32);
+        return rrmxmx(input64 ^ bitflip, n);
+    }
+    if (n <= 16) {
+        uint64_t low = read64(input) ^ (read64(kSecret + 24) ^ read64(kSecret + 32));
+        uint64_t high = read64(input + n - 8) ^ (read64(kSecret + 40) ^ read64(kSecret + 48));
+        return avalanche(n + swap64(low) + high + mul128Fold64(low, high));
+    }
+
+    uint64_t acc = n * PRIME64_1;
+    if (n <= 128) {
+        if (n > 32) {
+            if (n > 64) {
+                if (n > 96) {
+                    acc += mix16B(input + 48, kSecret + 96);
+                    acc += mix16B(input + n - 64, kSecret + 112);
+                }
+                acc += mix16B(input + 32, kSecret + 64);
+                acc += mix16B(input + n - 48, kSecret + 80);
+            }
+            acc += mix16B(input + 16, kSecret + 32);
+            acc += mix16B(input + n - 32, kSecret + 48);
+        }
+        acc += mix16B(input, kSecret);
+        acc += mix16B(input + n - 16, kSecret + 16);
+        return avalanche(acc);
+    }
+
+    size_t rounds = n / 16;
+    for (size_t i = 0; i < 8; i++)
+        acc += mix16B(input + 16 * i, kSecret + 16 * i);
+    acc = avalanche(acc);
+    for (size_t i = 8; i < rounds; i++)
+        acc += mix16B(input + 16 * i, kSecret + 16 * (i - 8) + MIDSIZE_STARTOFFSET);
+    acc += mix16B(input + n - 16, kSecret + SECRET_SIZE_MIN - MIDSIZE_LASTOFFSET);
+    return avalanche(acc);
+}
+
+// One 64-byte stripe into the eight accumulators
+static inline void accumulateScalar(uint64_t* acc, const unsigned char* input, const unsigned char* secret) {
+    for (size_t i = 0; i < 8; i++) {
+        uint64_t data = read64(input + 8 * i);
+        uint64_t key = data ^ read64(secret + 8 * i);
+        acc[i ^ 1] += data;
+        acc[i] += (key & 0xFFFFFFFF) * (key >> 32);
+    }
+}
+
+// Run after every block of STRIPES_PER_BLOCK stripes
+static inline void scrambleScalar(uint64_t* acc, const unsigned char* secret) {
+    for (size_t i = 0; i < 8; i++) {
+        uint64_t value = acc[i];
+        value ^= value >> 47;
+        value ^= read64(secret + 8 * i);
+        acc[i] = value * PRIME32_1;
+    }
+}
+
+[[maybe_unused]] static void consumeScalar(uint64_t* acc, size_t& stripesInBlock, const unsigned char* input, size_t stripes) {
+    for (size_t s = 0; s < stripes; s++, input += STRIPE_LEN) {
+        accumulateScalar(acc, input, kSecret + stripesInBlock * SECRET_CONSUME_RATE);
+        if (++stripesInBlock == STRIPES_PER_BLOCK) {
+            scrambleScalar(acc, kSecret + SECRET_SIZE - STRIPE_LEN);
+            stripesInBlock = 0;
+        }
+    }
+}
+
+#ifdef FASTHASH_X86_64
+// SSE2 is part of x86-64, so this is the baseline there
+static void consumeSse2(uint64_t* acc, size_t& stripesInBlock, const unsigned char* input, size_t stripes) {
+    __m128i* xacc = reinterpret_cast<__m128i*>(acc);
+    const __m128i prime = _mm_set1_epi32(static_cast<int>(PRIME32_1));
+    for (size_t s = 0; s < stripes; s++, input += STRIPE_LEN) {
+        const unsigned char* secret = kSecret + stripesInBlock * SECRET_CONSUME_RATE;
+        for (size_t i = 0; i < 4; i++) {
+            __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input) + i);
+            __m128i key = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + i));
+            __m128i product = _mm_mul_epu32(key, _mm_srli_epi64(key, 32));
+            __m128i swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            xacc[i] = _mm_add_epi64(product, _mm_add_epi64(xacc[i], swapped));
+        }
+        if (++stripesInBlock == STRIPES_PER_BLOCK) {
+            const unsigned char* scrambleSecret = kSecret + SECRET_SIZE - STRIPE_LEN;
+            for (size_t i = 0; i < 4; i++) {
+                __m128i value = _mm_xor_si128(xacc[i], _mm_srli_epi64(xacc[i], 47));
+                value = _mm_xor_si128(value, _mm_loadu_si128(reinterpret_cast<const __m128i*>(scrambleSecret) + i));
+                __m128i low = _mm_mul_epu32(value, prime);
+                __m128i high = _mm_mul_epu32(_mm_srli_epi64(value, 32), prime);
+                xacc[i] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+            }
+            stripesInBlock = 0;
+        }
+    }
+}
+
+AVX2_TARGET static void consumeAvx2(uint64_t* acc, size_t& stripesInBlock, const unsigned char* input, size_t stripes) {
+    __m256i* xacc = reinterpret_cast<__m256i*>(acc);
+    const __m256i prime = _mm256_set1_epi32(static_cast<int>(PRIME32_1));
+    for (size_t s = 0; s < stripes; s++, input += STRIPE_LEN) {
+        const unsigned char* secret = kSecret + stripesInBlock * SECRET_CONSUME_RATE;
+        for (size_t i = 0; i < 2; i++) {
+            __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input) + i);
+            __m256i key = _mm256_xor_si256(data, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret) + i));
+            __m256i product = _mm256_mul_epu32(key, _mm256_srli_epi64(key, 32));
+            __m256i swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+            xacc[i] = _mm256_add_epi64(product, _mm256_add_epi64(xacc[i], swapped));
+        }
+        if (++stripesInBlock == STRIPES_PER_BLOCK) {
+            const unsigned char* scrambleSecret = kSecret + SECRET_SIZE - STRIPE_LEN;
+            for (size_t i = 0; i < 2; i++) {
+                __m256i value = _mm256_xor_si256(xacc[i], _mm256_srli_epi64(xacc[i], 47));
+                value = _mm256_xor_si256(value, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(scrambleSecret) + i));
+                __m256i low = _mm256_mul_epu32(value, prime);
+                __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(value, 32), prime);
+                xacc[i] = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+            }
+            stripesInBlock = 0;
+        }
+    }
+}
+
+static bool cpuHasAvx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    __cpuid(info, 1);
+    bool osSavesAvx = (info[2] & (1 << 27)) and (info[2] & (1 << 28)) and (_xgetbv(0) & 6) == 6;
+    __cpuidex(info, 7, 0);
+    return osSavesAvx and (info[1] & (1 << 5));
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+using ConsumeFn = void (*)(uint64_t*, size_t&, const unsigned char*, size_t);
+
+// Picked once, from what the CPU running us supports
+static ConsumeFn consumeStripes() {
+#ifdef FASTHASH_X86_64
+    static const ConsumeFn chosen = cpuHasAvx2() ? consumeAvx2 : consumeSse2;
+    return chosen;
+#else
+    return consumeScalar;
+#endif
+}
+
+static uint64_t mergeAccs(const uint64_t* acc, uint64_t length) {
+    uint64_t result = length * PRIME64_1;
+    const unsigned char* secret = kSecret + SECRET_MERGEACCS_START;
+    for (size_t i = 0; i < 4; i++)
+        result += mul128Fold64(acc[2 * i] ^ read64(secret + 16 * i), acc[2 * i + 1] ^ read64(secret + 16 * i + 8));
+    return avalanche(result);
+}
+
+Xxh3Hasher::Xxh3Hasher()
+    : acc{ PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1 },
+      buffer{}, buffered(0), stripesInBlock(0), totalLength(0)
+{
+}
+
+void Xxh3Hasher::update(const void* data, size_t n) {
+    const unsigned char* input = static_cast<const unsigned char*>(data);
+    this->totalLength += n;
+    if (n <= BUFFER_SIZE - this->buffered) {
+        std::memcpy(this->buffer + this->buffered, input, n);
+        this->buffered += n;
+        return;
+    }
+
+    // More input follows whatever is consumed here, so none of it can be the final stripe,
+    // which digest() treats differently; at least one byte always stays buffered
+    ConsumeFn consume = consumeStripes();
+    if (this->buffered > 0) {
+        size_t fill = BUFFER_SIZE - this->buffered;
+        std::memcpy(this->buffer + this->buffered, input, fill);
+        input += fill;
+        n -= fill;
+        consume(this->acc, this->stripesInBlock, this->buffer, BUFFER_SIZE / STRIPE_LEN);
+        this->buffered = 0;
+    }
+    if (n > BUFFER_SIZE) {
+        size_t stripes = (n - 1) / STRIPE_LEN;
+        consume(this->acc, this->stripesInBlock, input, stripes);
+        input += stripes * STRIPE_LEN;
+        n -= stripes * STRIPE_LEN;
+        // digest() may need the stripe just before the buffered tail
+        std::memcpy(this->buffer + BUFFER_SIZE - STRIPE_LEN, input - STRIPE_LEN, STRIPE_LEN);
+    }
+    std::memcpy(this->buffer, input, n);
+    this->buffered = n;
+}
+
+uint64_t Xxh3Hasher::digest() const {
+    if (this->totalLength <= MIDSIZE_MAX)
+        return hashShort(this->buffer, static_cast<size_t>(this->totalLength));
+
+    alignas(32) uint64_t state[8];
+    std::memcpy(state, this->acc, sizeof(state));
+    size_t stripesInBlock = this->stripesInBlock;
+
+    // The last 64 bytes of input are always accumulated as one stripe with their own secret offset
+    unsigned char lastStripe[STRIPE_LEN];
+    const unsigned char* last;
+    if (this->buffered >= STRIPE_LEN) {
+        consumeStripes()(state, stripesInBlock, this->buffer, (this->buffered - 1) / STRIPE_LEN);
+        last = this->buffer + this->buffered - STRIPE_LEN;
+    }
+    else {
+        size_t catchUp = STRIPE_LEN - this->buffered;
+        std::memcpy(lastStripe, this->buffer + BUFFER_SIZE - catchUp, catchUp);
+        std::memcpy(lastStripe + catchUp, this->buffer, this->buffered);
+        last = lastStripe;
+    }
+    accumulateScalar(state, last, kSecret + SECRET_SIZE - STRIPE_LEN - SECRET_LASTACC_START);
+    return mergeAccs(state, this->totalLength);
+}
+
+uint64_t xxh3(const void* data, size_t n) {
+    if (n <= MIDSIZE_MAX)
+        return hashShort(static_cast<const unsigned char*>(data), n);
+    Xxh3Hasher hasher;
+    hasher.update(data, n);
+    return hasher.digest();
+}
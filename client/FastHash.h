@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Algorithms a connection can verify whole files with, agreed on during chunk negotiation.
+// CKSUM_CRC is the protocol v3 default every server understands.
+enum class HashAlgorithm : uint8_t {
+    CKSUM_CRC = 0, // POSIX cksum CRC, see Checksum.h
+    XXH3_64 = 1,   // 64-bit XXH3 as in xxHash 0.8, seed 0
+};
+
+const char* hashAlgorithmName(HashAlgorithm algorithm);
+
+// A whole-file hash together with the algorithm it was computed with; a CRC is widened
+struct FileHash {
+    HashAlgorithm algorithm;
+    uint64_t value;
+};
+
+// Streaming XXH3-64, bit-identical to XXH3_64bits() of the reference xxHash. Blocks are
+// accumulated with AVX2 when the CPU has it and SSE2 otherwise on x86-64, scalar elsewhere,
+// which runs at memory bandwidth rather than the byte-at-a-time table walk of cksum.
+class Xxh3Hasher {
+private:
+    alignas(32) uint64_t acc[8];
+    unsigned char buffer[256]; // Input not consumed yet; also keeps the stripe before it for digest()
+    size_t buffered;
+    size_t stripesInBlock;
+    uint64_t totalLength;
+
+public:
+    Xxh3Hasher();
+
+    void update(const void* data, size_t n);
+    // Hash of everything fed so far; more data may still be fed afterwards
+    uint64_t digest() const;
+};
+
+// One-shot XXH3-64 of a memory block
+uint64_t xxh3(const void* data, size_t n);
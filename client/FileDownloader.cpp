@@ -0,0 +1,205 @@
+#include "FileDownloader.h"
+#include <algorithm>
+#include <chrono>
+#include "Logger.h"
+#include <stdexcept>
+#include <thread>
+#include "Checksum.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Sizes the file up front so ranges can be written at their offsets in any order. On
+// Windows extending the file already allocates its clusters; on Linux it would be sparse,
+// so the blocks are reserved explicitly.
+static void preallocate(const std::filesystem::path& path, uint64_t size) {
+    std::filesystem::resize_file(path, size);
+#ifdef __linux__
+    int fd = ::open(path.c_str(), O_WRONLY);
+    if (fd >= 0) {
+        posix_fallocate(fd, 0, static_cast<off_t>(size));
+        ::close(fd);
+    }
+#endif
+}
+
+FileDownloader::FileDownloader(Client& primary, const string& remoteName, const std::filesystem::path& destination, size_t connectionCount,
+                               TransferProgress* progress)
+    : primary(primary), remoteName(remoteName), destination(destination), partPath(destination.string() + ".part"),
+      connectionCount(connectionCount), fileSize(0), progress(progress), nextOffset(0), bytesReceived(0)
+{
+    if (connectionCount == 0)
+        throw std::invalid_argument("Download needs at least one connection");
+}
+
+bool FileDownloader::takeRange(DownloadRange& range) {
+    std::lock_guard<std::mutex> lock(this->rangesMutex);
+    // Ranges given back by a failed connection go first, they hold up the end of the file
+    if (!this->retries.empty()) {
+        range = this->retries.front();
+        this->retries.pop_front();
+        return true;
+    }
+    if (this->nextOffset >= this->fileSize)
+        return false;
+    range.offset = this->nextOffset;
+    range.length = static_cast<uint32_t>(std::min<uint64_t>(DOWNLOAD_RANGE_SIZE, this->fileSize - this->nextOffset));
+    this->nextOffset += range.length;
+    return true;
+}
+
+void FileDownloader::returnRanges(const std::deque<DownloadRange>& ranges) {
+    std::lock_guard<std::mutex> lock(this->rangesMutex);
+    this->retries.insert(this->retries.end(), ranges.begin(), ranges.end());
+}
+
+void FileDownloader::fetch(Client& client, std::fstream& out) {
+    std::deque<DownloadRange> inFlight;
+    string data;
+    try {
+        while (true) {
+            // Step 1: Top up the window, answers stream back while earlier ones are written
+            DownloadRange range;
+            while (inFlight.size() < DOWNLOAD_WINDOW and takeRange(range)) {
+                client.requestRange(this->remoteName, range.offset, range.length);
+                inFlight.push_back(range);
+            }
+            if (inFlight.empty())
+                return;
+
+            // Step 2: The server answers in request order; decrypt and write in place
+            uint64_t offset = client.readRange(data);
+            if (offset != inFlight.front().offset or data.size() != inFlight.front().length) {
+                throw std::runtime_error("Server answered range at offset " + std::to_string(offset) + " out of order");
+            }
+            out.seekp(static_cast<std::streamoff>(offset));
+            out.write(data.data(), static_cast<std::streamsize>(data.size()));
+            if (!out) {
+                throw std::runtime_error("Failed to write " + this->partPath.string());
+            }
+            this->bytesReceived += data.size();
+            if (this->progress != nullptr)
+                this->progress->bytesDone.fetch_add(data.size(), std::memory_order_relaxed);
+            inFlight.pop_front();
+        }
+    }
+    catch (const std::exception&) {
+        returnRanges(inFlight);
+        throw;
+    }
+}
+
+unique_ptr<Client> FileDownloader::openConnection(boost::asio::io_context& io_context) const {
+    auto client = std::make_unique<Client>(io_context);
+    client->copyIdentity(this->primary);
+    client->connect();
+    client->login();
+    return client;
+}
+
+void FileDownloader::recordFailure(const string& message) {
+    std::lock_guard<std::mutex> lock(this->failuresMutex);
+    this->failures.push_back(message);
+}
+
+void FileDownloader::worker(size_t index) {
+    boost::asio::io_context io_context;
+    unique_ptr<Client> owned;
+    Client* client = index == 0 ? &this->primary : nullptr;  // The others log in on their own connection first
+
+    std::fstream out(this->partPath, std::ios::in | std::ios::out | std::ios::binary);
+    if (!out.is_open()) {
+        recordFailure("Connection " + std::to_string(index) + " could not open " + this->partPath.string());
+        return;
+    }
+
+    for (int reconnects = 0; ; reconnects++) {
+        try {
+            if (client == nullptr) {
+                owned = openConnection(io_context);
+                client = owned.get();
+            }
+            fetch(*client, out);
+            break;
+        }
+        catch (const std::exception& e) {
+            recordFailure("Connection " + std::to_string(index) + ": " + e.what());
+            // The connection may be mid-answer after a failure, its ranges were given back; start a fresh session
+            client = nullptr;
+            if (reconnects == MAX_DOWNLOAD_RECONNECTS)
+                return;
+        }
+    }
+
+    if (owned) {
+        try {
+            owned->closeConnection();
+        }
+        catch (const std::exception&) {
+        }
+    }
+}
+
+uint32_t FileDownloader::partChecksum() const {
+    // Segments are read back and CRCed on every core, then combined into the one cksum CRC
+    return filecrcParallel(this->partPath);
+}
+
+bool FileDownloader::hadFailures() {
+    std::lock_guard<std::mutex> lock(this->failuresMutex);
+    return !this->failures.empty();
+}
+
+uint32_t FileDownloader::run() {
+    // Step 1: Size and checksum of the stored file
+    auto info = this->primary.requestFileInfo(this->remoteName);
+    this->fileSize = info.getFileSize();
+    if (this->progress != nullptr) {
+        this->progress->bytesDone.store(0, std::memory_order_relaxed);
+        this->progress->bytesTotal.store(this->fileSize, std::memory_order_relaxed);
+    }
+    uint64_t rangeCount = (this->fileSize + DOWNLOAD_RANGE_SIZE - 1) / DOWNLOAD_RANGE_SIZE;
+    size_t connections = static_cast<size_t>(std::max<uint64_t>(1, std::min<uint64_t>(this->connectionCount, rangeCount)));
+
+    // Step 2: Preallocate the partial file next to the destination
+    {
+        std::ofstream create(this->partPath, std::ios::binary | std::ios::trunc);
+        if (!create.is_open()) {
+            throw std::runtime_error("Failed to create " + this->partPath.string());
+        }
+    }
+    preallocate(this->partPath, this->fileSize);
+
+    LOG_INFO("Downloading " << this->remoteName << " (" << this->fileSize << " bytes, " << rangeCount << " ranges) to "
+             << this->destination << " over " << connections << " connections.");
+
+    // Step 3: Every connection pulls ranges until none are left
+    auto start = std::chrono::steady_clock::now();
+    vector<std::thread> workers;
+    for (size_t i = 0; i < connections; i++)
+        workers.emplace_back(&FileDownloader::worker, this, i);
+    for (auto& worker : workers)
+        worker.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for (const auto& failure : this->failures)
+        LOG_WARN("Download: " << failure);
+    if (this->bytesReceived != this->fileSize) {
+        throw std::runtime_error("Download of " + this->remoteName + " incomplete: " + std::to_string(this->bytesReceived)
+                                 + " of " + std::to_string(this->fileSize) + " bytes, no connection left");
+    }
+
+    // Step 4: Verify with the same CRC as uploads, then move the file into place
+    uint32_t checksum = partChecksum();
+    if (checksum != info.getChecksum()) {
+        std::filesystem::remove(this->partPath);
+        throw std::runtime_error("Checksum of downloaded " + this->remoteName + " does not match the server's");
+    }
+    std::filesystem::rename(this->partPath, this->destination);
+
+    LOG_INFO("Download finished: " << this->fileSize << " bytes in " << seconds << " s ("
+             << (seconds > 0 ? this->fileSize / (1024.0 * 1024.0) / seconds : 0.0) << " MB/s), checksum ok.");
+    return checksum;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Client.h"
+#include "TransferProgress.h"
+
+using std::string, std::vector, std::unique_ptr;
+
+constexpr uint32_t DOWNLOAD_RANGE_SIZE = 1024 * 1024; // Plaintext bytes asked for by one READ_RANGE request
+constexpr size_t DOWNLOAD_WINDOW = 4;                 // Range requests kept in flight on each connection
+constexpr int MAX_DOWNLOAD_RECONNECTS = 3;            // Fresh sessions one connection may start after failures
+
+struct DownloadRange {
+    uint64_t offset;
+    uint32_t length;
+};
+
+// Restores one stored file over several authenticated connections. The file is cut into
+// DOWNLOAD_RANGE_SIZE ranges; each connection keeps DOWNLOAD_WINDOW of them requested ahead,
+// so the server never waits for a round trip, and decrypts and writes every answer straight
+// to its offset in a preallocated "<destination>.part". Ranges a failed connection still had
+// outstanding go back to the pool. The finished file must match the server's cksum CRC, the
+// one uploads are verified with, before it replaces the destination.
+class FileDownloader {
+private:
+    Client& primary;
+    string remoteName;
+    std::filesystem::path destination;
+    std::filesystem::path partPath;
+    size_t connectionCount;
+    uint64_t fileSize;
+    TransferProgress* progress;
+
+    std::mutex rangesMutex;
+    uint64_t nextOffset;
+    std::deque<DownloadRange> retries;
+    std::atomic<uint64_t> bytesReceived;
+    std::mutex failuresMutex;
+    vector<string> failures;
+
+    bool takeRange(DownloadRange& range);
+    void returnRanges(const std::deque<DownloadRange>& ranges);
+    void fetch(Client& client, std::fstream& out);
+    unique_ptr<Client> openConnection(boost::asio::io_context& io_context) const;
+    void recordFailure(const string& message);
+    void worker(size_t index);
+    uint32_t partChecksum() const;
+
+public:
+    // primary must already be logged in; it becomes the first connection
+    // progress, when given, follows the bytes written to the partial file
+    FileDownloader(Client& primary, const string& remoteName, const std::filesystem::path& destination, size_t connectionCount,
+                   TransferProgress* progress = nullptr);
+
+    // Returns the file's cksum CRC once the destination holds the verified file; throws otherwise and leaves the destination untouched
+    uint32_t run();
+    // A connection failed and was replaced during run(); primary may then be left mid-answer
+    bool hadFailures();
+};
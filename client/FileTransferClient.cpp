@@ -0,0 +1,247 @@
+#include "FileTransferClient.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include "FileDownloader.h"
+#include "Logger.h"
+
+ClientIdentity ClientIdentity::load(const std::filesystem::path& directory) {
+    boost::asio::io_context io_context;
+    Client client(io_context);
+    client.loadMeInfo(directory);
+    client.loadPrivateKey(directory);
+    return { client.getName(), client.getClientID(), client.getPrivateKey() };
+}
+
+void ClientIdentity::save(const std::filesystem::path& directory) const {
+    boost::asio::io_context io_context;
+    Client client(io_context);
+    client.setIdentity(this->name, this->clientID, this->privateKey);
+    client.saveClientInfo(directory);
+    client.savePrivateKey(directory);
+}
+
+bool TransferHandle::isDone() const {
+    return this->state->future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+bool TransferHandle::cancel() const {
+    int queued = TransferState::QUEUED;
+    if (!this->state->phase.compare_exchange_strong(queued, TransferState::FINISHED))
+        return false;
+    // The client takes it out of its queue and runs onComplete on one of its own threads
+    this->state->promise.set_exception(std::make_exception_ptr(std::runtime_error("Transfer of " + this->state->remoteName + " cancelled")));
+    return true;
+}
+
+ClientIdentity FileTransferClient::registerIdentity(const ClientConfig& config, const string& name) {
+    boost::asio::io_context io_context;
+    Client client(io_context);
+    client.setServer(config.address, config.port);
+    client.setName(name);
+    client.connect();
+    client.registrate();
+    client.sendRSAreceiveAES();
+    client.closeConnection();
+    return { client.getName(), client.getClientID(), client.getPrivateKey() };
+}
+
+FileTransferClient::FileTransferClient(const ClientIdentity& identity, const ClientConfig& config)
+    : config(config), limiter(config.rate, config.burst), identity(io_context), stopping(false)
+{
+    if (config.sessions == 0 or config.downloadConnections == 0)
+        throw std::invalid_argument("A transfer client needs at least one session and one download connection");
+
+    // Step 1: Everything the pooled sessions copy: server, identity, priority and this client's own rate limit
+    this->identity.setServer(config.address, config.port);
+    this->identity.setIdentity(identity.name, identity.clientID, identity.privateKey);
+    this->identity.setPriority(config.priority);
+    this->identity.setRateLimiter(this->limiter);
+
+    // Step 2: The pool logs its first session in now, then the threads that run and watch transfers
+    this->pool = std::make_unique<SessionPool>(this->identity, config.sessions);
+    for (size_t i = 0; i < config.sessions; i++)
+        this->workers.emplace_back(&FileTransferClient::worker, this);
+    this->reporter = std::thread(&FileTransferClient::reportProgress, this);
+}
+
+FileTransferClient::~FileTransferClient() {
+    std::deque<shared_ptr<TransferState>> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+        abandoned.swap(this->queue);
+    }
+    this->changed.notify_all();
+    this->stopped.notify_all();
+    for (auto& worker : this->workers)
+        worker.join();
+    this->reporter.join();
+
+    for (const auto& transfer : abandoned) {
+        int queued = TransferState::QUEUED;
+        if (transfer->phase.compare_exchange_strong(queued, TransferState::FINISHED))
+            complete(transfer, std::make_exception_ptr(std::runtime_error("Transfer client shut down before the transfer started")), nullptr);
+        else
+            notifyComplete(transfer);  // Cancelled, the reporter did not get to it
+    }
+}
+
+void FileTransferClient::setRateLimit(uint64_t bytesPerSecond, uint64_t burstBytes) {
+    this->limiter.setLimit(bytesPerSecond, burstBytes);
+}
+
+TransferHandle FileTransferClient::upload(const std::filesystem::path& localPath, const string& remoteName,
+                                          CompletionCallback onComplete, ProgressCallback onProgress) {
+    auto transfer = std::make_shared<TransferState>();
+    transfer->kind = TransferKind::UPLOAD;
+    transfer->localPath = localPath;
+    transfer->remoteName = remoteName.empty() ? localPath.filename().string() : remoteName;
+    transfer->onComplete = std::move(onComplete);
+    transfer->onProgress = std::move(onProgress);
+    return submit(std::move(transfer));
+}
+
+TransferHandle FileTransferClient::download(const string& remoteName, const std::filesystem::path& destination,
+                                            CompletionCallback onComplete, ProgressCallback onProgress) {
+    auto transfer = std::make_shared<TransferState>();
+    transfer->kind = TransferKind::DOWNLOAD;
+    transfer->localPath = destination;
+    transfer->remoteName = remoteName;
+    transfer->onComplete = std::move(onComplete);
+    transfer->onProgress = std::move(onProgress);
+    return submit(std::move(transfer));
+}
+
+TransferHandle FileTransferClient::submit(shared_ptr<TransferState> transfer) {
+    transfer->future = transfer->promise.get_future().share();
+    TransferHandle handle(transfer);
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->stopping)
+            throw std::runtime_error("Transfer client is shutting down");
+        this->queue.push_back(std::move(transfer));
+    }
+    this->changed.notify_one();
+    return handle;
+}
+
+TransferResult FileTransferClient::execute(TransferState& transfer) {
+    TransferResult result{ transfer.kind, transfer.localPath, transfer.remoteName, 0, { HashAlgorithm::CKSUM_CRC, 0 } };
+    auto session = this->pool->checkout();
+    if (transfer.kind == TransferKind::UPLOAD) {
+        session->setProgress(&transfer.progress);
+        result.hash = session->sendFile(transfer.localPath, transfer.remoteName);
+        // A failed upload never returns its session to the pool, so the pointer can not outlive the transfer
+        session->setProgress(nullptr);
+    }
+    else {
+        // The ranges run over connections of their own, the leased session asks for the file's size and checksum
+        FileDownloader downloader(session.client(), transfer.remoteName, transfer.localPath, this->config.downloadConnections, &transfer.progress);
+        result.hash = { HashAlgorithm::CKSUM_CRC, downloader.run() };
+        if (downloader.hadFailures())
+            session.discard();
+    }
+    result.size = transfer.progress.bytesTotal.load(std::memory_order_relaxed);
+    return result;
+}
+
+void FileTransferClient::complete(const shared_ptr<TransferState>& transfer, std::exception_ptr error, TransferResult* result) {
+    if (error)
+        transfer->promise.set_exception(error);
+    else
+        transfer->promise.set_value(std::move(*result));
+    notifyComplete(transfer);
+}
+
+void FileTransferClient::notifyComplete(const shared_ptr<TransferState>& transfer) {
+    if (transfer->onComplete) {
+        try {
+            transfer->onComplete(TransferHandle(transfer));
+        }
+        catch (const std::exception& e) {
+            LOG_WARN("Completion callback of " << transfer->remoteName << " threw: " << e.what());
+        }
+    }
+}
+
+void FileTransferClient::worker() {
+    while (true) {
+        // Step 1: The oldest queued transfer that was not cancelled meanwhile
+        shared_ptr<TransferState> transfer;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->changed.wait(lock, [this] { return this->stopping or !this->queue.empty(); });
+            if (this->stopping)
+                return;
+            transfer = std::move(this->queue.front());
+            this->queue.pop_front();
+            int queued = TransferState::QUEUED;
+            if (transfer->phase.compare_exchange_strong(queued, TransferState::RUNNING))
+                this->running.push_back(transfer);
+        }
+        if (transfer->phase.load() == TransferState::FINISHED) {
+            // Cancelled; its future already failed, only the callback is left
+            notifyComplete(transfer);
+            continue;
+        }
+
+        // Step 2: Run it on a pooled session
+        TransferResult result;
+        std::exception_ptr error;
+        try {
+            result = execute(*transfer);
+        }
+        catch (const std::exception& e) {
+            LOG_WARN("Transfer of " << transfer->remoteName << " failed: " << e.what());
+            error = std::current_exception();
+        }
+
+        // Step 3: Last progress report, then the result
+        report(*transfer);
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->running.erase(std::find(this->running.begin(), this->running.end(), transfer));
+        }
+        transfer->phase.store(TransferState::FINISHED);
+        complete(transfer, error, &result);
+    }
+}
+
+void FileTransferClient::report(TransferState& transfer) {
+    if (!transfer.onProgress)
+        return;
+    std::lock_guard<std::mutex> lock(transfer.reportMutex);
+    uint64_t done = transfer.progress.bytesDone.load(std::memory_order_relaxed);
+    uint64_t total = transfer.progress.bytesTotal.load(std::memory_order_relaxed);
+    if (done == transfer.reportedBytes or total == 0)
+        return;
+    transfer.reportedBytes = done;
+    try {
+        transfer.onProgress(done, total);
+    }
+    catch (const std::exception& e) {
+        LOG_WARN("Progress callback of " << transfer.remoteName << " threw: " << e.what());
+    }
+}
+
+void FileTransferClient::reportProgress() {
+    auto isCancelled = [](const shared_ptr<TransferState>& transfer) { return transfer->phase.load() == TransferState::FINISHED; };
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (!this->stopped.wait_for(lock, this->config.progressInterval, [this] { return this->stopping; })) {
+        // Cancelled transfers leave the queue here, so their completion runs on this thread
+        vector<shared_ptr<TransferState>> cancelled;
+        std::copy_if(this->queue.begin(), this->queue.end(), std::back_inserter(cancelled), isCancelled);
+        if (!cancelled.empty())
+            this->queue.erase(std::remove_if(this->queue.begin(), this->queue.end(), isCancelled), this->queue.end());
+
+        // Callbacks run without the lock, so they may start new transfers
+        vector<shared_ptr<TransferState>> snapshot = this->running;
+        lock.unlock();
+        for (const auto& transfer : cancelled)
+            notifyComplete(transfer);
+        for (const auto& transfer : snapshot)
+            report(*transfer);
+        lock.lock();
+    }
+}
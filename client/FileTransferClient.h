@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Client.h"
+#include "RateLimiter.h"
+#include "SessionPool.h"
+#include "TransferProgress.h"
+
+using std::string, std::vector, std::shared_ptr, std::unique_ptr;
+
+// Who the client is to the server, what me.info and priv.key hold for the command line client
+struct ClientIdentity {
+    string name;
+    string clientID;    // The 16 raw bytes the server assigned at registration
+    string privateKey;  // Raw RSA private key, its public half is what the server knows
+
+    // me.info and priv.key from directory, as the command line client writes them
+    static ClientIdentity load(const std::filesystem::path& directory);
+    void save(const std::filesystem::path& directory) const;
+};
+
+// What transfer.info and the command line flags set for the command line client
+struct ClientConfig {
+    string address = "127.0.0.1";
+    string port = "12345";
+    size_t sessions = 4;             // Transfers running at once, each over its own logged-in connection
+    size_t downloadConnections = 4;  // Connections one download spreads its ranges over
+    TransferPriority priority = TransferPriority::BULK;
+    uint64_t rate = 0;               // Bytes per second over every transfer of this client, 0 for unlimited
+    uint64_t burst = 0;              // 0 picks the RateLimiter default
+    std::chrono::milliseconds progressInterval = std::chrono::milliseconds(100); // How often progress callbacks run
+};
+
+enum class TransferKind : uint8_t {
+    UPLOAD = 0,
+    DOWNLOAD = 1
+};
+
+struct TransferResult {
+    TransferKind kind;
+    std::filesystem::path localPath;
+    string remoteName;
+    uint64_t size;
+    FileHash hash;      // Confirmed by the server: an upload's agreed hash, a download's cksum CRC
+};
+
+class TransferHandle;
+
+// Both run on a thread of the FileTransferClient and should return quickly; only transfers
+// still queued when the client is destroyed complete on the destroying thread
+using CompletionCallback = std::function<void(const TransferHandle& transfer)>;
+using ProgressCallback = std::function<void(uint64_t bytesDone, uint64_t bytesTotal)>;
+
+// Shared by the handles of one transfer and the client running it
+struct TransferState {
+    enum Phase : int { QUEUED, RUNNING, FINISHED };
+
+    TransferKind kind;
+    std::filesystem::path localPath;
+    string remoteName;
+    TransferProgress progress;
+    std::atomic<int> phase{ QUEUED };
+    std::promise<TransferResult> promise;
+    std::shared_future<TransferResult> future;
+    CompletionCallback onComplete;
+    ProgressCallback onProgress;
+    std::mutex reportMutex;      // One progress callback at a time, the last one before completion
+    uint64_t reportedBytes = ~0ULL;
+};
+
+// Refers to one upload or download; cheap to copy, and valid after the client is gone
+class TransferHandle {
+private:
+    shared_ptr<TransferState> state;
+
+public:
+    TransferHandle() = default;
+    explicit TransferHandle(shared_ptr<TransferState> state) : state(std::move(state)) {}
+
+    bool isValid() const { return this->state != nullptr; }
+    TransferKind getKind() const { return this->state->kind; }
+    const string& getRemoteName() const { return this->state->remoteName; }
+    const std::filesystem::path& getLocalPath() const { return this->state->localPath; }
+
+    const std::shared_future<TransferResult>& future() const { return this->state->future; }
+    // Blocks until the transfer is done; throws what the transfer failed with
+    const TransferResult& get() const { return this->state->future.get(); }
+    void wait() const { this->state->future.wait(); }
+    bool isDone() const;
+
+    uint64_t getBytesDone() const { return this->state->progress.bytesDone.load(std::memory_order_relaxed); }
+    uint64_t getBytesTotal() const { return this->state->progress.bytesTotal.load(std::memory_order_relaxed); }
+
+    // Only a transfer that has not started can be cancelled; it then fails with an error at
+    // once, and its completion callback runs on the client's reporter thread within a progress
+    // interval. Returns false when it already started.
+    bool cancel() const;
+};
+
+// The client as a library: many of them can run in one process, each with its own
+// identity, server, rate limit and connections, nothing read from or written to the
+// working directory. upload() and download() only queue the transfer and return a handle
+// at once; up to config.sessions transfers run at the same time, each over a connection
+// of a SessionPool that stays logged in between transfers. Transfers store their progress
+// in atomic counters as they go, and a reporter thread hands changes to the progress
+// callbacks every progressInterval, so watching a transfer does not slow it down.
+// The logger (Logger::global()) is the one thing shared by every client in the process.
+class FileTransferClient {
+private:
+    ClientConfig config;
+    RateLimiter limiter;
+    boost::asio::io_context io_context;  // identity never connects, pooled sessions copy it
+    Client identity;
+    unique_ptr<SessionPool> pool;
+
+    std::mutex mutex;
+    std::condition_variable changed;  // Workers wait on it for the queue
+    std::condition_variable stopped;  // The reporter waits on it between reports
+    std::deque<shared_ptr<TransferState>> queue;
+    vector<shared_ptr<TransferState>> running;
+    bool stopping;
+    vector<std::thread> workers;
+    std::thread reporter;
+
+    TransferHandle submit(shared_ptr<TransferState> transfer);
+    TransferResult execute(TransferState& transfer);
+    void complete(const shared_ptr<TransferState>& transfer, std::exception_ptr error, TransferResult* result);
+    static void notifyComplete(const shared_ptr<TransferState>& transfer);
+    void worker();
+    void reportProgress();
+    static void report(TransferState& transfer);
+
+public:
+    // Registers name with the server and exchanges keys; save() the result to keep it
+    static ClientIdentity registerIdentity(const ClientConfig& config, const string& name);
+
+    // Logs in once right away, so a wrong identity or an unreachable server fails here
+    FileTransferClient(const ClientIdentity& identity, const ClientConfig& config);
+    // Running transfers finish, queued ones fail
+    ~FileTransferClient();
+
+    FileTransferClient(const FileTransferClient&) = delete;
+    FileTransferClient& operator=(const FileTransferClient&) = delete;
+
+    // remoteName defaults to the file's name
+    TransferHandle upload(const std::filesystem::path& localPath, const string& remoteName = "",
+                          CompletionCallback onComplete = nullptr, ProgressCallback onProgress = nullptr);
+    // destination is only replaced once the whole file arrived and matched the server's checksum
+    TransferHandle download(const string& remoteName, const std::filesystem::path& destination,
+                            CompletionCallback onComplete = nullptr, ProgressCallback onProgress = nullptr);
+
+    // May be called from any thread while transfers are running
+    void setRateLimit(uint64_t bytesPerSecond, uint64_t burstBytes = 0);
+};
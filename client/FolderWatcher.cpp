@@ -0,0 +1,238 @@
+#include "FolderWatcher.h"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+#include "Logger.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+constexpr uint32_t WATCH_EVENTS = IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_MOVE_SELF;
+#endif
+
+FolderWatcher::FolderWatcher(vector<std::filesystem::path> roots, std::chrono::milliseconds debounce)
+    : debounce(debounce), stopping(false)
+{
+    for (const auto& root : roots) {
+        if (!std::filesystem::is_directory(root))
+            throw std::runtime_error("Not a directory: " + root.string());
+        std::filesystem::path normal = std::filesystem::absolute(root).lexically_normal();
+        // "dir/" normalizes to "dir/" with an empty filename; drop the separator so the root keeps its name
+        if (!normal.has_filename())
+            normal = normal.parent_path();
+        this->roots.push_back(normal);
+    }
+#ifdef __linux__
+    this->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (this->inotifyFd < 0)
+        throw std::runtime_error(string("inotify_init1 failed: ") + std::strerror(errno));
+    for (const auto& root : this->roots)
+        addTree(root, root, false);
+#else
+    // A file has to look the same in two scans in a row, however short the debounce
+    this->debounce = std::max(debounce, std::chrono::duration_cast<std::chrono::milliseconds>(WATCH_POLL_INTERVAL));
+    rescan();
+    this->pending.clear();  // Files that were there before the watch started are not reported
+#endif
+}
+
+FolderWatcher::~FolderWatcher() {
+#ifdef __linux__
+    close(this->inotifyFd);
+#endif
+}
+
+void FolderWatcher::stop() {
+    this->stopping.store(true);
+}
+
+void FolderWatcher::touch(const std::filesystem::path& root, const std::filesystem::path& file, bool closed) {
+    auto now = Clock::now();
+    auto inserted = this->pending.try_emplace(file.string(), Pending{ root, now, now, false });
+    Pending& entry = inserted.first->second;
+    entry.lastEvent = now;
+    // A write after a close means someone reopened the file, wait for that writer to close it too
+    entry.closed = closed;
+    if (closed)
+        entry.closedAt = now;
+}
+
+void FolderWatcher::reportReady(const Callback& ready) {
+    auto now = Clock::now();
+    vector<std::pair<std::filesystem::path, Pending>> complete;
+    for (auto it = this->pending.begin(); it != this->pending.end();) {
+        if (it->second.closed and now - it->second.lastEvent >= this->debounce) {
+            complete.emplace_back(it->first, it->second);
+            it = this->pending.erase(it);
+        }
+        else {
+            it++;
+        }
+    }
+    for (const auto& [file, entry] : complete)
+        ready(entry.root, file, entry.closedAt);
+}
+
+#ifdef __linux__
+
+void FolderWatcher::addTree(const std::filesystem::path& root, const std::filesystem::path& directory, bool reportExisting) {
+    int watch = inotify_add_watch(this->inotifyFd, directory.c_str(), WATCH_EVENTS | IN_ONLYDIR);
+    if (watch < 0) {
+        LOG_WARN("Can not watch " << directory << ": " << std::strerror(errno));
+        return;
+    }
+    this->watches[watch] = { root, directory };
+
+    // Watched before listing, so nothing created in between is missed; a new directory
+    // may already have files in it by the time its watch exists
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, std::filesystem::directory_options::skip_permission_denied, error)) {
+        if (entry.is_symlink(error))
+            continue;
+        if (entry.is_directory(error))
+            addTree(root, entry.path(), reportExisting);
+        else if (reportExisting and entry.is_regular_file(error))
+            touch(root, entry.path(), true);
+    }
+}
+
+// Whether path is directory or anything below it
+static bool isWithin(const std::filesystem::path& path, const std::filesystem::path& directory) {
+    const string& full = path.native();
+    const string& prefix = directory.native();
+    return full.compare(0, prefix.size(), prefix) == 0
+        and (full.size() == prefix.size() or full[prefix.size()] == std::filesystem::path::preferred_separator);
+}
+
+void FolderWatcher::removeTree(const std::filesystem::path& directory) {
+    // Its watches would keep reporting files under the old path
+    for (auto it = this->watches.begin(); it != this->watches.end();) {
+        if (isWithin(it->second.second, directory)) {
+            inotify_rm_watch(this->inotifyFd, it->first);
+            it = this->watches.erase(it);
+        }
+        else {
+            it++;
+        }
+    }
+    for (auto it = this->pending.begin(); it != this->pending.end();)
+        it = isWithin(it->first, directory) ? this->pending.erase(it) : std::next(it);
+}
+
+void FolderWatcher::readEvents() {
+    alignas(inotify_event) char buffer[64 * 1024];
+    while (true) {
+        ssize_t length = read(this->inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0)
+            return;  // EAGAIN once the queue is drained
+
+        for (char* next = buffer; next < buffer + length;) {
+            auto* event = reinterpret_cast<inotify_event*>(next);
+            next += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost; look at every file again, the upload index skips unchanged ones
+                LOG_WARN("inotify queue overflowed, rescanning the watched folders");
+                for (const auto& root : this->roots)
+                    addTree(root, root, true);
+                continue;
+            }
+            auto watch = this->watches.find(event->wd);
+            if (watch == this->watches.end())
+                continue;
+            if (event->mask & IN_IGNORED) {
+                this->watches.erase(watch);
+                continue;
+            }
+            if (event->mask & IN_MOVE_SELF) {
+                // A subdirectory's move is handled through its parent's IN_MOVED_FROM, so this is a root
+                LOG_WARN(watch->second.second << " was moved away, it is no longer watched");
+                removeTree(std::filesystem::path(watch->second.second));
+                continue;
+            }
+            if (event->len == 0)
+                continue;
+
+            const auto [root, directory] = watch->second;
+            std::filesystem::path path = directory / event->name;
+            if (event->mask & IN_ISDIR) {
+                // A rename within the trees is a move from one path and a move to another
+                if (event->mask & IN_MOVED_FROM)
+                    removeTree(path);
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    addTree(root, path, true);
+            }
+            else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                this->pending.erase(path.string());
+            }
+            else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                touch(root, path, true);
+            }
+            else if (event->mask & (IN_MODIFY | IN_CREATE)) {
+                touch(root, path, false);
+            }
+        }
+    }
+}
+
+void FolderWatcher::run(const Callback& ready) {
+    while (!this->stopping.load()) {
+        // Wake up when the next pending file's debounce ends, or to check stop()
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(WATCH_STOP_CHECK);
+        auto now = Clock::now();
+        for (const auto& [file, entry] : this->pending) {
+            if (entry.closed) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(entry.lastEvent + this->debounce - now);
+                wait = std::clamp(left, std::chrono::milliseconds(0), wait);
+            }
+        }
+
+        pollfd descriptor{ this->inotifyFd, POLLIN, 0 };
+        if (poll(&descriptor, 1, static_cast<int>(wait.count())) > 0 and (descriptor.revents & POLLIN))
+            readEvents();
+        reportReady(ready);
+    }
+}
+
+#else
+
+void FolderWatcher::rescan() {
+    std::unordered_map<string, Snapshot> seen;
+    for (const auto& root : this->roots) {
+        std::error_code error;
+        std::filesystem::recursive_directory_iterator it(root, std::filesystem::directory_options::skip_permission_denied, error);
+        for (; !error and it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+            std::error_code statError;
+            if (!it->is_regular_file(statError))
+                continue;
+            Snapshot snapshot{ it->file_size(statError), it->last_write_time(statError) };
+            if (statError)
+                continue;  // Deleted while scanning
+            string key = it->path().string();
+            auto previous = this->snapshots.find(key);
+            if (previous == this->snapshots.end() or previous->second.size != snapshot.size or previous->second.mtime != snapshot.mtime)
+                touch(root, it->path(), true);
+            seen.emplace(std::move(key), snapshot);
+        }
+    }
+    // Files that disappeared before they settled are not reported
+    for (auto it = this->pending.begin(); it != this->pending.end();)
+        it = seen.count(it->first) ? std::next(it) : this->pending.erase(it);
+    this->snapshots = std::move(seen);
+}
+
+void FolderWatcher::run(const Callback& ready) {
+    while (!this->stopping.load()) {
+        rescan();
+        reportReady(ready);
+        auto nextScan = Clock::now() + WATCH_POLL_INTERVAL;
+        while (!this->stopping.load() and Clock::now() < nextScan)
+            std::this_thread::sleep_for(std::min<Clock::duration>(WATCH_STOP_CHECK, nextScan - Clock::now()));
+    }
+}
+
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using std::string, std::vector;
+
+constexpr auto WATCH_POLL_INTERVAL = std::chrono::milliseconds(500); // Rescan period where inotify is not available
+constexpr auto WATCH_STOP_CHECK = std::chrono::milliseconds(100);    // Longest the event loop waits before checking stop()
+
+// Reports files under a set of directory trees once they are complete. On Linux the trees
+// are watched with inotify: a file is complete when it was closed after writing (or moved
+// in) and then nothing touched it for the debounce period, so files written in several
+// open/close rounds are reported once. Directories created or moved in later are watched
+// as they appear, and directories moved away stop being watched. Elsewhere the trees are
+// rescanned every WATCH_POLL_INTERVAL and a file is complete once its size and
+// modification time stayed the same for the debounce period.
+class FolderWatcher {
+public:
+    using Clock = std::chrono::steady_clock;
+    // root is the watched directory the file is under; closedAt is when its last write was seen
+    using Callback = std::function<void(const std::filesystem::path& root, const std::filesystem::path& file, Clock::time_point closedAt)>;
+
+private:
+    struct Pending {
+        std::filesystem::path root;
+        Clock::time_point lastEvent;
+        Clock::time_point closedAt;
+        bool closed;  // Closed after writing or moved in; only modified otherwise
+    };
+    struct Snapshot {
+        uintmax_t size;
+        std::filesystem::file_time_type mtime;
+    };
+
+    vector<std::filesystem::path> roots;
+    std::chrono::milliseconds debounce;
+    std::atomic<bool> stopping;
+    std::unordered_map<string, Pending> pending;  // By path
+#ifdef __linux__
+    int inotifyFd;
+    std::unordered_map<int, std::pair<std::filesystem::path, std::filesystem::path>> watches; // Watch descriptor -> (root, directory)
+
+    void addTree(const std::filesystem::path& root, const std::filesystem::path& directory, bool reportExisting);
+    void removeTree(const std::filesystem::path& directory);
+    void readEvents();
+#else
+    std::unordered_map<string, Snapshot> snapshots;
+
+    void rescan();
+#endif
+    void touch(const std::filesystem::path& root, const std::filesystem::path& file, bool closed);
+    void reportReady(const Callback& ready);
+
+public:
+    FolderWatcher(vector<std::filesystem::path> roots, std::chrono::milliseconds debounce);
+    ~FolderWatcher();
+
+    FolderWatcher(const FolderWatcher&) = delete;
+    FolderWatcher& operator=(const FolderWatcher&) = delete;
+
+    // The watched directories, absolute and normalized, in the order they were given
+    const vector<std::filesystem::path>& getRoots() const { return this->roots; }
+
+    // Calls ready from this thread for every completed file, until stop() is called
+    void run(const Callback& ready);
+    // May be called from any thread, including a signal handler
+    void stop();
+};
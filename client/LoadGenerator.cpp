@@ -0,0 +1,277 @@
+#include "LoadGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+#include "Logger.h"
+
+const char* loadOperationName(LoadOperation operation) {
+    switch (operation) {
+    case LoadOperation::REGISTER:
+        return "register";
+    case LoadOperation::LOGIN:
+        return "login";
+    case LoadOperation::UPLOAD:
+        return "upload";
+    }
+    return "unknown";
+}
+
+// Splits "a:1,b:2" into ("a", "1"), ("b", "2")
+static vector<std::pair<string, string>> parsePairs(const string& spec) {
+    vector<std::pair<string, string>> pairs;
+    size_t start = 0;
+    while (start < spec.size()) {
+        size_t end = spec.find(',', start);
+        if (end == string::npos)
+            end = spec.size();
+        string item = spec.substr(start, end - start);
+        size_t colon = item.find(':');
+        if (colon == string::npos)
+            throw std::invalid_argument("Expected name:weight, got " + item);
+        pairs.emplace_back(item.substr(0, colon), item.substr(colon + 1));
+        start = end + 1;
+    }
+    return pairs;
+}
+
+static double parseWeight(const string& text) {
+    double weight = std::stod(text);
+    if (!(weight >= 0))
+        throw std::invalid_argument("Weights can not be negative: " + text);
+    return weight;
+}
+
+std::array<double, LOAD_OPERATION_COUNT> parseMix(const string& spec) {
+    std::array<double, LOAD_OPERATION_COUNT> mix = {};
+    for (const auto& [name, weight] : parsePairs(spec)) {
+        size_t i = 0;
+        while (i < LOAD_OPERATION_COUNT and name != loadOperationName(static_cast<LoadOperation>(i)))
+            i++;
+        if (i == LOAD_OPERATION_COUNT)
+            throw std::invalid_argument("Unknown operation: " + name);
+        mix[i] = parseWeight(weight);
+    }
+    if (mix[0] + mix[1] + mix[2] <= 0)
+        throw std::invalid_argument("The operation mix needs a positive weight");
+    return mix;
+}
+
+vector<SizeBucket> parseSizes(const string& spec) {
+    vector<SizeBucket> sizes;
+    for (const auto& [sizeText, weight] : parsePairs(spec)) {
+        size_t digits = 0;
+        uint64_t size = std::stoull(sizeText, &digits);
+        string suffix = sizeText.substr(digits);
+        if (suffix == "K" or suffix == "k")
+            size <<= 10;
+        else if (suffix == "M" or suffix == "m")
+            size <<= 20;
+        else if (suffix == "G" or suffix == "g")
+            size <<= 30;
+        else if (!suffix.empty())
+            throw std::invalid_argument("Unknown size suffix: " + sizeText);
+        if (size == 0)
+            throw std::invalid_argument("Upload sizes must be positive");
+        sizes.push_back({ size, parseWeight(weight) });
+    }
+    if (sizes.empty())
+        throw std::invalid_argument("No upload sizes given");
+    return sizes;
+}
+
+void LatencySamples::record(std::chrono::steady_clock::duration latency, uint64_t bytes) {
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+    this->samples.push_back(static_cast<uint32_t>(std::min<int64_t>(micros, UINT32_MAX)));
+    this->bytes += bytes;
+}
+
+void LatencySamples::recordError() {
+    this->errors++;
+}
+
+void LatencySamples::merge(const LatencySamples& other) {
+    this->samples.insert(this->samples.end(), other.samples.begin(), other.samples.end());
+    this->errors += other.errors;
+    this->bytes += other.bytes;
+}
+
+void LatencySamples::report(std::ostream& out, const char* name, double seconds) {
+    std::sort(this->samples.begin(), this->samples.end());
+    // Nearest rank: the smallest sample at least fraction of all samples are not above
+    auto percentile = [&](double fraction) -> double {
+        if (this->samples.empty())
+            return 0;
+        size_t rank = static_cast<size_t>(std::ceil(fraction * this->samples.size()));
+        return this->samples[std::max<size_t>(rank, 1) - 1] / 1000.0;
+    };
+    out << std::left << std::setw(10) << name << std::right << std::fixed << std::setprecision(1)
+        << std::setw(9) << this->samples.size() << std::setw(8) << this->errors
+        << std::setw(10) << (seconds > 0 ? this->samples.size() / seconds : 0.0)
+        << std::setprecision(2)
+        << std::setw(10) << percentile(0.5) << std::setw(10) << percentile(0.99) << std::setw(10) << percentile(0.999)
+        << std::setw(10) << (this->samples.empty() ? 0.0 : this->samples.back() / 1000.0);
+    if (this->bytes > 0)
+        out << std::setw(10) << std::setprecision(1) << (seconds > 0 ? this->bytes / (1024.0 * 1024.0) / seconds : 0.0) << " MB/s";
+    out << '\n';
+}
+
+LoadGenerator::LoadGenerator(LoadConfig config)
+    : config(std::move(config)), clientsFailed(0), elapsedSeconds(0)
+{
+    if (this->config.clients == 0)
+        throw std::invalid_argument("The load generator needs at least one virtual client");
+    if (this->config.sizes.empty())
+        throw std::invalid_argument("No upload sizes given");
+}
+
+void LoadGenerator::run() {
+    std::filesystem::create_directories(this->config.workDirectory);
+    this->start = std::chrono::steady_clock::now();
+    this->deadline = this->start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(this->config.rampUpSeconds + this->config.durationSeconds));
+
+    LOG_INFO("Starting " << this->config.clients << " virtual clients over " << this->config.rampUpSeconds << " s, running for "
+             << this->config.durationSeconds << " s more against " << this->config.address << ":" << this->config.port << ".");
+    vector<std::thread> clients;
+    for (size_t i = 0; i < this->config.clients; i++)
+        clients.emplace_back(&LoadGenerator::virtualClient, this, i);
+    for (auto& client : clients)
+        client.join();
+    this->elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->start).count();
+}
+
+void LoadGenerator::reconnect(Client& client) {
+    try {
+        client.closeConnection();
+    }
+    catch (const std::exception&) {
+        // Already closed, or broken by the error that brought us here
+    }
+    client.connect();
+}
+
+void LoadGenerator::registerIdentity(Client& client, size_t index, uint64_t& identities) {
+    client.setName(this->config.namePrefix + "-" + std::to_string(index) + "-" + std::to_string(identities++));
+    reconnect(client);
+    client.registrate();
+    client.sendRSAreceiveAES();
+}
+
+void LoadGenerator::writeUploadFile(const std::filesystem::path& path, uint64_t size, std::mt19937_64& random) {
+    // Fresh random content every time, identical content would be linked instead of uploaded
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw std::runtime_error("Can not write " + path.string());
+    vector<uint64_t> block(64 * 1024 / sizeof(uint64_t));
+    for (uint64_t written = 0; written < size;) {
+        for (auto& word : block)
+            word = random();
+        size_t count = static_cast<size_t>(std::min<uint64_t>(size - written, block.size() * sizeof(uint64_t)));
+        file.write(reinterpret_cast<const char*>(block.data()), count);
+        written += count;
+    }
+    if (!file)
+        throw std::runtime_error("Can not write " + path.string());
+}
+
+void LoadGenerator::virtualClient(size_t index) {
+    using Clock = std::chrono::steady_clock;
+
+    // Step 1: Wait for this client's turn in the ramp-up
+    auto startAt = this->start + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(this->config.rampUpSeconds * index / this->config.clients));
+    std::this_thread::sleep_until(startAt);
+
+    std::mt19937_64 random(this->config.seed * 1000003 + index);
+    std::discrete_distribution<size_t> pickOperation(this->config.mix.begin(), this->config.mix.end());
+    vector<double> sizeWeights;
+    for (const auto& bucket : this->config.sizes)
+        sizeWeights.push_back(bucket.weight);
+    std::discrete_distribution<size_t> pickSize(sizeWeights.begin(), sizeWeights.end());
+
+    boost::asio::io_context io_context;
+    Client client(io_context);
+    client.setServer(this->config.address, this->config.port);
+    std::filesystem::path uploadPath = this->config.workDirectory / ("client-" + std::to_string(index) + ".bin");
+    OperationSamples samples;
+    uint64_t identities = 0;
+    uint64_t uploads = 0;
+    bool registered = false;
+    bool connected = false;
+
+    // Step 2: Register, then run operations by the mix until the deadline. A virtual client
+    // has to be registered for anything else, so the first operation is always a registration.
+    while (Clock::now() < this->deadline) {
+        auto operation = registered ? static_cast<LoadOperation>(pickOperation(random)) : LoadOperation::REGISTER;
+        if (operation != LoadOperation::REGISTER and !connected)
+            operation = LoadOperation::LOGIN;  // Lost its connection to an error, log in again first
+        auto& stats = samples[static_cast<size_t>(operation)];
+        try {
+            // Generating the file is not part of the measured latency
+            uint64_t size = 0;
+            string remoteName;
+            if (operation == LoadOperation::UPLOAD) {
+                size = this->config.sizes[pickSize(random)].size;
+                remoteName = "load-" + std::to_string(index) + "-" + std::to_string(uploads++) + ".bin";
+                writeUploadFile(uploadPath, size, random);
+            }
+
+            auto begin = Clock::now();
+            switch (operation) {
+            case LoadOperation::REGISTER:
+                connected = false;
+                registerIdentity(client, index, identities);
+                registered = true;
+                break;
+            case LoadOperation::LOGIN:
+                connected = false;
+                reconnect(client);
+                client.login();
+                break;
+            case LoadOperation::UPLOAD:
+                client.sendFile(uploadPath, remoteName);
+                break;
+            }
+            connected = true;
+            stats.record(Clock::now() - begin, size);
+        }
+        catch (const std::exception& e) {
+            // The connection is in an unknown state after a failure; the next operation logs in again
+            LOG_WARN("Virtual client " << index << ": " << loadOperationName(operation) << " failed: " << e.what());
+            stats.recordError();
+            connected = false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+    if (connected) {
+        try {
+            client.closeConnection();
+        }
+        catch (const std::exception&) {
+        }
+    }
+    if (!registered)
+        this->clientsFailed++;
+    std::error_code ignored;
+    std::filesystem::remove(uploadPath, ignored);
+
+    std::lock_guard<std::mutex> lock(this->resultsMutex);
+    for (size_t i = 0; i < LOAD_OPERATION_COUNT; i++)
+        this->results[i].merge(samples[i]);
+}
+
+void LoadGenerator::printReport(std::ostream& out) {
+    out << this->config.clients << " virtual clients, " << std::fixed << std::setprecision(1) << this->elapsedSeconds << " s";
+    if (this->clientsFailed > 0)
+        out << ", " << this->clientsFailed << " never registered";
+    out << "\n"
+        << std::left << std::setw(10) << "operation" << std::right << std::setw(9) << "ok" << std::setw(8) << "errors"
+        << std::setw(10) << "ops/s" << std::setw(10) << "p50 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "p999 ms"
+        << std::setw(10) << "max ms" << "\n";
+    for (size_t i = 0; i < LOAD_OPERATION_COUNT; i++)
+        this->results[i].report(out, loadOperationName(static_cast<LoadOperation>(i)), this->elapsedSeconds);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "Client.h"
+
+using std::string, std::vector;
+
+enum class LoadOperation : uint8_t {
+    REGISTER = 0, // New identity: register, then exchange keys, on a fresh connection
+    LOGIN = 1,    // Reconnect and log in again with the current identity
+    UPLOAD = 2    // sendFile of a freshly generated file, so the server can not deduplicate it
+};
+
+constexpr size_t LOAD_OPERATION_COUNT = 3;
+
+const char* loadOperationName(LoadOperation operation);
+
+struct SizeBucket {
+    uint64_t size;
+    double weight;
+};
+
+struct LoadConfig {
+    string address = "127.0.0.1";
+    string port = "12345";
+    size_t clients = 16;
+    double rampUpSeconds = 5;    // Virtual clients start evenly spread over this
+    double durationSeconds = 30; // Run time after the last client started
+    std::array<double, LOAD_OPERATION_COUNT> mix = { 1, 2, 7 }; // Relative weights, by LoadOperation
+    vector<SizeBucket> sizes = { { 4 * 1024, 70 }, { 256 * 1024, 25 }, { 4 * 1024 * 1024, 5 } };
+    std::filesystem::path workDirectory = "loadgen";  // Upload files are generated here, one per virtual client
+    string namePrefix = "load";  // Virtual clients register as <prefix>-<client>-<n>
+    uint64_t seed = 1;
+};
+
+// Parses "register:1,login:2,upload:7"; unnamed operations get weight 0
+std::array<double, LOAD_OPERATION_COUNT> parseMix(const string& spec);
+// Parses "4K:70,256K:25,16M:5", sizes with an optional K, M or G (binary) suffix
+vector<SizeBucket> parseSizes(const string& spec);
+
+// Latencies of one operation in microseconds. Every sample is kept, so the percentiles are exact.
+class LatencySamples {
+private:
+    vector<uint32_t> samples;
+    uint64_t errors = 0;
+    uint64_t bytes = 0;
+
+public:
+    void record(std::chrono::steady_clock::duration latency, uint64_t bytes = 0);
+    void recordError();
+    void merge(const LatencySamples& other);
+    // Sorts the samples, then prints the count, rate over seconds and p50/p99/p999/max
+    void report(std::ostream& out, const char* name, double seconds);
+};
+
+// Simulates many clients against one server. Each virtual client is a thread with its own
+// Client, socket and in-memory identity (nothing is read from or written to me.info or
+// priv.key). It registers once, then repeatedly picks an operation by the configured mix
+// until the run ends. Latencies are kept per virtual client and merged once at the end.
+class LoadGenerator {
+private:
+    using OperationSamples = std::array<LatencySamples, LOAD_OPERATION_COUNT>;
+
+    LoadConfig config;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::time_point deadline;
+    std::mutex resultsMutex;
+    OperationSamples results;
+    std::atomic<size_t> clientsFailed;
+    double elapsedSeconds;
+
+    void virtualClient(size_t index);
+    void registerIdentity(Client& client, size_t index, uint64_t& identities);
+    static void reconnect(Client& client);
+    static void writeUploadFile(const std::filesystem::path& path, uint64_t size, std::mt19937_64& random);
+
+public:
+    explicit LoadGenerator(LoadConfig config);
+
+    // Returns once every virtual client stopped
+    void run();
+    void printReport(std::ostream& out);
+};
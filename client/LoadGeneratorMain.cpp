@@ -0,0 +1,71 @@
+#include <chrono>
+#include <iostream>
+#include "LoadGenerator.h"
+#include "Logger.h"
+
+int main(int argc, char* argv[]) {
+    // --server=<ip>:<port>             server to load, 127.0.0.1:12345 by default
+    // --clients=<n>                    virtual clients, each a thread with its own connection and identity
+    // --ramp-up=<s>, --duration=<s>    clients start evenly over the ramp-up, then all run for the duration
+    // --mix=register:1,login:2,upload:7  relative weights of the operations
+    // --sizes=4K:70,256K:25,4M:5       upload sizes and their weights
+    // --prefix=<name>                  names of the registered clients, unique per run by default
+    // --seed=<n>, --work-dir=<path>, --log-level=<name> (warn by default)
+    LoadConfig config;
+    config.namePrefix = "load" + std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    Logger::global().setLevel(LogLevel::WARN);
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        try {
+            if (arg.rfind("--server=", 0) == 0) {
+                string server = arg.substr(9);
+                size_t colon = server.rfind(':');
+                if (colon == string::npos)
+                    throw std::invalid_argument(arg);
+                config.address = server.substr(0, colon);
+                config.port = server.substr(colon + 1);
+            }
+            else if (arg.rfind("--clients=", 0) == 0)
+                config.clients = std::stoul(arg.substr(10));
+            else if (arg.rfind("--ramp-up=", 0) == 0)
+                config.rampUpSeconds = std::stod(arg.substr(10));
+            else if (arg.rfind("--duration=", 0) == 0)
+                config.durationSeconds = std::stod(arg.substr(11));
+            else if (arg.rfind("--mix=", 0) == 0)
+                config.mix = parseMix(arg.substr(6));
+            else if (arg.rfind("--sizes=", 0) == 0)
+                config.sizes = parseSizes(arg.substr(8));
+            else if (arg.rfind("--prefix=", 0) == 0)
+                config.namePrefix = arg.substr(9);
+            else if (arg.rfind("--seed=", 0) == 0)
+                config.seed = std::stoull(arg.substr(7));
+            else if (arg.rfind("--work-dir=", 0) == 0)
+                config.workDirectory = arg.substr(11);
+            else if (arg.rfind("--log-level=", 0) == 0) {
+                LogLevel level;
+                if (!parseLogLevel(arg.substr(12), level))
+                    throw std::invalid_argument(arg);
+                Logger::global().setLevel(level);
+            }
+            else
+                LOG_WARN("Ignoring unknown argument: " << arg);
+        }
+        catch (const std::exception& e) {
+            LOG_ERROR("Invalid value in argument " << arg << ": " << e.what());
+            return 1;
+        }
+    }
+
+    try {
+        LoadGenerator generator(config);
+        generator.run();
+        generator.printReport(std::cout);
+    }
+    catch (const std::exception& e) {
+        LOG_ERROR("Load generator failed: " << e.what());
+        return 1;
+    }
+    return 0;
+}
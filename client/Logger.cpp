@@ -0,0 +1,140 @@
+#include "Logger.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iostream>
+
+static size_t roundUpToPowerOfTwo(size_t n) {
+    size_t capacity = 1;
+    while (capacity < n)
+        capacity <<= 1;
+    return capacity;
+}
+
+const char* logLevelName(LogLevel level) {
+    switch (level) {
+    case LogLevel::TRACE:
+        return "trace";
+    case LogLevel::DEBUG:
+        return "debug";
+    case LogLevel::INFO:
+        return "info";
+    case LogLevel::WARN:
+        return "warn";
+    case LogLevel::ERR:
+        return "error";
+    }
+    return "unknown";
+}
+
+bool parseLogLevel(const string& name, LogLevel& level) {
+    string lower = name;
+    std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    for (LogLevel candidate : { LogLevel::TRACE, LogLevel::DEBUG, LogLevel::INFO, LogLevel::WARN, LogLevel::ERR }) {
+        if (lower == logLevelName(candidate)) {
+            level = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+Logger::Logger(size_t capacity)
+    : cells(roundUpToPowerOfTwo(capacity)), mask(roundUpToPowerOfTwo(capacity) - 1), enqueuePosition(0), dequeuePosition(0),
+      dropped(0), level(static_cast<uint8_t>(LogLevel::INFO)), stopping(false)
+{
+    // Every cell carries the position it may be written at next; see tryPush
+    for (size_t i = 0; i < this->cells.size(); i++)
+        this->cells[i].sequence.store(i, std::memory_order_relaxed);
+    this->writer = std::thread(&Logger::run, this);
+}
+
+Logger::~Logger() {
+    this->stopping.store(true, std::memory_order_release);
+    if (this->writer.joinable())
+        this->writer.join();
+}
+
+Logger& Logger::global() {
+    static Logger logger;
+    return logger;
+}
+
+void Logger::setLevel(LogLevel minimum) {
+    this->level.store(static_cast<uint8_t>(minimum), std::memory_order_relaxed);
+}
+
+bool Logger::tryPush(Record& record) {
+    // Bounded multi-producer queue: a producer claims a position by advancing enqueuePosition,
+    // and a cell is free for position p once its sequence is p. Publishing sets it to p + 1.
+    size_t position = this->enqueuePosition.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &this->cells[position & this->mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (difference == 0) {
+            if (this->enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (difference < 0) {
+            return false; // Full, the writer has not freed this cell yet
+        }
+        else {
+            position = this->enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+    cell->record = std::move(record);
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+bool Logger::tryPop(Record& record) {
+    Cell& cell = this->cells[this->dequeuePosition & this->mask];
+    if (cell.sequence.load(std::memory_order_acquire) != this->dequeuePosition + 1)
+        return false;
+    record = std::move(cell.record);
+    // Free for the producer one lap later
+    cell.sequence.store(this->dequeuePosition + this->mask + 1, std::memory_order_release);
+    this->dequeuePosition++;
+    return true;
+}
+
+void Logger::write(LogLevel messageLevel, string text) {
+    Record record{ messageLevel, std::move(text) };
+    if (!tryPush(record))
+        this->dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t Logger::drain() {
+    size_t written = 0;
+    bool wroteErrors = false;
+    Record record;
+    while (tryPop(record)) {
+        uint64_t lost = this->dropped.exchange(0, std::memory_order_relaxed);
+        if (lost > 0)
+            std::cerr << "(" << lost << " log messages dropped, the log buffer was full)\n";
+        std::ostream& out = record.level >= LogLevel::WARN ? std::cerr : std::cout;
+        out << record.text << '\n';
+        wroteErrors = wroteErrors or record.level >= LogLevel::WARN;
+        written++;
+    }
+    if (written > 0) {
+        std::cout.flush();
+        if (wroteErrors)
+            std::cerr.flush();
+    }
+    return written;
+}
+
+void Logger::run() {
+    while (true) {
+        // Checked before draining, so messages written before the destructor ran still go out
+        bool stop = this->stopping.load(std::memory_order_acquire);
+        if (drain() == 0) {
+            if (stop)
+                return;
+            std::this_thread::sleep_for(std::chrono::milliseconds(LOG_DRAIN_INTERVAL_MS));
+        }
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::string;
+
+// Levels below LOG_COMPILED_LEVEL are removed by the preprocessor, their arguments are never
+// evaluated. Release builds drop TRACE, the per-packet and per-chunk messages.
+#ifndef LOG_COMPILED_LEVEL
+#ifdef NDEBUG
+#define LOG_COMPILED_LEVEL 1
+#else
+#define LOG_COMPILED_LEVEL 0
+#endif
+#endif
+
+enum class LogLevel : uint8_t {
+    TRACE = 0, // Every packet or chunk
+    DEBUG = 1, // Protocol steps: headers and payloads read, codes received
+    INFO = 2,  // Progress the user follows
+    WARN = 3,  // Retries and recoverable failures
+    ERR = 4,   // Failed operations; ERROR is a macro in <windows.h>
+};
+
+constexpr size_t LOG_RING_CAPACITY = 8192;  // Messages buffered before new ones are dropped
+constexpr int LOG_DRAIN_INTERVAL_MS = 5;    // Sleep of the writer thread while nothing is buffered
+
+const char* logLevelName(LogLevel level);
+// Accepts the names of logLevelName in any case; returns false for anything else
+bool parseLogLevel(const string& name, LogLevel& level);
+
+// Process wide logger. Messages are formatted by the thread logging them and queued in a
+// bounded lock-free ring that any number of threads push to; one background thread writes
+// them to stdout (stderr from WARN up) and flushes once the ring is empty. A logging thread
+// never waits for the console: if the ring is full the message is dropped and counted, and
+// the count is reported with the next message written.
+class Logger {
+private:
+    struct Record {
+        LogLevel level;
+        string text;
+    };
+    struct Cell {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    std::vector<Cell> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> enqueuePosition;
+    alignas(64) size_t dequeuePosition; // Writer thread only
+    alignas(64) std::atomic<uint64_t> dropped;
+    std::atomic<uint8_t> level;
+    std::atomic<bool> stopping;
+    std::thread writer;
+
+    bool tryPush(Record& record);
+    bool tryPop(Record& record);
+    size_t drain();
+    void run();
+
+public:
+    explicit Logger(size_t capacity = LOG_RING_CAPACITY);
+    // Writes out everything still buffered
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    // The logger of the LOG_ macros
+    static Logger& global();
+
+    void setLevel(LogLevel minimum);
+    bool enabled(LogLevel messageLevel) const {
+        return static_cast<uint8_t>(messageLevel) >= this->level.load(std::memory_order_relaxed);
+    }
+    void write(LogLevel messageLevel, string text);
+};
+
+#define LOG_AT(messageLevel, expression) \
+    do { \
+        if (Logger::global().enabled(messageLevel)) { \
+            std::ostringstream logStream; \
+            logStream << expression; \
+            Logger::global().write(messageLevel, logStream.str()); \
+        } \
+    } while (0)
+
+#if LOG_COMPILED_LEVEL <= 0
+#define LOG_TRACE(expression) LOG_AT(LogLevel::TRACE, expression)
+#else
+#define LOG_TRACE(expression) do {} while (0)
+#endif
+#if LOG_COMPILED_LEVEL <= 1
+#define LOG_DEBUG(expression) LOG_AT(LogLevel::DEBUG, expression)
+#else
+#define LOG_DEBUG(expression) do {} while (0)
+#endif
+#define LOG_INFO(expression) LOG_AT(LogLevel::INFO, expression)
+#define LOG_WARN(expression) LOG_AT(LogLevel::WARN, expression)
+#define LOG_ERROR(expression) LOG_AT(LogLevel::ERR, expression)
@@ -1,17 +1,96 @@
-#include <iostream>
 #include <boost/asio.hpp>
+#include <csignal>
+#include <cstdlib>
 #include <filesystem>
 #include <memory>
 #include "Client.h" // Include your Client class header file
+#include "DirectoryUploader.h"
+#include "FileDownloader.h"
+#include "UploadIndex.h"
+#include "RateLimiter.h"
+#include "Logger.h"
+#include "Tracer.h"
+#include "WatchAgent.h"
+
+// Set while --watch runs, so SIGINT and SIGTERM can stop it cleanly
+static WatchAgent* runningAgent = nullptr;
+
+static void stopAgent(int) {
+    if (runningAgent != nullptr)
+        runningAgent->stop();
+}
+
+int main(int argc, char* argv[]) {
+    // --incremental skips files the server already confirmed and that did not change since
+    // --rate=<bytes/s> and --burst=<bytes> cap the upload rate, --interactive lets this upload preempt bulk ones
+    // --download=<stored name> restores a file instead of uploading, into --output=<path> or the current directory
+    // --log-level=<trace|debug|info|warn|error> sets the least severe message printed, info by default
+    // --trace=<file> records a timeline of the transfer threads into file, as Chrome trace-event JSON
+    // --watch=<folder> (repeatable) stays running and uploads files as they are completed in the folders,
+    // --in-flight=<n> uploads at once and --debounce=<ms> of quiet after a file is closed
+    bool incremental = false;
+    bool interactive = false;
+    uint64_t rate = 0;
+    uint64_t burst = 0;
+    string download;
+    std::filesystem::path output;
+    std::filesystem::path trace;
+    vector<std::filesystem::path> watch;
+    size_t inFlight = WATCH_DEFAULT_IN_FLIGHT;
+    std::chrono::milliseconds debounce = WATCH_DEFAULT_DEBOUNCE;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        try {
+            if (arg == "--incremental")
+                incremental = true;
+            else if (arg == "--interactive")
+                interactive = true;
+            else if (arg.rfind("--rate=", 0) == 0)
+                rate = std::stoull(arg.substr(7));
+            else if (arg.rfind("--burst=", 0) == 0)
+                burst = std::stoull(arg.substr(8));
+            else if (arg.rfind("--download=", 0) == 0)
+                download = arg.substr(11);
+            else if (arg.rfind("--output=", 0) == 0)
+                output = arg.substr(9);
+            else if (arg.rfind("--trace=", 0) == 0)
+                trace = arg.substr(8);
+            else if (arg.rfind("--watch=", 0) == 0)
+                watch.push_back(arg.substr(8));
+            else if (arg.rfind("--in-flight=", 0) == 0)
+                inFlight = std::stoull(arg.substr(12));
+            else if (arg.rfind("--debounce=", 0) == 0)
+                debounce = std::chrono::milliseconds(std::stoull(arg.substr(11)));
+            else if (arg.rfind("--log-level=", 0) == 0) {
+                LogLevel level;
+                if (!parseLogLevel(arg.substr(12), level))
+                    throw std::invalid_argument(arg);
+                Logger::global().setLevel(level);
+            }
+            else
+                LOG_WARN("Ignoring unknown argument: " << arg);
+        }
+        catch (const std::exception&) {
+            LOG_ERROR("Invalid value in argument: " << arg);
+            return 1;
+        }
+    }
+    RateLimiter::global().setLimit(rate, burst);
+    if (!trace.empty()) {
+        Tracer::global().start(trace);
+        Tracer::global().setThreadName("main");
+        // Every way out of main, including the exit() calls on errors, writes the trace
+        std::atexit([] { Tracer::global().stop(); });
+    }
 
-int main() {
     // Initialize Boost ASIO context
     try {
         boost::asio::io_context io_context;
 
         // Create a unique pointer to a Client instance
         auto client = std::make_unique<Client>(io_context);
-        client->loadTransferInfo();
+        client->setPriority(interactive ? TransferPriority::INTERACTIVE : TransferPriority::BULK);
+        client->loadTransferInfo(download.empty() and watch.empty());
         client->connect();
 
         if (!std::filesystem::exists(std::filesystem::current_path() / "me.info")) {
@@ -19,48 +98,97 @@ int main() {
                 client->registrate();
             }
             catch (const std::exception& e) {
-                std::cerr << "Error in registration: " << e.what() << std::endl;
+                LOG_ERROR("Error in registration: " << e.what());
                 exit(0);
             }
             try {
                 client->sendRSAreceiveAES();
+                LOG_INFO("Saving private key in priv.key.");
+                client->savePrivateKey();
             }
             catch (const std::exception& e) {
-                std::cerr << "Error in sending RSA key or receiving AES key: " << e.what() << std::endl;
+                LOG_ERROR("Error in sending RSA key or receiving AES key: " << e.what());
                 exit(0);
             }
         }
         else {
-            std::cout << "Attempting to load info from me.info:" << std::endl;
+            LOG_INFO("Attempting to load info from me.info:");
             client->loadMeInfo();
-            std::cout << "Attempting to load key from prev.key:" << std::endl;
+            LOG_INFO("Attempting to load key from prev.key:");
             client->loadPrivateKey();
             try {
                 client->login();
             }
             catch (const std::exception& e) {
-                std::cerr << "Error in login: " << e.what() << std::endl;
+                LOG_ERROR("Error in login: " << e.what());
                 exit(0);
             }
         }
 
+        std::unique_ptr<UploadIndex> index;
+        if (incremental)
+            index = std::make_unique<UploadIndex>(std::filesystem::current_path() / UPLOAD_INDEX_FILE, client->getClientID());
+
         try {
-            client->sendFile();
+            if (!watch.empty()) {
+                WatchAgent agent(*client, watch, inFlight, debounce, index.get());
+                runningAgent = &agent;
+                std::signal(SIGINT, stopAgent);
+                std::signal(SIGTERM, stopAgent);
+                agent.run();
+                runningAgent = nullptr;
+            }
+            else if (!download.empty()) {
+                if (output.empty())
+                    output = std::filesystem::current_path() / std::filesystem::path(download).filename();
+                FileDownloader downloader(*client, download, output, client->getConnectionCount());
+                downloader.run();
+            }
+            else if (client->isDirectoryUpload()) {
+                DirectoryUploader uploader(*client, client->getPath(), client->getConnectionCount(), index.get());
+                try {
+                    uploader.run();
+                }
+                catch (const std::exception&) {
+                    // Keep what did get confirmed so the next run resumes from there
+                    if (index)
+                        index->save();
+                    throw;
+                }
+            }
+            else if (index) {
+                std::filesystem::path filePath = client->getPath();
+                string fileName = filePath.filename().string();
+                LocalFileState state = LocalFileState::of(filePath);
+                if (index->isUnchanged(filePath, fileName, state)) {
+                    LOG_INFO(filePath << " is unchanged since its last confirmed upload, skipping.");
+                }
+                else {
+                    FileHash hash = client->sendFile();
+                    index->recordConfirmed(filePath, fileName, state, hash);
+                }
+            }
+            else {
+                client->sendFile();
+            }
+            if (index)
+                index->save();
+            client->closeConnection();
         }
         catch (const std::exception& e) {
-            std::cerr << "Error in sending file process: " << e.what() << std::endl;
+            LOG_ERROR("Error in sending file process: " << e.what());
             exit(0);
         }
         try {
             client->saveClientInfo();
         }
         catch (const std::exception& e) {
-            std::cerr << "Error in saving client info: " << e.what() << std::endl;
+            LOG_ERROR("Error in saving client info: " << e.what());
             exit(0);
         }
     }
     catch (const std::exception& e) {
-        std::cerr << "Exception raised: " << e.what() << std::endl;
+        LOG_ERROR("Exception raised: " << e.what());
     }
     return 0;
 }
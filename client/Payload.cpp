@@ -6,6 +6,7 @@
 
 constexpr int NAME_SIZE = 255;
 constexpr int KEY_SIZE = 160;
+constexpr int SHA256_SIZE = 32;
 
 using std::uint32_t, std::uint16_t, std::uint8_t, std::vector, std::string;
 
@@ -89,6 +90,165 @@ vector<uint8_t> SendFilePayload::serializePayload() const {
 	return serializedData;
 }
 
+SendPackPayload::SendPackPayload(
+	uint32_t contentSize,
+	uint32_t entryCount,
+	uint16_t packetNumber,
+	uint16_t totalPackets,
+	const string& messageContent)
+	: contentSize(contentSize), entryCount(entryCount), packetNumber(packetNumber), totalPackets(totalPackets), messageContent(messageContent)
+{
+	if (entryCount == 0)
+		throw std::invalid_argument("Error: Empty pack in creation of SendPackPayload");
+}
+
+vector<uint8_t> SendPackPayload::serializePayload() const {
+	vector<uint8_t> serializedData;
+
+	vector<uint8_t> serializedContentSize = serializeInt(this->contentSize);
+	serializedData.insert(serializedData.end(), serializedContentSize.begin(), serializedContentSize.end());
+
+	vector<uint8_t> serializedEntryCount = serializeInt(this->entryCount);
+	serializedData.insert(serializedData.end(), serializedEntryCount.begin(), serializedEntryCount.end());
+
+	vector<uint8_t> serializedPacketNumber = serializeShort(this->packetNumber);
+	serializedData.insert(serializedData.end(), serializedPacketNumber.begin(), serializedPacketNumber.end());
+
+	vector<uint8_t> serializedTotalPackets = serializeShort(this->totalPackets);
+	serializedData.insert(serializedData.end(), serializedTotalPackets.begin(), serializedTotalPackets.end());
+
+	vector<uint8_t> serializedMessageContent = serializeString(this->messageContent);
+	serializedData.insert(serializedData.end(), serializedMessageContent.begin(), serializedMessageContent.end());
+
+	return serializedData;
+}
+
+SendFileChunkPayload::SendFileChunkPayload(
+	uint32_t contentSize,
+	uint64_t originalFileSize,
+	uint64_t encryptedSize,
+	uint64_t offset,
+	uint32_t chunkChecksum,
+	uint8_t flags,
+	const string& fileName,
+	const string& messageContent)
+	: contentSize(contentSize), originalFileSize(originalFileSize), encryptedSize(encryptedSize), offset(offset),
+	  chunkChecksum(chunkChecksum), flags(flags), fileName(fileName), messageContent(messageContent)
+{
+	if (fileName.size() != NAME_SIZE)
+		throw std::invalid_argument("Error: Invalid file name size in creation of SendFileChunkPayload");
+	if (offset + contentSize > encryptedSize)
+		throw std::invalid_argument("Error: Chunk past the end of the file in creation of SendFileChunkPayload");
+}
+
+vector<uint8_t> SendFileChunkPayload::serializePayload() const {
+	vector<uint8_t> serializedData;
+
+	vector<uint8_t> serializedContentSize = serializeInt(this->contentSize);
+	serializedData.insert(serializedData.end(), serializedContentSize.begin(), serializedContentSize.end());
+
+	vector<uint8_t> serializedOriginalFileSize = serializeLong(this->originalFileSize);
+	serializedData.insert(serializedData.end(), serializedOriginalFileSize.begin(), serializedOriginalFileSize.end());
+
+	vector<uint8_t> serializedEncryptedSize = serializeLong(this->encryptedSize);
+	serializedData.insert(serializedData.end(), serializedEncryptedSize.begin(), serializedEncryptedSize.end());
+
+	vector<uint8_t> serializedOffset = serializeLong(this->offset);
+	serializedData.insert(serializedData.end(), serializedOffset.begin(), serializedOffset.end());
+
+	vector<uint8_t> serializedChunkChecksum = serializeInt(this->chunkChecksum);
+	serializedData.insert(serializedData.end(), serializedChunkChecksum.begin(), serializedChunkChecksum.end());
+
+	serializedData.push_back(this->flags);
+
+	vector<uint8_t> serializedFileName = serializeString(this->fileName);
+	serializedData.insert(serializedData.end(), serializedFileName.begin(), serializedFileName.end());
+
+	vector<uint8_t> serializedMessageContent = serializeString(this->messageContent);
+	serializedData.insert(serializedData.end(), serializedMessageContent.begin(), serializedMessageContent.end());
+
+	return serializedData;
+}
+
+NegotiateChunksPayload::NegotiateChunksPayload(uint32_t minChunkSize, uint32_t maxChunkSize, const vector<uint8_t>& hashAlgorithms)
+	: minChunkSize(minChunkSize), maxChunkSize(maxChunkSize), hashAlgorithms(hashAlgorithms)
+{
+	if (minChunkSize == 0 or minChunkSize > maxChunkSize)
+		throw std::invalid_argument("Error: Invalid chunk size bounds in creation of NegotiateChunksPayload");
+	if (hashAlgorithms.size() > UINT8_MAX)
+		throw std::invalid_argument("Error: Too many hash algorithms in creation of NegotiateChunksPayload");
+}
+
+vector<uint8_t> NegotiateChunksPayload::serializePayload() const {
+	vector<uint8_t> serializedData = serializeInt(this->minChunkSize);
+
+	vector<uint8_t> serializedMaxChunkSize = serializeInt(this->maxChunkSize);
+	serializedData.insert(serializedData.end(), serializedMaxChunkSize.begin(), serializedMaxChunkSize.end());
+
+	if (!this->hashAlgorithms.empty()) {
+		serializedData.push_back(static_cast<uint8_t>(this->hashAlgorithms.size()));
+		serializedData.insert(serializedData.end(), this->hashAlgorithms.begin(), this->hashAlgorithms.end());
+	}
+
+	return serializedData;
+}
+
+UploadPrecheckPayload::UploadPrecheckPayload(uint64_t fileSize, uint32_t checksum, const string& sha256, const string& fileName)
+	: fileSize(fileSize), checksum(checksum), sha256(sha256), fileName(fileName)
+{
+	if (sha256.size() != SHA256_SIZE)
+		throw std::invalid_argument("Error: Invalid hash size in creation of UploadPrecheckPayload");
+	if (fileName.size() != NAME_SIZE)
+		throw std::invalid_argument("Error: Invalid file name size in creation of UploadPrecheckPayload");
+}
+
+vector<uint8_t> UploadPrecheckPayload::serializePayload() const {
+	vector<uint8_t> serializedData = serializeLong(this->fileSize);
+
+	vector<uint8_t> serializedChecksum = serializeInt(this->checksum);
+	serializedData.insert(serializedData.end(), serializedChecksum.begin(), serializedChecksum.end());
+
+	vector<uint8_t> serializedHash = serializeString(this->sha256);
+	serializedData.insert(serializedData.end(), serializedHash.begin(), serializedHash.end());
+
+	vector<uint8_t> serializedFileName = serializeString(this->fileName);
+	serializedData.insert(serializedData.end(), serializedFileName.begin(), serializedFileName.end());
+
+	return serializedData;
+}
+
+RequestFileInfoPayload::RequestFileInfoPayload(const string& fileName)
+	: fileName(fileName)
+{
+	if (fileName.size() != NAME_SIZE)
+		throw std::invalid_argument("Error: Invalid file name size in creation of RequestFileInfoPayload");
+}
+
+vector<uint8_t> RequestFileInfoPayload::serializePayload() const {
+	return serializeString(this->fileName);
+}
+
+ReadRangePayload::ReadRangePayload(uint64_t offset, uint32_t length, const string& fileName)
+	: offset(offset), length(length), fileName(fileName)
+{
+	if (length == 0)
+		throw std::invalid_argument("Error: Empty range in creation of ReadRangePayload");
+	if (fileName.size() != NAME_SIZE)
+		throw std::invalid_argument("Error: Invalid file name size in creation of ReadRangePayload");
+}
+
+vector<uint8_t> ReadRangePayload::serializePayload() const {
+	vector<uint8_t> serializedData = serializeLong(this->offset);
+
+	vector<uint8_t> serializedLength = serializeInt(this->length);
+	serializedData.insert(serializedData.end(), serializedLength.begin(), serializedLength.end());
+
+	vector<uint8_t> serializedFileName = serializeString(this->fileName);
+	serializedData.insert(serializedData.end(), serializedFileName.begin(), serializedFileName.end());
+
+	return serializedData;
+}
+
 ChecksumCorrectPayload::ChecksumCorrectPayload(const string& name) 
 	: name(name)
 {
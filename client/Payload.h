@@ -4,7 +4,7 @@
 #include <vector>
 #include <string>
 
-using std::uint8_t, std::uint16_t, std::uint32_t, std::string, std::vector;
+using std::uint8_t, std::uint16_t, std::uint32_t, std::uint64_t, std::string, std::vector;
 
 class Payload {
 public:
@@ -59,6 +59,91 @@ public:
 	vector<uint8_t> serializePayload() const override;
 };
 
+class SendPackPayload : public Payload { // code 829 - send a pack of small files
+private:
+	uint32_t contentSize;
+	uint32_t entryCount;
+	uint16_t packetNumber;
+	uint16_t totalPackets;
+	string messageContent;
+
+public:
+	SendPackPayload(
+		uint32_t contentSize,
+		uint32_t entryCount,
+		uint16_t packetNumber,
+		uint16_t totalPackets,
+		const string &messageContent);
+	vector<uint8_t> serializePayload() const override;
+};
+
+class SendFileChunkPayload : public Payload { // code 830 - send file chunk, 831 - resend chunk
+private:
+	uint32_t contentSize;
+	uint64_t originalFileSize;
+	uint64_t encryptedSize;
+	uint64_t offset;
+	uint32_t chunkChecksum;
+	uint8_t flags;
+	string fileName;
+	string messageContent;
+
+public:
+	SendFileChunkPayload(
+		uint32_t contentSize,
+		uint64_t originalFileSize,
+		uint64_t encryptedSize,
+		uint64_t offset,
+		uint32_t chunkChecksum,
+		uint8_t flags,
+		const string &fileName,
+		const string &messageContent);
+	vector<uint8_t> serializePayload() const override;
+};
+
+class NegotiateChunksPayload : public Payload { // code 832 - negotiate chunk size bounds and the file hash
+private:
+	uint32_t minChunkSize;
+	uint32_t maxChunkSize;
+	vector<uint8_t> hashAlgorithms; // Preferred first; left off the wire when empty, as v3 clients send it
+
+public:
+	NegotiateChunksPayload(uint32_t minChunkSize, uint32_t maxChunkSize, const vector<uint8_t> &hashAlgorithms);
+	vector<uint8_t> serializePayload() const override;
+};
+
+class UploadPrecheckPayload : public Payload { // code 835 - offer a file by hash before uploading it
+private:
+	uint64_t fileSize;
+	uint32_t checksum;
+	string sha256;
+	string fileName;
+
+public:
+	UploadPrecheckPayload(uint64_t fileSize, uint32_t checksum, const string &sha256, const string &fileName);
+	vector<uint8_t> serializePayload() const override;
+};
+
+class RequestFileInfoPayload : public Payload { // code 833 - size and checksum of a stored file
+private:
+	string fileName;
+
+public:
+	RequestFileInfoPayload(const string &fileName);
+	vector<uint8_t> serializePayload() const override;
+};
+
+class ReadRangePayload : public Payload { // code 834 - read a byte range of a stored file
+private:
+	uint64_t offset;
+	uint32_t length;
+	string fileName;
+
+public:
+	ReadRangePayload(uint64_t offset, uint32_t length, const string &fileName);
+	vector<uint8_t> serializePayload() const override;
+};
+
 class ChecksumCorrectPayload : public Payload { // code 900 - CRC success
 private:
 	string name;
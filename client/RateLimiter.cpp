@@ -0,0 +1,90 @@
+#include "RateLimiter.h"
+#include <algorithm>
+
+constexpr double MIN_BURST = 64 * 1024;
+
+RateLimiter::RateLimiter(uint64_t bytesPerSecond, uint64_t burstBytes)
+    : rate(0), burst(0), tokens(0), lastRefill(Clock::now()), activeInteractive(0), waitingInteractive(0)
+{
+    setLimit(bytesPerSecond, burstBytes);
+    this->tokens = this->burst;
+}
+
+RateLimiter& RateLimiter::global() {
+    static RateLimiter limiter;
+    return limiter;
+}
+
+void RateLimiter::refill(Clock::time_point now) {
+    double elapsed = std::chrono::duration<double>(now - this->lastRefill).count();
+    this->lastRefill = now;
+    this->tokens = std::min(this->burst, this->tokens + elapsed * this->rate);
+}
+
+void RateLimiter::setLimit(uint64_t bytesPerSecond, uint64_t burstBytes) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    refill(Clock::now());
+
+    this->rate = static_cast<double>(bytesPerSecond);
+    this->burst = burstBytes != 0 ? static_cast<double>(burstBytes) : std::max(MIN_BURST, this->rate / 10);
+    this->tokens = std::min(this->tokens, this->burst);
+    this->changed.notify_all();
+}
+
+uint64_t RateLimiter::getRate() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return static_cast<uint64_t>(this->rate);
+}
+
+void RateLimiter::acquire(size_t bytes, TransferPriority priority) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    bool interactive = priority == TransferPriority::INTERACTIVE;
+    if (interactive)
+        this->waitingInteractive++;
+
+    while (true) {
+        if (!interactive and (this->activeInteractive > 0 or this->waitingInteractive > 0)) {
+            this->changed.wait(lock);
+            continue;
+        }
+        if (this->rate == 0)
+            break;
+
+        refill(Clock::now());
+        double needed = std::min(static_cast<double>(bytes), this->burst);
+        if (this->tokens >= needed) {
+            this->tokens -= static_cast<double>(bytes);
+            break;
+        }
+        // Woken early by setLimit or by an interactive sender finishing
+        this->changed.wait_for(lock, std::chrono::duration<double>((needed - this->tokens) / this->rate));
+    }
+
+    if (interactive and --this->waitingInteractive == 0)
+        this->changed.notify_all();
+}
+
+void RateLimiter::beginTransfer(TransferPriority priority) {
+    if (priority != TransferPriority::INTERACTIVE)
+        return;
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->activeInteractive++;
+}
+
+void RateLimiter::endTransfer(TransferPriority priority) {
+    if (priority != TransferPriority::INTERACTIVE)
+        return;
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (--this->activeInteractive == 0)
+        this->changed.notify_all();
+}
+
+ScopedTransfer::ScopedTransfer(RateLimiter& limiter, TransferPriority priority)
+    : limiter(limiter), priority(priority)
+{
+    this->limiter.beginTransfer(this->priority);
+}
+
+ScopedTransfer::~ScopedTransfer() {
+    this->limiter.endTransfer(this->priority);
+}
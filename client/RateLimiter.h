@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+using std::uint64_t;
+
+enum class TransferPriority : uint8_t {
+    INTERACTIVE = 0, // Latency sensitive, never waits behind bulk transfers
+    BULK = 1         // Backups and directory uploads, paused while interactive transfers run
+};
+
+// Token bucket shared by every connection of the process. Each frame takes as many
+// tokens as it has bytes; tokens refill at rate bytes per second up to burst. A frame
+// larger than burst waits for a full bucket and then leaves it in debt, so any frame
+// size works with any burst. Bulk senders also wait while an interactive transfer is
+// in flight or an interactive sender is waiting for tokens.
+// setLimit may be called from any thread while transfers are running.
+class RateLimiter {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    double rate;  // Bytes per second, 0 means unlimited
+    double burst;
+    double tokens;
+    Clock::time_point lastRefill;
+    size_t activeInteractive;
+    size_t waitingInteractive;
+
+    void refill(Clock::time_point now);
+
+public:
+    RateLimiter(uint64_t bytesPerSecond = 0, uint64_t burstBytes = 0);
+
+    // The limiter every Client uses unless given another one
+    static RateLimiter& global();
+
+    // burstBytes of 0 picks a tenth of a second worth of tokens, at least 64 KB
+    void setLimit(uint64_t bytesPerSecond, uint64_t burstBytes = 0);
+    uint64_t getRate();
+
+    // Blocks until bytes may be sent at the given priority
+    void acquire(size_t bytes, TransferPriority priority);
+
+    void beginTransfer(TransferPriority priority);
+    void endTransfer(TransferPriority priority);
+};
+
+// Marks a transfer as in flight for its lifetime so bulk transfers yield to interactive ones
+class ScopedTransfer {
+private:
+    RateLimiter& limiter;
+    TransferPriority priority;
+
+public:
+    ScopedTransfer(RateLimiter& limiter, TransferPriority priority);
+    ~ScopedTransfer();
+    ScopedTransfer(const ScopedTransfer&) = delete;
+    ScopedTransfer& operator=(const ScopedTransfer&) = delete;
+};
@@ -104,6 +104,113 @@ unique_ptr<Packet> sendFilePacket(
 									std::make_unique<SendFilePayload>(contentSize, originalFileSize, packetNumber, totalPackets, fileName, messageContent));
 }
 
+unique_ptr<Packet> sendPackPacket(
+	const string& clientID,
+	uint32_t contentSize,
+	uint32_t entryCount,
+	uint16_t packetNumber,
+	uint16_t totalPackets,
+	const string& messageContent,
+	uint8_t version,
+	uint16_t code)
+{
+	if (messageContent.size() != contentSize) {
+		throw std::invalid_argument("Error: Content size does not match message content in creation of sendPackPacket");
+	}
+
+	uint32_t payloadSize = contentSize + sizeof(contentSize) + sizeof(entryCount) + sizeof(packetNumber) + sizeof(totalPackets);
+	return std::make_unique<Packet>(std::make_unique<Header>(clientID, code, payloadSize, version),
+									std::make_unique<SendPackPayload>(contentSize, entryCount, packetNumber, totalPackets, messageContent));
+}
+
+unique_ptr<Packet> sendFileChunkPacket(
+	const string& clientID,
+	uint32_t contentSize,
+	uint64_t originalFileSize,
+	uint64_t encryptedSize,
+	uint64_t offset,
+	uint32_t chunkChecksum,
+	uint8_t flags,
+	const string& fileName,
+	const string& messageContent,
+	uint8_t version,
+	uint16_t code)
+{
+	if (messageContent.size() != contentSize) {
+		throw std::invalid_argument("Error: Content size does not match message content in creation of sendFileChunkPacket");
+	}
+
+	uint32_t payloadSize = contentSize + sizeof(contentSize) + sizeof(originalFileSize) + sizeof(encryptedSize) + sizeof(offset)
+		+ sizeof(chunkChecksum) + sizeof(flags) + static_cast<uint32_t>(fileName.size());
+	return std::make_unique<Packet>(std::make_unique<Header>(clientID, code, payloadSize, version),
+		std::make_unique<SendFileChunkPayload>(contentSize, originalFileSize, encryptedSize, offset, chunkChecksum, flags, fileName, messageContent));
+}
+
+unique_ptr<Packet> negotiateChunksPacket(
+	const string& clientID,
+	uint32_t minChunkSize,
+	uint32_t maxChunkSize,
+	const vector<uint8_t>& hashAlgorithms,
+	uint8_t version,
+	uint16_t code)
+{
+	uint32_t payloadSize = sizeof(minChunkSize) + sizeof(maxChunkSize);
+	if (!hashAlgorithms.empty())
+		payloadSize += 1 + static_cast<uint32_t>(hashAlgorithms.size());
+	return std::make_unique<Packet>(std::make_unique<Header>(clientID, code, payloadSize, version),
+		std::make_unique<NegotiateChunksPayload>(minChunkSize, maxChunkSize, hashAlgorithms));
+}
+
+unique_ptr<Packet> uploadPrecheckPacket(
+	const string& clientID,
+	uint64_t fileSize,
+	uint32_t checksum,
+	const string& sha256,
+	const string& fileName,
+	uint8_t version,
+	uint16_t code)
+{
+	if (fileName.size() != NAME_SIZE) {
+		throw std::invalid_argument("Error: Invalid file name size in creation of uploadPrecheckPacket");
+	}
+
+	uint32_t payloadSize = sizeof(fileSize) + sizeof(checksum) + static_cast<uint32_t>(sha256.size() + fileName.size());
+	return std::make_unique<Packet>(std::make_unique<Header>(clientID, code, payloadSize, version),
+		std::make_unique<UploadPrecheckPayload>(fileSize, checksum, sha256, fileName));
+}
+
+unique_ptr<Packet> requestFileInfoPacket(
+	const string& clientID,
+	const string& fileName,
+	uint8_t version,
+	uint16_t code)
+{
+	if (fileName.size() != NAME_SIZE) {
+		throw std::invalid_argument("Error: Invalid file name size in creation of requestFileInfoPacket");
+	}
+
+	uint32_t payloadSize = static_cast<uint32_t>(fileName.size());
+	return std::make_unique<Packet>(std::make_unique<Header>(clientID, code, payloadSize, version),
+		std::make_unique<RequestFileInfoPayload>(fileName));
+}
+
+unique_ptr<Packet> readRangePacket(
+	const string& clientID,
+	uint64_t offset,
+	uint32_t length,
+	const string& fileName,
+	uint8_t version,
+	uint16_t code)
+{
+	if (fileName.size() != NAME_SIZE) {
+		throw std::invalid_argument("Error: Invalid file name size in creation of readRangePacket");
+	}
+
+	uint32_t payloadSize = sizeof(offset) + sizeof(length) + static_cast<uint32_t>(fileName.size());
+	return std::make_unique<Packet>(std::make_unique<Header>(clientID, code, payloadSize, version),
+		std::make_unique<ReadRangePayload>(offset, length, fileName));
+}
+
 unique_ptr<Packet> checksumCorrectPacket(
 	const string& clientID,
 	const string& name,
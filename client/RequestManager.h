@@ -12,13 +12,20 @@ enum CODES {
 	SEND_KEY_CODE = 826,
 	LOGIN_CODE = 827,
 	SEND_FILE_CODE = 828,
+	SEND_PACK_CODE = 829,
+	SEND_FILE_CHUNK_CODE = 830,
+	RESEND_CHUNK_CODE = 831,
+	NEGOTIATE_CHUNKS_CODE = 832,
+	REQUEST_FILE_INFO_CODE = 833,
+	READ_RANGE_CODE = 834,
+	UPLOAD_PRECHECK_CODE = 835,
 
 	CHECKSUM_CORRECT_CODE = 900,
 	CHECKSUM_FAILED_CODE = 901,
 	CHECKSUM_SHUTDOWN_CODE = 902
 };
 
-using std::uint8_t, std::uint16_t, std::uint32_t, std::vector, std::unique_ptr, std::string;
+using std::uint8_t, std::uint16_t, std::uint32_t, std::uint64_t, std::vector, std::unique_ptr, std::string;
 
 class Header {
 private:
@@ -73,6 +80,70 @@ unique_ptr<Packet> sendFilePacket(
 	uint8_t version = CLIENT_VERSION,
 	uint16_t code = SEND_FILE_CODE);
 
+unique_ptr<Packet> sendPackPacket(
+	const string& clientID,
+	uint32_t contentSize,
+	uint32_t entryCount,
+	uint16_t packetNumber,
+	uint16_t totalPackets,
+	const string& messageContent,
+	uint8_t version = CLIENT_VERSION,
+	uint16_t code = SEND_PACK_CODE);
+
+// Flags of a SEND_FILE_CHUNK / RESEND_CHUNK frame
+constexpr uint8_t CHUNK_FLAG_LAST = 0x01;         // Final frame of a pass
+constexpr uint8_t CHUNK_FLAG_ACK_REQUESTED = 0x02; // Server answers CHUNK_ACK as soon as it reads the frame
+
+// One chunk of the encrypted file at a byte offset, with a CRC-32 of the chunk.
+// Pass code = RESEND_CHUNK_CODE to patch a chunk the server reported bad.
+unique_ptr<Packet> sendFileChunkPacket(
+	const string& clientID,
+	uint32_t contentSize,
+	uint64_t originalFileSize,
+	uint64_t encryptedSize,
+	uint64_t offset,
+	uint32_t chunkChecksum,
+	uint8_t flags,
+	const string& fileName,
+	const string& messageContent,
+	uint8_t version = CLIENT_VERSION,
+	uint16_t code = SEND_FILE_CHUNK_CODE);
+
+unique_ptr<Packet> negotiateChunksPacket(
+	const string& clientID,
+	uint32_t minChunkSize,
+	uint32_t maxChunkSize,
+	const vector<uint8_t>& hashAlgorithms,
+	uint8_t version = CLIENT_VERSION,
+	uint16_t code = NEGOTIATE_CHUNKS_CODE);
+
+// Offers a file by size, CRC and SHA-256 before uploading it; the server answers FILE_OK
+// if it already holds that content and linked the name to it, UPLOAD_NEEDED otherwise
+unique_ptr<Packet> uploadPrecheckPacket(
+	const string& clientID,
+	uint64_t fileSize,
+	uint32_t checksum,
+	const string& sha256,
+	const string& fileName,
+	uint8_t version = CLIENT_VERSION,
+	uint16_t code = UPLOAD_PRECHECK_CODE);
+
+unique_ptr<Packet> requestFileInfoPacket(
+	const string& clientID,
+	const string& fileName,
+	uint8_t version = CLIENT_VERSION,
+	uint16_t code = REQUEST_FILE_INFO_CODE);
+
+// Asks for length plaintext bytes of a stored file starting at offset; the server
+// answers with that range encrypted on its own
+unique_ptr<Packet> readRangePacket(
+	const string& clientID,
+	uint64_t offset,
+	uint32_t length,
+	const string& fileName,
+	uint8_t version = CLIENT_VERSION,
+	uint16_t code = READ_RANGE_CODE);
+
 unique_ptr<Packet> checksumCorrectPacket(
 	const string& clientID,  
 	const string& name,
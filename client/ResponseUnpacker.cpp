@@ -133,6 +133,48 @@ uint32_t FileOkPayload::getChecksum() const {
     return checksum;
 }
 
+// FileHashOkPayload class implementation
+FileHashOkPayload::FileHashOkPayload(const string& clientID, uint32_t contentSize, const string& fileName, uint8_t hashAlgorithm, uint64_t hash)
+    : clientID(clientID), contentSize(contentSize), fileName(fileName), hashAlgorithm(hashAlgorithm), hash(hash) {
+    if (clientID.size() != 16) {
+        throw std::invalid_argument("clientID must be 16 bytes");
+    }
+    if (fileName.size() > 255) {
+        throw std::invalid_argument("fileName must not exceed 255 bytes");
+    }
+}
+
+FileHashOkPayload FileHashOkPayload::deserialize(const vector<uint8_t>& data) {
+    if (data.size() != 284) {
+        throw std::runtime_error("Data size is incorrect for FileHashOkPayload deserialization");
+    }
+
+    string clientID(data.begin(), data.begin() + 16);
+    uint32_t contentSize = deserializeInt(data, 16);
+    string fileName(data.begin() + 20, data.begin() + 275);
+    return FileHashOkPayload(clientID, contentSize, fileName, deserializeByte(data, 275), deserializeLong(data, 276));
+}
+
+const string& FileHashOkPayload::getClientID() const {
+    return clientID;
+}
+
+uint32_t FileHashOkPayload::getContentSize() const {
+    return contentSize;
+}
+
+const string& FileHashOkPayload::getFileName() const {
+    return fileName;
+}
+
+uint8_t FileHashOkPayload::getHashAlgorithm() const {
+    return hashAlgorithm;
+}
+
+uint64_t FileHashOkPayload::getHash() const {
+    return hash;
+}
+
 // MessageOkPayload class implementation
 MessageOkPayload::MessageOkPayload(const string& clientID) : clientID(clientID) {
     if (clientID.size() != 16) {
@@ -200,6 +242,228 @@ const string& LoginFailPayload::getClientID() const {
     return clientID;
 }
 
+// PackOkPayload class implementation
+PackOkPayload::PackOkPayload(const string& clientID, uint32_t storedCount, const vector<PackFailure>& failures)
+    : clientID(clientID), storedCount(storedCount), failures(failures) {
+    if (clientID.size() != 16) {
+        throw std::invalid_argument("clientID must be 16 bytes");
+    }
+}
+
+PackOkPayload PackOkPayload::deserialize(const vector<uint8_t>& data) {
+    if (data.size() < 24) {
+        throw std::runtime_error("Data size is too small for PackOkPayload deserialization");
+    }
+
+    string clientID(data.begin(), data.begin() + 16);
+    uint32_t storedCount = deserializeInt(data, 16);
+    uint32_t failureCount = deserializeInt(data, 20);
+
+    // Each failure: name length (2 bytes), name, reason (1 byte)
+    vector<PackFailure> failures;
+    size_t offset = 24;
+    for (uint32_t i = 0; i < failureCount; i++) {
+        uint16_t nameLength = deserializeShort(data, offset);
+        string fileName = deserializeString(data, offset + 2, nameLength);
+        uint8_t reason = deserializeByte(data, offset + 2 + nameLength);
+        failures.push_back({ fileName, static_cast<PackFailureReason>(reason) });
+        offset += 2 + nameLength + 1;
+    }
+
+    return PackOkPayload(clientID, storedCount, failures);
+}
+
+const string& PackOkPayload::getClientID() const {
+    return clientID;
+}
+
+uint32_t PackOkPayload::getStoredCount() const {
+    return storedCount;
+}
+
+const vector<PackFailure>& PackOkPayload::getFailures() const {
+    return failures;
+}
+
+// ChunksBadPayload class implementation
+ChunksBadPayload::ChunksBadPayload(const string& clientID, const vector<ChunkRange>& chunks)
+    : clientID(clientID), chunks(chunks) {
+    if (clientID.size() != 16) {
+        throw std::invalid_argument("clientID must be 16 bytes");
+    }
+}
+
+ChunksBadPayload ChunksBadPayload::deserialize(const vector<uint8_t>& data) {
+    if (data.size() < 20) {
+        throw std::runtime_error("Data size is too small for ChunksBadPayload deserialization");
+    }
+
+    string clientID(data.begin(), data.begin() + 16);
+    uint32_t chunkCount = deserializeInt(data, 16);
+    if (data.size() != 20 + static_cast<size_t>(chunkCount) * 12) {
+        throw std::runtime_error("ChunksBadPayload size does not match its chunk count");
+    }
+
+    vector<ChunkRange> chunks;
+    chunks.reserve(chunkCount);
+    for (uint32_t i = 0; i < chunkCount; i++) {
+        size_t offset = 20 + static_cast<size_t>(i) * 12;
+        chunks.push_back({ deserializeLong(data, offset), deserializeInt(data, offset + 8) });
+    }
+
+    return ChunksBadPayload(clientID, chunks);
+}
+
+const string& ChunksBadPayload::getClientID() const {
+    return clientID;
+}
+
+const vector<ChunkRange>& ChunksBadPayload::getChunks() const {
+    return chunks;
+}
+
+// ChunkBoundsPayload class implementation
+ChunkBoundsPayload::ChunkBoundsPayload(const string& clientID, uint32_t minChunkSize, uint32_t maxChunkSize, uint8_t hashAlgorithm)
+    : clientID(clientID), minChunkSize(minChunkSize), maxChunkSize(maxChunkSize), hashAlgorithm(hashAlgorithm) {
+    if (clientID.size() != 16) {
+        throw std::invalid_argument("clientID must be 16 bytes");
+    }
+}
+
+ChunkBoundsPayload ChunkBoundsPayload::deserialize(const vector<uint8_t>& data) {
+    if (data.size() != 24 and data.size() != 25) {
+        throw std::runtime_error("Data size is incorrect for ChunkBoundsPayload deserialization");
+    }
+
+    string clientID(data.begin(), data.begin() + 16);
+    uint8_t hashAlgorithm = data.size() == 25 ? deserializeByte(data, 24) : 0;
+    return ChunkBoundsPayload(clientID, deserializeInt(data, 16), deserializeInt(data, 20), hashAlgorithm);
+}
+
+const string& ChunkBoundsPayload::getClientID() const {
+    return clientID;
+}
+
+uint32_t ChunkBoundsPayload::getMinChunkSize() const {
+    return minChunkSize;
+}
+
+uint32_t ChunkBoundsPayload::getMaxChunkSize() const {
+    return maxChunkSize;
+}
+
+uint8_t ChunkBoundsPayload::getHashAlgorithm() const {
+    return hashAlgorithm;
+}
+
+// ChunkAckPayload class implementation
+ChunkAckPayload::ChunkAckPayload(const string& clientID, uint64_t offset)
+    : clientID(clientID), offset(offset) {
+    if (clientID.size() != 16) {
+        throw std::invalid_argument("clientID must be 16 bytes");
+    }
+}
+
+ChunkAckPayload ChunkAckPayload::deserialize(const vector<uint8_t>& data) {
+    if (data.size() != 24) {
+        throw std::runtime_error("Data size is incorrect for ChunkAckPayload deserialization");
+    }
+
+    string clientID(data.begin(), data.begin() + 16);
+    return ChunkAckPayload(clientID, deserializeLong(data, 16));
+}
+
+const string& ChunkAckPayload::getClientID() const {
+    return clientID;
+}
+
+uint64_t ChunkAckPayload::getOffset() const {
+    return offset;
+}
+
+// FileInfoPayload class implementation
+FileInfoPayload::FileInfoPayload(const string& clientID, uint64_t fileSize, uint32_t checksum)
+    : clientID(clientID), fileSize(fileSize), checksum(checksum) {
+    if (clientID.size() != 16) {
+        throw std::invalid_argument("clientID must be 16 bytes");
+    }
+}
+
+FileInfoPayload FileInfoPayload::deserialize(const vector<uint8_t>& data) {
+    if (data.size() != 28) {
+        throw std::runtime_error("Data size is incorrect for FileInfoPayload deserialization");
+    }
+
+    string clientID(data.begin(), data.begin() + 16);
+    return FileInfoPayload(clientID, deserializeLong(data, 16), deserializeInt(data, 24));
+}
+
+const string& FileInfoPayload::getClientID() const {
+    return clientID;
+}
+
+uint64_t FileInfoPayload::getFileSize() const {
+    return fileSize;
+}
+
+uint32_t FileInfoPayload::getChecksum() const {
+    return checksum;
+}
+
+// FileRangePayload class implementation
+FileRangePayload::FileRangePayload(const string& clientID, uint64_t offset, uint32_t length, const string& content)
+    : clientID(clientID), offset(offset), length(length), content(content) {
+    if (clientID.size() != 16) {
+        throw std::invalid_argument("clientID must be 16 bytes");
+    }
+}
+
+FileRangePayload FileRangePayload::deserialize(const vector<uint8_t>& data) {
+    if (data.size() < 28) {
+        throw std::runtime_error("Data size is too small for FileRangePayload deserialization");
+    }
+
+    string clientID(data.begin(), data.begin() + 16);
+    string content(data.begin() + 28, data.end());
+    return FileRangePayload(clientID, deserializeLong(data, 16), deserializeInt(data, 24), content);
+}
+
+const string& FileRangePayload::getClientID() const {
+    return clientID;
+}
+
+uint64_t FileRangePayload::getOffset() const {
+    return offset;
+}
+
+uint32_t FileRangePayload::getLength() const {
+    return length;
+}
+
+const string& FileRangePayload::getContent() const {
+    return content;
+}
+
+// UploadNeededPayload class implementation
+UploadNeededPayload::UploadNeededPayload(const string& clientID)
+    : clientID(clientID) {
+    if (clientID.size() != 16) {
+        throw std::invalid_argument("clientID must be 16 bytes");
+    }
+}
+
+UploadNeededPayload UploadNeededPayload::deserialize(const vector<uint8_t>& data) {
+    if (data.size() != 16) {
+        throw std::runtime_error("Data size is incorrect for UploadNeededPayload deserialization");
+    }
+
+    return UploadNeededPayload(string(data.begin(), data.end()));
+}
+
+const string& UploadNeededPayload::getClientID() const {
+    return clientID;
+}
+
 // GeneralErrorPayload class implementation
 GeneralErrorPayload GeneralErrorPayload::deserialize(const vector<uint8_t>& data) {
     // No data to deserialize as this is an empty payload
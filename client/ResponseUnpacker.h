@@ -18,7 +18,15 @@ enum class ResponseCode : uint16_t {
     MESSAGE_OK = 1604,
     LOGIN_OK_SEND_AES = 1605,
     LOGIN_FAIL = 1606,
-    GENERAL_ERROR = 1607
+    GENERAL_ERROR = 1607,
+    PACK_OK = 1608,
+    CHUNKS_BAD = 1609,
+    CHUNK_BOUNDS = 1610,
+    CHUNK_ACK = 1611,
+    FILE_INFO = 1612,
+    FILE_RANGE = 1613,
+    UPLOAD_NEEDED = 1614,
+    FILE_HASH_OK = 1615
 };
 
 // ResponseHeader class
@@ -89,6 +97,25 @@ public:
     uint32_t getChecksum() const;
 };
 
+// Like FileOkPayload, for connections that agreed on a hash other than the CRC
+class FileHashOkPayload {
+private:
+    string clientID;       // 16 bytes
+    uint32_t contentSize;  // 4 bytes
+    string fileName;       // 255 bytes
+    uint8_t hashAlgorithm; // 1 byte
+    uint64_t hash;         // 8 bytes
+
+public:
+    FileHashOkPayload(const string& clientID, uint32_t contentSize, const string& fileName, uint8_t hashAlgorithm, uint64_t hash);
+    static FileHashOkPayload deserialize(const vector<uint8_t>& data);
+    const string& getClientID() const;
+    uint32_t getContentSize() const;
+    const string& getFileName() const;
+    uint8_t getHashAlgorithm() const;
+    uint64_t getHash() const;
+};
+
 class MessageOkPayload {
 private:
     string clientID;
@@ -121,6 +148,118 @@ public:
     const string& getClientID() const;
 };
 
+// Why the server rejected one file of a pack
+enum class PackFailureReason : uint8_t {
+    CHECKSUM_MISMATCH = 1,
+    INVALID_NAME = 2,
+    STORAGE_ERROR = 3
+};
+
+struct PackFailure {
+    string fileName;
+    PackFailureReason reason;
+};
+
+class PackOkPayload {
+private:
+    string clientID;         // 16 bytes
+    uint32_t storedCount;    // 4 bytes
+    vector<PackFailure> failures;
+
+public:
+    PackOkPayload(const string& clientID, uint32_t storedCount, const vector<PackFailure>& failures);
+    static PackOkPayload deserialize(const vector<uint8_t>& data);
+    const string& getClientID() const;
+    uint32_t getStoredCount() const;
+    const vector<PackFailure>& getFailures() const;
+};
+
+// A chunk of the encrypted file, by byte offset
+struct ChunkRange {
+    uint64_t offset;
+    uint32_t length;
+};
+
+class ChunksBadPayload {
+private:
+    string clientID;             // 16 bytes
+    vector<ChunkRange> chunks;   // count (4 bytes), then offset (8 bytes) and length (4 bytes) each
+
+public:
+    ChunksBadPayload(const string& clientID, const vector<ChunkRange>& chunks);
+    static ChunksBadPayload deserialize(const vector<uint8_t>& data);
+    const string& getClientID() const;
+    const vector<ChunkRange>& getChunks() const;
+};
+
+class ChunkBoundsPayload {
+private:
+    string clientID;        // 16 bytes
+    uint32_t minChunkSize;  // 4 bytes
+    uint32_t maxChunkSize;  // 4 bytes
+    uint8_t hashAlgorithm;  // 1 byte, absent from v3 servers, which only verify with the CRC (0)
+
+public:
+    ChunkBoundsPayload(const string& clientID, uint32_t minChunkSize, uint32_t maxChunkSize, uint8_t hashAlgorithm);
+    static ChunkBoundsPayload deserialize(const vector<uint8_t>& data);
+    const string& getClientID() const;
+    uint32_t getMinChunkSize() const;
+    uint32_t getMaxChunkSize() const;
+    uint8_t getHashAlgorithm() const;
+};
+
+class ChunkAckPayload {
+private:
+    string clientID;  // 16 bytes
+    uint64_t offset;  // 8 bytes
+
+public:
+    ChunkAckPayload(const string& clientID, uint64_t offset);
+    static ChunkAckPayload deserialize(const vector<uint8_t>& data);
+    const string& getClientID() const;
+    uint64_t getOffset() const;
+};
+
+class FileInfoPayload {
+private:
+    string clientID;    // 16 bytes
+    uint64_t fileSize;  // 8 bytes
+    uint32_t checksum;  // 4 bytes, cksum CRC of the stored file
+
+public:
+    FileInfoPayload(const string& clientID, uint64_t fileSize, uint32_t checksum);
+    static FileInfoPayload deserialize(const vector<uint8_t>& data);
+    const string& getClientID() const;
+    uint64_t getFileSize() const;
+    uint32_t getChecksum() const;
+};
+
+class FileRangePayload {
+private:
+    string clientID;   // 16 bytes
+    uint64_t offset;   // 8 bytes
+    uint32_t length;   // 4 bytes, plaintext length of the range
+    string content;    // The range, AES encrypted on its own
+
+public:
+    FileRangePayload(const string& clientID, uint64_t offset, uint32_t length, const string& content);
+    static FileRangePayload deserialize(const vector<uint8_t>& data);
+    const string& getClientID() const;
+    uint64_t getOffset() const;
+    uint32_t getLength() const;
+    const string& getContent() const;
+};
+
+class UploadNeededPayload {
+private:
+    string clientID;  // 16 bytes
+
+public:
+    UploadNeededPayload(const string& clientID);
+    static UploadNeededPayload deserialize(const vector<uint8_t>& data);
+    const string& getClientID() const;
+};
+
 class GeneralErrorPayload {
 public:
     static GeneralErrorPayload deserialize(const vector<uint8_t>& data);
@@ -0,0 +1,21 @@
+#include "SHA256Wrapper.h"
+
+SHA256Wrapper::SHA256Wrapper()
+{
+}
+
+SHA256Wrapper::~SHA256Wrapper()
+{
+}
+
+void SHA256Wrapper::update(const char* data, size_t length)
+{
+    _hash.Update(reinterpret_cast<const CryptoPP::byte*>(data), length);
+}
+
+std::string SHA256Wrapper::digest()
+{
+    std::string result(DIGESTSIZE, '\0');
+    _hash.Final(reinterpret_cast<CryptoPP::byte*>(&result[0])); // Final also restarts the hash
+    return result;
+}
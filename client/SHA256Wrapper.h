@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cryptopp/sha.h>
+
+#include <cstddef>
+#include <string>
+
+// Incremental SHA-256, the strong hash the server addresses stored content by
+class SHA256Wrapper {
+public:
+    static const unsigned int DIGESTSIZE = 32;
+
+private:
+    CryptoPP::SHA256 _hash;
+
+    SHA256Wrapper(const SHA256Wrapper& other);
+    SHA256Wrapper& operator=(const SHA256Wrapper& other);
+
+public:
+    SHA256Wrapper();
+    ~SHA256Wrapper();
+
+    void update(const char* data, size_t length);
+    // Returns the 32 byte digest of everything fed so far and starts over
+    std::string digest();
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+constexpr unsigned int SPSC_SPIN_LIMIT = 64;   // Busy retries before a waiting side yields its core
+constexpr unsigned int SPSC_YIELD_LIMIT = 128; // Retries, yields included, before it sleeps until the peer moves
+
+// Bounded lock-free ring for exactly one producer thread and one consumer thread.
+// push/pop block while the ring is full/empty, which is what gives the transfer
+// pipeline its backpressure. close() releases both sides. A side kept waiting by a
+// slow peer (the disk, the network) spins and yields briefly, then sleeps on a
+// condition variable; the peer only takes the mutex to wake it when someone sleeps.
+template <typename T>
+class SPSCRing {
+private:
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head; // Next slot to pop, written by the consumer only
+    alignas(64) std::atomic<size_t> tail; // Next slot to push, written by the producer only
+    alignas(64) std::atomic<bool> closed;
+    std::atomic<unsigned int> sleepers;   // Sides waiting on wakeup
+    std::mutex mutex;
+    std::condition_variable wakeup;
+
+    static size_t roundUpToPowerOfTwo(size_t n) {
+        size_t capacity = 1;
+        while (capacity < n)
+            capacity <<= 1;
+        return capacity;
+    }
+
+    template <typename Ready>
+    void backoff(unsigned int& spins, Ready ready) {
+        // Spin briefly before handing the core back, stages are usually only a few microseconds apart
+        if (++spins < SPSC_SPIN_LIMIT)
+            return;
+        if (spins < SPSC_YIELD_LIMIT) {
+            std::this_thread::yield();
+            return;
+        }
+        // Registered before ready() is checked again, so the peer either sees a sleeper or this side sees its move
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->sleepers.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        this->wakeup.wait(lock, ready);
+        this->sleepers.fetch_sub(1);
+    }
+
+    void wakePeer() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (this->sleepers.load(std::memory_order_relaxed) == 0)
+            return;
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->wakeup.notify_all();
+    }
+
+public:
+    explicit SPSCRing(size_t capacity)
+        : slots(roundUpToPowerOfTwo(capacity)), mask(roundUpToPowerOfTwo(capacity) - 1), head(0), tail(0), closed(false), sleepers(0) {}
+
+    SPSCRing(const SPSCRing&) = delete;
+    SPSCRing& operator=(const SPSCRing&) = delete;
+
+    bool tryPush(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == slots.size())
+            return false;
+        slots[t & mask] = item;
+        tail.store(t + 1, std::memory_order_release);
+        wakePeer();
+        return true;
+    }
+
+    bool tryPop(T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+        item = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        wakePeer();
+        return true;
+    }
+
+    // Blocks while the ring is full. Returns false if the ring was closed first.
+    bool push(const T& item) {
+        unsigned int spins = 0;
+        while (!tryPush(item)) {
+            if (closed.load(std::memory_order_acquire))
+                return false;
+            backoff(spins, [this] {
+                return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire) != slots.size() or isClosed();
+            });
+        }
+        return true;
+    }
+
+    // Blocks while the ring is empty. Returns false once the ring is closed and drained.
+    bool pop(T& item) {
+        unsigned int spins = 0;
+        while (!tryPop(item)) {
+            if (closed.load(std::memory_order_acquire))
+                return tryPop(item);
+            backoff(spins, [this] {
+                return head.load(std::memory_order_relaxed) != tail.load(std::memory_order_acquire) or isClosed();
+            });
+        }
+        return true;
+    }
+
+    void close() {
+        closed.store(true, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->wakeup.notify_all();
+    }
+
+    bool isClosed() const {
+        return closed.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const {
+        return slots.size();
+    }
+};
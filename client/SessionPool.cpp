@@ -0,0 +1,182 @@
+#include "SessionPool.h"
+#include <algorithm>
+#include <stdexcept>
+#include "Logger.h"
+
+SessionPool::Lease::Lease(SessionPool& pool, unique_ptr<Session> session)
+    : pool(&pool), session(std::move(session)), exceptionsAtCheckout(std::uncaught_exceptions()), healthy(true)
+{}
+
+SessionPool::Lease::Lease(Lease&& other) noexcept
+    : pool(other.pool), session(std::move(other.session)), exceptionsAtCheckout(other.exceptionsAtCheckout), healthy(other.healthy)
+{
+    other.pool = nullptr;
+}
+
+SessionPool::Lease::~Lease() {
+    if (this->pool == nullptr or this->session == nullptr)
+        return;
+    bool unwinding = std::uncaught_exceptions() > this->exceptionsAtCheckout;
+    this->pool->giveBack(std::move(this->session), this->healthy and !unwinding);
+}
+
+static void closeQuietly(Client& client) {
+    try {
+        client.closeConnection();
+    }
+    catch (const std::exception&) {
+        // Already closed by the server or by an earlier error
+    }
+}
+
+SessionPool::SessionPool(const Client& identity, size_t size)
+    : identity(identity), size(size), open(0), stopping(false)
+{
+    if (size == 0)
+        throw std::invalid_argument("A session pool needs at least one session");
+    this->idle.push_back(openSession());
+    this->open = 1;
+    this->maintainer = std::thread(&SessionPool::maintain, this);
+}
+
+SessionPool::~SessionPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->changed.notify_all();
+    if (this->maintainer.joinable())
+        this->maintainer.join();
+    for (auto& session : this->idle)
+        closeQuietly(session->client);
+}
+
+unique_ptr<SessionPool::Session> SessionPool::openSession() {
+    auto session = std::make_unique<Session>();
+    session->client.copyIdentity(this->identity);
+    session->client.connect();
+    session->client.login();
+    session->loggedInAt = Clock::now();
+    return session;
+}
+
+bool SessionPool::refresh(Session& session) {
+    // Logging in again on the same connection gets a new AES key; a lost connection is reopened first
+    try {
+        if (!session.client.isConnectionAlive()) {
+            closeQuietly(session.client);
+            session.client.connect();
+        }
+        session.client.login();
+        session.loggedInAt = Clock::now();
+        return true;
+    }
+    catch (const std::exception& e) {
+        LOG_WARN("Pooled session could not log in again: " << e.what());
+        closeQuietly(session.client);
+        return false;
+    }
+}
+
+SessionPool::Lease SessionPool::checkout() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true) {
+        if (this->stopping)
+            throw std::runtime_error("Session pool is shutting down");
+
+        // Step 1: The most recently used idle session, if the server has not closed it meanwhile
+        if (!this->idle.empty()) {
+            auto session = std::move(this->idle.back());
+            this->idle.pop_back();
+            lock.unlock();
+            if (session->client.isConnectionAlive() or refresh(*session))
+                return Lease(*this, std::move(session));
+            lock.lock();
+            this->open--;
+            this->changed.notify_all();
+            continue;
+        }
+
+        // Step 2: None idle, open another one if the pool is not full
+        if (this->open < this->size) {
+            this->open++;
+            lock.unlock();
+            try {
+                return Lease(*this, openSession());
+            }
+            catch (const std::exception&) {
+                lock.lock();
+                this->open--;
+                this->changed.notify_all();
+                throw;
+            }
+        }
+
+        // Step 3: Wait for a lease to come back
+        this->changed.wait(lock);
+    }
+}
+
+void SessionPool::giveBack(unique_ptr<Session> session, bool healthy) {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (healthy and !this->stopping) {
+            this->idle.push_back(std::move(session));
+        }
+        else {
+            this->open--;
+        }
+    }
+    this->changed.notify_all();
+    if (session != nullptr)
+        closeQuietly(session->client);
+}
+
+void SessionPool::maintain() {
+    bool serverDown = false;  // Reported once, not every round until it is back
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (!this->stopping) {
+        // Step 1: New keys for idle sessions whose key got old, one at a time so checkouts still find the others
+        while (!this->stopping) {
+            auto now = Clock::now();
+            auto stale = std::find_if(this->idle.begin(), this->idle.end(),
+                [&](const unique_ptr<Session>& session) { return now - session->loggedInAt >= SESSION_KEY_LIFETIME; });
+            if (stale == this->idle.end())
+                break;
+            auto session = std::move(*stale);
+            this->idle.erase(stale);
+            lock.unlock();
+            bool refreshed = refresh(*session);
+            lock.lock();
+            if (refreshed)
+                this->idle.push_front(std::move(session));
+            else
+                this->open--;
+            this->changed.notify_all();
+        }
+
+        // Step 2: Replace lost sessions so the pool stays warm
+        while (!this->stopping and this->open < this->size) {
+            this->open++;
+            lock.unlock();
+            unique_ptr<Session> session;
+            try {
+                session = openSession();
+            }
+            catch (const std::exception& e) {
+                if (!serverDown)
+                    LOG_WARN("Session pool could not open a session: " << e.what());
+            }
+            lock.lock();
+            serverDown = session == nullptr;
+            if (serverDown) {
+                this->open--;
+                break;  // Try again next round
+            }
+            this->idle.push_front(std::move(session));
+            this->changed.notify_all();
+        }
+
+        this->changed.wait_for(lock, SESSION_MAINTENANCE_INTERVAL, [this] { return this->stopping; });
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <boost/asio.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "Client.h"
+
+using std::unique_ptr;
+
+constexpr auto SESSION_KEY_LIFETIME = std::chrono::minutes(10);         // Idle sessions log in again for a new AES key after this; below the server's idle timeout
+constexpr auto SESSION_MAINTENANCE_INTERVAL = std::chrono::seconds(5);  // How often key ages are checked and lost sessions replaced
+
+// Keeps up to size logged-in connections of one identity open, so back-to-back transfers
+// skip the TCP handshake and the RSA exchange of login(). checkout() hands out an idle
+// session after checking it is still connected; a background thread logs idle sessions in
+// again once their AES key is SESSION_KEY_LIFETIME old, which also keeps them from timing
+// out, and replaces sessions that were lost. Sessions are opened on demand up to size.
+class SessionPool {
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Session {
+        boost::asio::io_context io_context;
+        Client client;
+        Clock::time_point loggedInAt;
+
+        Session() : client(io_context) {}
+    };
+
+    const Client& identity;
+    size_t size;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<unique_ptr<Session>> idle; // Least recently used first
+    size_t open;                          // Idle, checked out, or being refreshed
+    bool stopping;
+    std::thread maintainer;
+
+    unique_ptr<Session> openSession();
+    bool refresh(Session& session);
+    void giveBack(unique_ptr<Session> session, bool healthy);
+    void maintain();
+
+public:
+    // A checked out session; returns to the pool when destroyed. If it is destroyed while
+    // an exception is in flight, or discard() was called, the connection may be in the
+    // middle of a frame and is closed instead.
+    class Lease {
+    private:
+        SessionPool* pool;
+        unique_ptr<Session> session;
+        int exceptionsAtCheckout;
+        bool healthy;
+
+        friend class SessionPool;
+        Lease(SessionPool& pool, unique_ptr<Session> session);
+
+    public:
+        Lease(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        Lease& operator=(Lease&&) = delete;
+        ~Lease();
+
+        Client& client() { return this->session->client; }
+        Client* operator->() { return &this->session->client; }
+        void discard() { this->healthy = false; }
+    };
+
+    // identity must be logged in (or at least hold a registered ID and private key) and
+    // outlive the pool. Opens the first session right away, so a bad identity fails here.
+    SessionPool(const Client& identity, size_t size);
+    // Every lease must have been returned
+    ~SessionPool();
+
+    SessionPool(const SessionPool&) = delete;
+    SessionPool& operator=(const SessionPool&) = delete;
+
+    // Blocks while all size sessions are checked out; throws if no session can be opened
+    Lease checkout();
+};
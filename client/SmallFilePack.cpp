@@ -0,0 +1,54 @@
+#include "SmallFilePack.h"
+#include <algorithm>
+#include <fstream>
+#include "Checksum.h"
+#include "utils.h"
+
+string serializePack(vector<PackEntry>& entries, vector<string>& skipped, uint32_t& entryCount) {
+    string pack;
+    entryCount = 0;
+
+    for (auto& entry : entries) {
+        std::ifstream file(entry.path, std::ios::binary);
+        if (!file.is_open()) {
+            skipped.push_back(entry.remoteName);
+            continue;
+        }
+        string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        uint32_t checksum = static_cast<uint32_t>(memcrc(content.data(), content.size()));
+        entry.checksum = checksum;
+
+        vector<uint8_t> nameLength = serializeShort(static_cast<uint16_t>(entry.remoteName.size()));
+        vector<uint8_t> fileSize = serializeInt(static_cast<uint32_t>(content.size()));
+        vector<uint8_t> serializedChecksum = serializeInt(checksum);
+
+        pack.append(nameLength.begin(), nameLength.end());
+        pack.append(entry.remoteName);
+        pack.append(fileSize.begin(), fileSize.end());
+        pack.append(serializedChecksum.begin(), serializedChecksum.end());
+        pack.append(content);
+        entryCount++;
+    }
+    return pack;
+}
+
+vector<vector<PackEntry>> groupIntoPacks(vector<PackEntry> entries) {
+    // Neighbouring paths usually land in the same server directory, keep them together
+    std::sort(entries.begin(), entries.end(), [](const PackEntry& a, const PackEntry& b) { return a.remoteName < b.remoteName; });
+
+    vector<vector<PackEntry>> packs;
+    vector<PackEntry> current;
+    size_t currentBytes = 0;
+    for (auto& entry : entries) {
+        if (!current.empty() and (currentBytes + entry.size > PACK_MAX_BYTES or current.size() == PACK_MAX_ENTRIES)) {
+            packs.push_back(std::move(current));
+            current.clear();
+            currentBytes = 0;
+        }
+        currentBytes += entry.size;
+        current.push_back(std::move(entry));
+    }
+    if (!current.empty())
+        packs.push_back(std::move(current));
+    return packs;
+}
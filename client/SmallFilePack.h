@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "UploadIndex.h"
+
+using std::uint64_t, std::string, std::vector;
+
+constexpr uint64_t PACK_FILE_THRESHOLD = 64 * 1024;   // Files smaller than this are sent in packs
+constexpr size_t PACK_MAX_BYTES = 1024 * 1024;        // Plaintext file data per pack
+constexpr size_t PACK_MAX_ENTRIES = 1024;
+
+struct PackEntry {
+    std::filesystem::path path;
+    string remoteName;
+    uint64_t size;
+    LocalFileState state;
+    uint32_t checksum = 0; // Set by serializePack
+};
+
+// Builds the plaintext of a SEND_PACK upload. Each entry is laid out as
+//   name length (2 bytes) | name | file size (4 bytes) | CRC (4 bytes) | file data
+// with little-endian integers and the same CRC as memcrc. Files that can no longer
+// be read are left out and their remote names appended to skipped.
+string serializePack(vector<PackEntry>& entries, vector<string>& skipped, uint32_t& entryCount);
+
+// Groups small files into packs of at most PACK_MAX_BYTES and PACK_MAX_ENTRIES
+vector<vector<PackEntry>> groupIntoPacks(vector<PackEntry> entries);
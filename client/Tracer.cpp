@@ -0,0 +1,165 @@
+#include "Tracer.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include "Logger.h"
+
+#ifdef _WIN32
+#include <process.h>
+#define getProcessId _getpid
+#else
+#include <unistd.h>
+#define getProcessId getpid
+#endif
+
+thread_local Tracer::ThreadSlot Tracer::slot;
+
+static int64_t nanosecondsOf(Tracer::Clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
+
+static string jsonEscape(const string& text) {
+    string escaped;
+    for (char c : text) {
+        if (c == '"' or c == '\\')
+            escaped += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20)
+            escaped += c;
+    }
+    return escaped;
+}
+
+Tracer::ThreadSlot::~ThreadSlot() {
+    if (this->buffer != nullptr)
+        Tracer::global().retire(this->buffer);
+}
+
+Tracer::Tracer()
+    : enabled(false), startedMicros(0), retiredDropped(0), nextTid(1)
+{
+    // stop() logs, possibly from an atexit handler; a logger constructed first is destroyed last
+    Logger::global();
+}
+
+Tracer& Tracer::global() {
+    static Tracer tracer;
+    return tracer;
+}
+
+Tracer::ThreadBuffer& Tracer::threadBuffer() {
+    if (slot.buffer == nullptr) {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto buffer = std::make_unique<ThreadBuffer>();
+        buffer->tid = this->nextTid++;
+        buffer->name = "thread " + std::to_string(buffer->tid);
+        slot.buffer = buffer.get();
+        this->buffers.push_back(std::move(buffer));
+    }
+    return *slot.buffer;
+}
+
+void Tracer::retire(ThreadBuffer* buffer) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->enabled.load()) {
+        // Its spans are still to be written; they move to the shared list as far as it has room
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        size_t kept = std::min(buffer->events.size(), TRACE_RETIRED_EVENT_LIMIT - this->retiredEvents.size());
+        if (kept != 0) {
+            this->retiredThreads.push_back({ buffer->tid, buffer->name, this->retiredEvents.size() });
+            this->retiredEvents.insert(this->retiredEvents.end(), buffer->events.begin(), buffer->events.begin() + kept);
+        }
+        this->retiredDropped += buffer->dropped + (buffer->events.size() - kept);
+    }
+    this->buffers.erase(std::find_if(this->buffers.begin(), this->buffers.end(),
+        [&](const unique_ptr<ThreadBuffer>& owned) { return owned.get() == buffer; }));
+}
+
+void Tracer::start(const std::filesystem::path& path) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->enabled.load())
+        throw std::runtime_error("A trace is already being recorded");
+    this->path = path;
+    this->started = Clock::now();
+    this->startedMicros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    this->enabled.store(true);
+}
+
+void Tracer::record(const char* name, Clock::time_point begin, Clock::time_point end, uint64_t bytes) {
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    if (buffer.events.size() < TRACE_THREAD_EVENT_LIMIT)
+        buffer.events.push_back({ name, nanosecondsOf(begin), nanosecondsOf(end), bytes });
+    else
+        buffer.dropped++;
+}
+
+void Tracer::setThreadName(const string& name) {
+    if (!isEnabled())
+        return;
+    ThreadBuffer& buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.name = name + " (" + std::to_string(buffer.tid) + ")";  // Pipelines start new threads per file, the number tells them apart
+}
+
+void Tracer::stop() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (!this->enabled.exchange(false))
+        return;
+
+    // Step 1: Metadata naming the process and every thread, then one complete ("X") event per span
+    std::ofstream out(this->path, std::ios::trunc);
+    if (!out.is_open()) {
+        LOG_ERROR("Failed to open " << this->path << " for the trace");
+        return;
+    }
+    int pid = static_cast<int>(getProcessId());
+    int64_t startedNanoseconds = nanosecondsOf(this->started);
+    auto micros = [&](int64_t nanoseconds) { return this->startedMicros + (nanoseconds - startedNanoseconds) / 1000.0; };
+    out << std::fixed << std::setprecision(3);
+    out << "{\"traceEvents\":[\n";
+    out << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" << pid << ",\"tid\":0,\"args\":{\"name\":\"client\"}}";
+
+    uint64_t written = 0;
+    auto writeThread = [&](uint32_t tid, const string& name, const TraceEvent* begin, const TraceEvent* end) {
+        if (begin != end) {
+            out << ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid << ",\"tid\":" << tid
+                << ",\"args\":{\"name\":\"" << jsonEscape(name) << "\"}}";
+        }
+        for (const TraceEvent* event = begin; event != end; event++) {
+            if (event->begin < startedNanoseconds)
+                continue;  // Begun before this trace, recorded after the previous one was written
+            out << ",\n{\"ph\":\"X\",\"name\":\"" << event->name << "\",\"pid\":" << pid << ",\"tid\":" << tid
+                << ",\"ts\":" << micros(event->begin) << ",\"dur\":" << (event->end - event->begin) / 1000.0;
+            if (event->bytes != 0)
+                out << ",\"args\":{\"bytes\":" << event->bytes << "}";
+            out << "}";
+        }
+        written += end - begin;
+    };
+
+    uint64_t dropped = this->retiredDropped;
+    for (const auto& buffer : this->buffers) {
+        std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+        writeThread(buffer->tid, buffer->name, buffer->events.data(), buffer->events.data() + buffer->events.size());
+        dropped += buffer->dropped;
+        buffer->events = vector<TraceEvent>();
+        buffer->dropped = 0;
+    }
+    for (size_t i = 0; i < this->retiredThreads.size(); i++) {
+        const RetiredThread& thread = this->retiredThreads[i];
+        size_t end = i + 1 < this->retiredThreads.size() ? this->retiredThreads[i + 1].firstEvent : this->retiredEvents.size();
+        writeThread(thread.tid, thread.name, this->retiredEvents.data() + thread.firstEvent, this->retiredEvents.data() + end);
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    // Step 2: Spans of threads that ended are not needed for the next trace
+    this->retiredThreads = vector<RetiredThread>();
+    this->retiredEvents = vector<TraceEvent>();
+    this->retiredDropped = 0;
+
+    LOG_INFO("Trace of " << written << " spans written to " << this->path << ".");
+    if (dropped != 0)
+        LOG_WARN(dropped << " spans were dropped, over " << TRACE_THREAD_EVENT_LIMIT << " on one thread or "
+                 << TRACE_RETIRED_EVENT_LIMIT << " on threads that ended.");
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using std::string, std::vector, std::unique_ptr;
+
+constexpr size_t TRACE_THREAD_EVENT_LIMIT = 1 << 20;  // Spans kept per thread and trace, later ones are counted and dropped
+constexpr size_t TRACE_RETIRED_EVENT_LIMIT = 1 << 22; // Spans kept from all threads that ended during a trace, together
+
+struct TraceEvent {
+    const char* name;  // A string literal, never copied
+    int64_t begin;     // Nanoseconds since the trace started
+    int64_t end;
+    uint64_t bytes;    // 0 when the span has no size
+};
+
+// Opt-in timeline of where the client's threads spend their time, written as Chrome
+// trace-event JSON (chrome://tracing, ui.perfetto.dev). Spans are recorded into a buffer
+// owned by the recording thread, so threads never wait on each other. A thread that ends
+// during the trace moves its spans to one list shared by all ended threads and capped at
+// TRACE_RETIRED_EVENT_LIMIT, so a long trace of a client that starts threads per file stays
+// bounded; stop() collects every buffer and that list and writes the file. Timestamps
+// are wall clock microseconds, the server's trace uses the same base, so both can be loaded
+// together. While no trace is running a span costs one relaxed atomic load.
+class Tracer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    struct ThreadBuffer {
+        std::mutex mutex;  // Only contended while stop() collects the buffer
+        uint32_t tid;
+        string name;
+        vector<TraceEvent> events;
+        uint64_t dropped = 0;
+    };
+    struct RetiredThread {
+        uint32_t tid;
+        string name;
+        size_t firstEvent;  // Its spans are retiredEvents from here to the next thread's first
+    };
+    struct ThreadSlot {
+        ThreadBuffer* buffer = nullptr;
+        ~ThreadSlot();
+    };
+
+    std::atomic<bool> enabled;
+    std::mutex mutex;
+    std::filesystem::path path;
+    Clock::time_point started;
+    int64_t startedMicros;  // Wall clock at started, microseconds since the epoch
+    vector<unique_ptr<ThreadBuffer>> buffers;
+    vector<RetiredThread> retiredThreads;
+    vector<TraceEvent> retiredEvents;
+    uint64_t retiredDropped;
+    uint32_t nextTid;
+
+    static thread_local ThreadSlot slot;
+
+    ThreadBuffer& threadBuffer();
+    void retire(ThreadBuffer* buffer);
+
+public:
+    Tracer();
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    // The tracer of TraceSpan
+    static Tracer& global();
+
+    bool isEnabled() const { return this->enabled.load(std::memory_order_relaxed); }
+    // Starts recording; the trace goes to path when stop() is called
+    void start(const std::filesystem::path& path);
+    // Stops recording and writes the trace; does nothing if no trace is running
+    void stop();
+
+    void record(const char* name, Clock::time_point begin, Clock::time_point end, uint64_t bytes);
+    // Names the calling thread in the trace, e.g. "pipeline read"
+    void setThreadName(const string& name);
+};
+
+// Records the time from its construction to its destruction as one span of the calling thread
+class TraceSpan {
+private:
+    const char* name;
+    uint64_t bytes;
+    Tracer::Clock::time_point begin;
+    bool active;
+
+public:
+    explicit TraceSpan(const char* name, uint64_t bytes = 0)
+        : name(name), bytes(bytes), active(Tracer::global().isEnabled())
+    {
+        if (this->active)
+            this->begin = Tracer::Clock::now();
+    }
+    ~TraceSpan() {
+        finish();
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void setBytes(uint64_t bytes) { this->bytes = bytes; }
+    // Ends the span before the end of its scope
+    void finish() {
+        if (this->active)
+            Tracer::global().record(this->name, this->begin, Tracer::Clock::now(), this->bytes);
+        this->active = false;
+    }
+};
@@ -0,0 +1,272 @@
+#include "TransferPipeline.h"
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include "AESWrapper.h"
+#include "Tracer.h"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t AES_BLOCK_SIZE = 16;
+
+double StageStats::utilization(std::chrono::nanoseconds wall) const {
+    if (wall.count() == 0)
+        return 0.0;
+    return static_cast<double>(busy.count()) / static_cast<double>(wall.count());
+}
+
+const StageStats& TransferStats::bottleneck() const {
+    const StageStats* busiest = &reader;
+    if (encryptor.busy > busiest->busy)
+        busiest = &encryptor;
+    if (sender.busy > busiest->busy)
+        busiest = &sender;
+    return *busiest;
+}
+
+void TransferStats::print(std::ostream& out) const {
+    double seconds = std::chrono::duration<double>(wall).count();
+    double mbPerSecond = seconds > 0 ? (fileSize / (1024.0 * 1024.0)) / seconds : 0.0;
+
+    out << "Transfer pipeline: " << fileSize << " bytes in " << std::fixed << std::setprecision(1)
+        << seconds * 1000 << " ms (" << mbPerSecond << " MB/s)\n";
+    for (const StageStats* stage : { &reader, &encryptor, &sender }) {
+        out << "  " << std::left << std::setw(12) << stage->name << std::right
+            << " busy " << std::setw(5) << stage->utilization(wall) * 100 << "%"
+            << "  waiting " << std::setw(5) << (wall.count() ? 100.0 * stage->waiting.count() / wall.count() : 0.0) << "%"
+            << "  blocks " << stage->blocks << "\n";
+    }
+    out << "  Bottleneck stage: " << bottleneck().name << "\n";
+    if (!chunkSizes.empty()) {
+        out << "  Frame sizes:";
+        for (const auto& [size, count] : chunkSizes)
+            out << " " << size << " x" << count;
+        out << "\n  Ack round trip " << std::chrono::duration<double, std::milli>(ackRtt).count() << " ms, link "
+            << linkThroughput / (1024.0 * 1024.0) << " MB/s\n";
+    }
+    out << std::defaultfloat << std::flush;
+}
+
+TransferPipeline::TransferPipeline(const std::filesystem::path& path, const string& aesKey, size_t blockSize, size_t depth)
+    : path(path), aesKey(aesKey), blockSize(blockSize), depth(depth)
+{
+    if (blockSize == 0 || blockSize % AES_BLOCK_SIZE != 0)
+        throw std::invalid_argument("Pipeline block size must be a non-zero multiple of the AES block size");
+    if (depth == 0)
+        throw std::invalid_argument("Pipeline ring depth must be at least 1");
+}
+
+size_t TransferPipeline::encryptedSize(size_t fileSize) {
+    return (fileSize / AES_BLOCK_SIZE + 1) * AES_BLOCK_SIZE;
+}
+
+const TransferStats& TransferPipeline::getStats() const {
+    return this->stats;
+}
+
+void TransferPipeline::run(const Sink& sink) {
+    this->stats = TransferStats();
+    this->stats.fileSize = std::filesystem::file_size(this->path);
+    const uint64_t fileSize = this->stats.fileSize;
+    this->chainBlocks.clear();
+    this->chainBlocks.reserve(static_cast<size_t>(fileSize / this->blockSize + 1) * AES_BLOCK_SIZE);
+
+    // Buffer pools. Free rings carry empty buffers back upstream so nothing is allocated per block.
+    vector<ChunkBuffer> plainPool(this->depth);
+    vector<ChunkBuffer> cipherPool(this->depth);
+    SPSCRing<ChunkBuffer*> plainFree(this->depth), plainFull(this->depth);
+    SPSCRing<ChunkBuffer*> cipherFree(this->depth), cipherFull(this->depth);
+    for (size_t i = 0; i < this->depth; i++) {
+        plainPool[i].data.resize(this->blockSize);
+        cipherPool[i].data.resize(this->blockSize + AES_BLOCK_SIZE); // Room for the final padding block
+        plainFree.tryPush(&plainPool[i]);
+        cipherFree.tryPush(&cipherPool[i]);
+    }
+
+    std::mutex errorMutex;
+    std::exception_ptr firstError;
+    auto fail = [&](std::exception_ptr error) {
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!firstError)
+                firstError = error;
+        }
+        plainFree.close();
+        plainFull.close();
+        cipherFree.close();
+        cipherFull.close();
+    };
+
+    auto readStage = [&]() {
+        StageStats& st = this->stats.reader;
+        Tracer::global().setThreadName("pipeline read");
+        try {
+            std::ifstream file(this->path, std::ios::binary);
+            if (!file.is_open())
+                throw std::runtime_error("Unable to open file");
+
+            uint64_t remaining = fileSize;
+            do {
+                ChunkBuffer* buffer = nullptr;
+                auto start = Clock::now();
+                if (!plainFree.pop(buffer))
+                    return;
+                auto work = Clock::now();
+                st.waiting += work - start;
+
+                size_t n = static_cast<size_t>(std::min<uint64_t>(this->blockSize, remaining));
+                {
+                    TraceSpan span("read", n);
+                    file.read(reinterpret_cast<char*>(buffer->data.data()), n);
+                }
+                if (static_cast<size_t>(file.gcount()) != n)
+                    throw std::runtime_error("File shrank while it was being read");
+                remaining -= n;
+                buffer->size = n;
+                buffer->last = remaining == 0;
+                st.blocks++;
+                st.bytes += n;
+
+                auto done = Clock::now();
+                st.busy += done - work;
+                if (!plainFull.push(buffer))
+                    return;
+                st.waiting += Clock::now() - done;
+            } while (remaining > 0);
+        }
+        catch (...) {
+            fail(std::current_exception());
+        }
+    };
+
+    auto encryptStage = [&]() {
+        StageStats& st = this->stats.encryptor;
+        Tracer::global().setThreadName("pipeline encrypt");
+        try {
+            AESStreamEncryptor encryptor(this->aesKey);
+            bool last = false;
+            while (!last) {
+                ChunkBuffer* plain = nullptr;
+                ChunkBuffer* cipher = nullptr;
+                auto start = Clock::now();
+                if (!plainFull.pop(plain) || !cipherFree.pop(cipher))
+                    return;
+                auto work = Clock::now();
+                st.waiting += work - start;
+
+                last = plain->last;
+                {
+                    TraceSpan span("encrypt", plain->size);
+                    cipher->size = last
+                        ? encryptor.finalize(plain->data.data(), plain->size, cipher->data.data())
+                        : encryptor.update(plain->data.data(), plain->size, cipher->data.data());
+                }
+                cipher->last = last;
+                this->chainBlocks.append(reinterpret_cast<const char*>(cipher->data.data() + cipher->size - AES_BLOCK_SIZE), AES_BLOCK_SIZE);
+                st.blocks++;
+                st.bytes += plain->size;
+
+                auto done = Clock::now();
+                st.busy += done - work;
+                if (!plainFree.push(plain) || !cipherFull.push(cipher))
+                    return;
+                st.waiting += Clock::now() - done;
+            }
+        }
+        catch (...) {
+            fail(std::current_exception());
+        }
+    };
+
+    auto sendStage = [&]() {
+        StageStats& st = this->stats.sender;
+        Tracer::global().setThreadName("pipeline send");
+        try {
+            bool last = false;
+            while (!last) {
+                ChunkBuffer* cipher = nullptr;
+                auto start = Clock::now();
+                if (!cipherFull.pop(cipher))
+                    return;
+                auto work = Clock::now();
+                st.waiting += work - start;
+
+                {
+                    TraceSpan span("send", cipher->size);
+                    sink(cipher->data.data(), cipher->size, cipher->last);
+                }
+                last = cipher->last;
+                st.blocks++;
+                st.bytes += cipher->size;
+
+                auto done = Clock::now();
+                st.busy += done - work;
+                if (!cipherFree.push(cipher))
+                    return;
+                st.waiting += Clock::now() - done;
+            }
+        }
+        catch (...) {
+            fail(std::current_exception());
+        }
+    };
+
+    auto wallStart = Clock::now();
+    std::thread reader(readStage);
+    std::thread encryptor(encryptStage);
+    std::thread sender(sendStage);
+    reader.join();
+    encryptor.join();
+    sender.join();
+    this->stats.wall = Clock::now() - wallStart;
+
+    if (firstError)
+        std::rethrow_exception(firstError);
+}
+
+string TransferPipeline::ciphertextRange(uint64_t offset, size_t length) const {
+    const uint64_t fileSize = this->stats.fileSize;
+    const uint64_t blockCount = this->chainBlocks.size() / AES_BLOCK_SIZE;
+    if (blockCount == 0 or offset + length > encryptedSize(static_cast<size_t>(fileSize)))
+        throw std::out_of_range("Ciphertext range outside of the last transfer");
+
+    std::ifstream file(this->path, std::ios::binary);
+    if (!file.is_open())
+        throw std::runtime_error("Unable to open file");
+
+    string out;
+    out.reserve(length);
+    vector<uint8_t> plain(this->blockSize);
+    vector<uint8_t> cipher(this->blockSize + AES_BLOCK_SIZE);
+
+    // The padding block belongs to the last pipeline block, which may be one AES block longer
+    uint64_t first = std::min(offset / this->blockSize, blockCount - 1);
+    uint64_t lastBlock = std::min((offset + length - 1) / this->blockSize, blockCount - 1);
+    for (uint64_t b = first; b <= lastBlock and length > 0; b++) {
+        uint64_t blockStart = b * this->blockSize;
+        size_t plainSize = static_cast<size_t>(std::min<uint64_t>(this->blockSize, fileSize - blockStart));
+        file.seekg(static_cast<std::streamoff>(blockStart));
+        file.read(reinterpret_cast<char*>(plain.data()), plainSize);
+        if (static_cast<size_t>(file.gcount()) != plainSize)
+            throw std::runtime_error("File shrank while it was being read");
+
+        uint8_t iv[AES_BLOCK_SIZE] = { 0 };
+        if (b > 0)
+            std::copy_n(this->chainBlocks.data() + (b - 1) * AES_BLOCK_SIZE, AES_BLOCK_SIZE, reinterpret_cast<char*>(iv));
+        AESStreamEncryptor encryptor(this->aesKey, iv);
+        size_t cipherSize = b == blockCount - 1
+            ? encryptor.finalize(plain.data(), plainSize, cipher.data())
+            : encryptor.update(plain.data(), plainSize, cipher.data());
+
+        size_t from = static_cast<size_t>(offset - blockStart);
+        size_t n = std::min(length, cipherSize - from);
+        out.append(reinterpret_cast<const char*>(cipher.data() + from), n);
+        offset += n;
+        length -= n;
+    }
+    return out;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "SPSCRing.h"
+
+using std::uint8_t, std::uint32_t, std::uint64_t, std::string, std::vector;
+
+constexpr size_t PIPELINE_BLOCK_SIZE = 64 * 1024; // Plaintext bytes per disk read, must be a multiple of the AES block size
+constexpr size_t PIPELINE_RING_DEPTH = 8;         // Pooled buffers in flight between two stages
+
+// A pooled buffer handed between pipeline stages
+struct ChunkBuffer {
+    vector<uint8_t> data;
+    size_t size;
+    bool last;
+};
+
+struct StageStats {
+    string name;
+    std::chrono::nanoseconds busy{ 0 };    // Time spent doing the stage's own work
+    std::chrono::nanoseconds waiting{ 0 }; // Time blocked on an empty input or a full output ring
+    uint64_t blocks = 0;
+    uint64_t bytes = 0;
+
+    double utilization(std::chrono::nanoseconds wall) const;
+};
+
+struct TransferStats {
+    StageStats reader{ "read" };
+    StageStats encryptor{ "encrypt" };
+    StageStats sender{ "send" };
+    std::chrono::nanoseconds wall{ 0 };
+    uint64_t fileSize = 0;
+
+    // Filled in by ChunkSizer when frames are sized adaptively
+    std::map<size_t, uint64_t> chunkSizes; // Frame size -> frames sent at that size
+    std::chrono::nanoseconds ackRtt{ 0 };  // Smoothed acknowledgement round trip
+    double linkThroughput = 0;             // Bytes per second
+
+    const StageStats& bottleneck() const;
+    void print(std::ostream& out) const;
+};
+
+// Streams a file through three threads connected by SPSC rings of pooled buffers:
+//   reader (ifstream::read) -> encrypt (AESStreamEncryptor) -> sender (sink)
+// A stage that gets ahead blocks on a full ring, so at most 2 * depth blocks are held in memory.
+// The whole-file hash comes from digestFile, which reads the file once before the upload.
+class TransferPipeline {
+public:
+    // Called on the sender thread with each encrypted block, in file order
+    using Sink = std::function<void(const uint8_t* data, size_t size, bool last)>;
+
+private:
+    std::filesystem::path path;
+    string aesKey;
+    size_t blockSize;
+    size_t depth;
+    TransferStats stats;
+    string chainBlocks; // Last ciphertext block of every pipeline block, the CBC state to resume from
+
+public:
+    TransferPipeline(const std::filesystem::path& path, const string& aesKey,
+                     size_t blockSize = PIPELINE_BLOCK_SIZE, size_t depth = PIPELINE_RING_DEPTH);
+
+    // Runs all three stages to completion; rethrows the first error raised by any stage
+    void run(const Sink& sink);
+
+    const TransferStats& getStats() const;
+
+    // Re-reads and re-encrypts only the pipeline blocks covering [offset, offset + length) of the
+    // ciphertext produced by the last run(), resuming CBC from the recorded chain blocks
+    string ciphertextRange(uint64_t offset, size_t length) const;
+
+    // Size of the AES-CBC/PKCS7 ciphertext for a plaintext of fileSize bytes
+    static size_t encryptedSize(size_t fileSize);
+};
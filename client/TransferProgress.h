@@ -0,0 +1,17 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// How far one transfer got, in plaintext bytes. The transfer's own thread stores into it as
+// frames go out (or ranges come in), so watching it costs the transfer a relaxed store per
+// frame; any other thread may read it at any time.
+struct TransferProgress {
+    std::atomic<uint64_t> bytesDone{ 0 };
+    std::atomic<uint64_t> bytesTotal{ 0 };  // 0 until the transfer knows the file size
+
+    void reset() {
+        this->bytesDone.store(0, std::memory_order_relaxed);
+        this->bytesTotal.store(0, std::memory_order_relaxed);
+    }
+};
@@ -0,0 +1,300 @@
+#include "UploadIndex.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "Logger.h"
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+#include "utils.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+constexpr char UPLOAD_INDEX_MAGIC[8] = { 'F', 'T', 'S', 'I', 'D', 'X', '0', '2' };
+constexpr size_t INDEX_WRITE_BUFFER = 1024 * 1024;
+
+bool LocalFileState::operator==(const LocalFileState& other) const {
+    return size == other.size and mtime == other.mtime and inode == other.inode;
+}
+
+LocalFileState LocalFileState::of(const std::filesystem::path& path) {
+    LocalFileState state;
+#ifdef _WIN32
+    state.size = std::filesystem::file_size(path);
+    state.mtime = static_cast<int64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+
+    // Zero access rights only reads metadata, the file's data is never opened
+    HANDLE handle = CreateFileW(path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (handle != INVALID_HANDLE_VALUE) {
+        BY_HANDLE_FILE_INFORMATION info;
+        if (GetFileInformationByHandle(handle, &info))
+            state.inode = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+        CloseHandle(handle);
+    }
+#else
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0)
+        throw std::filesystem::filesystem_error("Unable to stat file", path, std::error_code(errno, std::generic_category()));
+    state.size = static_cast<uint64_t>(st.st_size);
+    state.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    state.inode = static_cast<uint64_t>(st.st_ino);
+#endif
+    return state;
+}
+
+UploadIndex::UploadIndex(const std::filesystem::path& indexPath, const string& clientID)
+    : indexPath(indexPath), clientID(adjustStringSize(clientID, 16)), records(nullptr), recordCount(0), strings(nullptr), stringsSize(0)
+{
+    open();
+}
+
+string UploadIndex::keyOf(const std::filesystem::path& localPath) {
+    return std::filesystem::absolute(localPath).lexically_normal().generic_string();
+}
+
+uint64_t UploadIndex::hash(const string& data) {
+    // FNV-1a, 64 bit
+    uint64_t h = 14695981039346656037ULL;
+    for (unsigned char c : data) {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+void UploadIndex::open() {
+    this->records = nullptr;
+    this->recordCount = 0;
+    this->strings = nullptr;
+    this->stringsSize = 0;
+
+    std::error_code ec;
+    uint64_t fileSize = std::filesystem::file_size(this->indexPath, ec);
+    if (ec or fileSize < sizeof(UploadIndexHeader))
+        return;
+
+    this->mapping = boost::interprocess::file_mapping(this->indexPath.string().c_str(), boost::interprocess::read_only);
+    this->region = boost::interprocess::mapped_region(this->mapping, boost::interprocess::read_only);
+    const char* base = static_cast<const char*>(this->region.get_address());
+
+    UploadIndexHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, UPLOAD_INDEX_MAGIC, sizeof(header.magic)) != 0) {
+        // The last two bytes are the format version
+        if (std::memcmp(header.magic, UPLOAD_INDEX_MAGIC, sizeof(header.magic) - 2) == 0)
+            LOG_INFO("Upload index has an older format, every file will be checked and the index rewritten.");
+        else
+            LOG_WARN("Ignoring " << this->indexPath << ": not an upload index.");
+        close();
+        return;
+    }
+    if (std::memcmp(header.clientID, this->clientID.data(), sizeof(header.clientID)) != 0) {
+        LOG_INFO("Upload index belongs to another client ID, every file will be sent.");
+        close();
+        return;
+    }
+    uint64_t recordsEnd = sizeof(UploadIndexHeader) + header.recordCount * sizeof(UploadIndexRecord);
+    if (header.recordCount > fileSize / sizeof(UploadIndexRecord) or header.stringsOffset != recordsEnd or recordsEnd > fileSize) {
+        LOG_WARN("Ignoring " << this->indexPath << ": the file is truncated or corrupt.");
+        close();
+        return;
+    }
+
+    this->records = reinterpret_cast<const UploadIndexRecord*>(base + sizeof(UploadIndexHeader));
+    this->recordCount = header.recordCount;
+    this->strings = base + header.stringsOffset;
+    this->stringsSize = fileSize - header.stringsOffset;
+}
+
+void UploadIndex::close() {
+    // Windows refuses to replace a file that is still mapped
+    this->region = boost::interprocess::mapped_region();
+    this->mapping = boost::interprocess::file_mapping();
+    this->records = nullptr;
+    this->recordCount = 0;
+    this->strings = nullptr;
+    this->stringsSize = 0;
+}
+
+bool UploadIndex::pathOf(const UploadIndexRecord& record, std::string_view& path) const {
+    if (record.pathOffset > this->stringsSize or record.pathLength > this->stringsSize - record.pathOffset)
+        return false;
+    path = std::string_view(this->strings + record.pathOffset, record.pathLength);
+    return true;
+}
+
+const UploadIndexRecord* UploadIndex::find(const string& key, uint64_t hash) const {
+    if (this->records == nullptr)
+        return nullptr;
+
+    const UploadIndexRecord* end = this->records + this->recordCount;
+    const UploadIndexRecord* it = std::lower_bound(this->records, end, hash,
+        [](const UploadIndexRecord& record, uint64_t h) { return record.pathHash < h; });
+
+    // Hash collisions are resolved by comparing the stored path
+    for (; it != end and it->pathHash == hash; it++) {
+        std::string_view path;
+        if (!pathOf(*it, path))
+            return nullptr;
+        if (path == key)
+            return it;
+    }
+    return nullptr;
+}
+
+bool UploadIndex::isUnchanged(const std::filesystem::path& localPath, const string& remoteName, const LocalFileState& state) const {
+    string key = keyOf(localPath);
+    {
+        std::lock_guard<std::mutex> lock(this->pendingMutex);
+        auto it = this->pending.find(key);
+        if (it != this->pending.end())
+            return it->second.remoteName == remoteName and it->second.state == state;
+    }
+
+    const UploadIndexRecord* record = find(key, hash(key));
+    if (record == nullptr)
+        return false;
+    LocalFileState indexed{ record->size, record->mtime, record->inode };
+    return record->remoteHash == hash(remoteName) and indexed == state;
+}
+
+void UploadIndex::recordConfirmed(const std::filesystem::path& localPath, const string& remoteName, const LocalFileState& state, FileHash hash) {
+    string key = keyOf(localPath);
+    std::lock_guard<std::mutex> lock(this->pendingMutex);
+    this->pending[key] = { remoteName, state, hash };
+}
+
+void UploadIndex::save() {
+    // Step 1: Sort this run's confirmations the same way as the file
+    struct Update {
+        uint64_t hash;
+        const string* key;
+        const PendingEntry* entry;
+    };
+    std::lock_guard<std::mutex> lock(this->pendingMutex);
+    if (this->pending.empty())
+        return;
+
+    std::vector<Update> updates;
+    updates.reserve(this->pending.size());
+    for (const auto& [key, entry] : this->pending) {
+        if (key.size() > UINT32_MAX)
+            throw std::runtime_error("Path too long for the upload index: " + key.substr(0, 255) + "...");
+        updates.push_back({ hash(key), &key, &entry });
+    }
+    std::sort(updates.begin(), updates.end(), [](const Update& a, const Update& b) {
+        return a.hash != b.hash ? a.hash < b.hash : *a.key < *b.key;
+    });
+
+    // Old records whose path runs past the end of the file are dropped, find() never matched them
+    auto recordPath = [&](const UploadIndexRecord& record) {
+        std::string_view path;
+        pathOf(record, path);
+        return path;
+    };
+    auto skipCorrupt = [&](uint64_t& i) {  // Moves i to the next record that can be kept
+        std::string_view path;
+        while (i < this->recordCount and !pathOf(this->records[i], path))
+            i++;
+    };
+    // < 0 if the old record sorts first, 0 if the update replaces it
+    auto compare = [&](const UploadIndexRecord& record, const Update& update) {
+        if (record.pathHash != update.hash)
+            return record.pathHash < update.hash ? -1 : 1;
+        return recordPath(record).compare(*update.key);
+    };
+
+    // Step 2: Count the merged records, the header needs to know where the paths start
+    uint64_t mergedCount = 0;
+    {
+        uint64_t i = 0;
+        size_t j = 0;
+        skipCorrupt(i);
+        while (i < this->recordCount or j < updates.size()) {
+            int order = i == this->recordCount ? 1 : j == updates.size() ? -1 : compare(this->records[i], updates[j]);
+            if (order <= 0)
+                skipCorrupt(++i);
+            if (order >= 0)
+                j++;
+            mergedCount++;
+        }
+    }
+
+    // Step 3: Stream records into the new index and paths into a side file, then join them
+    std::filesystem::path tmpPath = this->indexPath;
+    tmpPath += ".tmp";
+    std::filesystem::path stringsPath = this->indexPath;
+    stringsPath += ".strings.tmp";
+    {
+        std::vector<char> recordBuffer(INDEX_WRITE_BUFFER), stringBuffer(INDEX_WRITE_BUFFER);
+        std::ofstream out, pathsOut;
+        out.rdbuf()->pubsetbuf(recordBuffer.data(), recordBuffer.size());
+        pathsOut.rdbuf()->pubsetbuf(stringBuffer.data(), stringBuffer.size());
+        out.open(tmpPath, std::ios::binary | std::ios::trunc);
+        pathsOut.open(stringsPath, std::ios::binary | std::ios::trunc);
+        if (!out.is_open() or !pathsOut.is_open())
+            throw std::runtime_error("Unable to write upload index " + tmpPath.string());
+
+        UploadIndexHeader header;
+        std::memcpy(header.magic, UPLOAD_INDEX_MAGIC, sizeof(header.magic));
+        std::memcpy(header.clientID, this->clientID.data(), sizeof(header.clientID));
+        header.recordCount = mergedCount;
+        header.stringsOffset = sizeof(UploadIndexHeader) + mergedCount * sizeof(UploadIndexRecord);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        uint64_t pathOffset = 0;
+        uint64_t i = 0;
+        size_t j = 0;
+        skipCorrupt(i);
+        while (i < this->recordCount or j < updates.size()) {
+            int order = i == this->recordCount ? 1 : j == updates.size() ? -1 : compare(this->records[i], updates[j]);
+            UploadIndexRecord record;
+            if (order < 0) {
+                record = this->records[i];
+                std::string_view path = recordPath(record);
+                pathsOut.write(path.data(), path.size());
+            }
+            else {
+                const Update& update = updates[j];
+                record.pathHash = update.hash;
+                record.remoteHash = hash(update.entry->remoteName);
+                record.size = update.entry->state.size;
+                record.mtime = update.entry->state.mtime;
+                record.inode = update.entry->state.inode;
+                record.hash = update.entry->hash.value;
+                record.hashAlgorithm = static_cast<uint8_t>(update.entry->hash.algorithm);
+                record.pathLength = static_cast<uint32_t>(update.key->size());
+                pathsOut.write(update.key->data(), update.key->size());
+            }
+            record.pathOffset = pathOffset;
+            pathOffset += record.pathLength;
+            out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+
+            if (order <= 0)
+                skipCorrupt(++i);
+            if (order >= 0)
+                j++;
+        }
+
+        pathsOut.close();
+        std::ifstream pathsIn(stringsPath, std::ios::binary);
+        out << pathsIn.rdbuf();
+        out.close();
+        if (!out)
+            throw std::runtime_error("Unable to write upload index " + tmpPath.string());
+    }
+    std::filesystem::remove(stringsPath);
+
+    // Step 4: Swap the new file in and map it
+    close();
+    std::filesystem::rename(tmpPath, this->indexPath);
+    open();
+    this->pending.clear();
+    LOG_INFO("Upload index saved: " << this->recordCount << " files.");
+}
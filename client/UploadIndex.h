@@ -0,0 +1,94 @@
+#pragma once
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "FastHash.h"
+
+using std::string;
+
+constexpr char UPLOAD_INDEX_FILE[] = "upload.index";
+
+// What a file looked like on disk, read from its metadata only
+struct LocalFileState {
+    uint64_t size = 0;
+    int64_t mtime = 0;  // Filesystem clock ticks, only compared for equality
+    uint64_t inode = 0; // st_ino on POSIX, the NTFS file index on Windows
+
+    bool operator==(const LocalFileState& other) const;
+    // Throws std::filesystem::filesystem_error if the file cannot be stat'ed
+    static LocalFileState of(const std::filesystem::path& path);
+};
+
+#pragma pack(push, 1)
+struct UploadIndexHeader {
+    char magic[8];          // "FTSIDX02"; version 01 kept a 32-bit CRC per record
+    char clientID[16];      // The index is only trusted for the identity that built it
+    uint64_t recordCount;
+    uint64_t stringsOffset; // Start of the path bytes, right after the records
+};
+
+// One fixed size record per file, sorted by (pathHash, path) so lookups are a
+// binary search straight over the mapped file
+struct UploadIndexRecord {
+    uint64_t pathHash;
+    uint64_t remoteHash;    // FNV-1a of the name the file was stored under
+    uint64_t size;
+    int64_t mtime;
+    uint64_t inode;
+    uint64_t hash;          // What the server confirmed with FILE_OK, FILE_HASH_OK or PACK_OK
+    uint8_t hashAlgorithm;  // HashAlgorithm of hash
+    uint32_t pathLength;
+    uint64_t pathOffset;    // Relative to stringsOffset
+};
+#pragma pack(pop)
+
+// Persistent client side record of files the server has confirmed, used by the
+// incremental mode to skip unchanged files without opening them. The index file is
+// memory mapped read-only; confirmations from the current run are kept in memory
+// and merged into a new file by save(), so lookups never deserialize the whole index.
+class UploadIndex {
+private:
+    struct PendingEntry {
+        string remoteName;
+        LocalFileState state;
+        FileHash hash;
+    };
+
+    std::filesystem::path indexPath;
+    string clientID;
+    boost::interprocess::file_mapping mapping;
+    boost::interprocess::mapped_region region;
+    const UploadIndexRecord* records;
+    uint64_t recordCount;
+    const char* strings;
+    uint64_t stringsSize;   // Mapped bytes from strings to the end of the file
+
+    mutable std::mutex pendingMutex;
+    std::unordered_map<string, PendingEntry> pending;
+
+    void open();
+    void close();
+    // False if the record's path runs past the end of the file
+    bool pathOf(const UploadIndexRecord& record, std::string_view& path) const;
+    const UploadIndexRecord* find(const string& key, uint64_t hash) const;
+
+public:
+    UploadIndex(const std::filesystem::path& indexPath, const string& clientID);
+
+    static string keyOf(const std::filesystem::path& localPath);
+    static uint64_t hash(const string& data);
+
+    // True if the file was confirmed under remoteName and its size, mtime and inode did not change since
+    bool isUnchanged(const std::filesystem::path& localPath, const string& remoteName, const LocalFileState& state) const;
+    // state must be taken before the file was read for the upload. Safe to call from several threads.
+    void recordConfirmed(const std::filesystem::path& localPath, const string& remoteName, const LocalFileState& state, FileHash hash);
+    // Merges this run's confirmations into the index file and remaps it. Not safe to
+    // call while lookups or uploads are still running.
+    void save();
+};
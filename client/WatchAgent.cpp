@@ -0,0 +1,229 @@
+#include "WatchAgent.h"
+#include <algorithm>
+#include <thread>
+#include "Logger.h"
+
+static double millisecondsBetween(FolderWatcher::Clock::time_point from, FolderWatcher::Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+WatchAgent::WatchAgent(const Client& primary, vector<std::filesystem::path> roots, size_t inFlight, std::chrono::milliseconds debounce,
+                       UploadIndex* uploadIndex)
+    : inFlight(inFlight), uploadIndex(uploadIndex), pool(primary, std::max<size_t>(inFlight, 1)), watcher(std::move(roots), debounce), stopping(false),
+      uploaded(0), failed(0)
+{
+    if (inFlight == 0)
+        throw std::invalid_argument("The watch agent needs at least one upload in flight");
+}
+
+void WatchAgent::stop() {
+    this->watcher.stop();
+}
+
+void WatchAgent::enqueue(WatchedFile file) {
+    string key = file.path.string();
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        if (this->uploading.count(key)) {
+            // The upload running now may have read the old content, send it again once it is done
+            this->dirty[key] = std::move(file);
+            return;
+        }
+        if (this->queued.count(key)) {
+            // Keeps its place in the queue; only the latest close counts for its latency
+            auto it = std::find_if(this->queue.begin(), this->queue.end(), [&](const WatchedFile& entry) { return entry.path == file.path; });
+            it->closedAt = file.closedAt;
+            it->notBefore = file.notBefore;
+            it->attempts = 0;
+            return;
+        }
+        this->queued.insert(key);
+        this->queue.push_back(std::move(file));
+    }
+    this->changed.notify_one();
+}
+
+void WatchAgent::catchUp() {
+    // Files that changed while the agent was not running; unchanged ones are skipped by upload()
+    size_t count = 0;
+    auto now = Clock::now();
+    for (const auto& root : this->watcher.getRoots()) {
+        std::error_code error;
+        std::filesystem::recursive_directory_iterator it(root, std::filesystem::directory_options::skip_permission_denied, error);
+        for (; !error and it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+            std::error_code statError;
+            if (!it->is_regular_file(statError))
+                continue;
+            string remoteName = (root.filename() / it->path().lexically_relative(root)).generic_string();
+            LocalFileState state;
+            try {
+                state = LocalFileState::of(it->path());
+            }
+            catch (const std::filesystem::filesystem_error&) {
+                continue;  // Deleted while scanning
+            }
+            if (this->uploadIndex->isUnchanged(it->path(), remoteName, state))
+                continue;
+            enqueue({ it->path(), remoteName, now, now, 0 });
+            count++;
+        }
+    }
+    LOG_INFO(count << " files changed since the last run, queued for upload.");
+}
+
+bool WatchAgent::take(WatchedFile& file) {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (!this->stopping) {
+        // The oldest file that is not waiting for a retry
+        auto now = Clock::now();
+        auto next = Clock::time_point::max();
+        for (auto it = this->queue.begin(); it != this->queue.end(); it++) {
+            if (it->notBefore <= now) {
+                file = std::move(*it);
+                this->queue.erase(it);
+                string key = file.path.string();
+                this->queued.erase(key);
+                this->uploading.insert(key);
+                return true;
+            }
+            next = std::min(next, it->notBefore);
+        }
+        if (next == Clock::time_point::max())
+            this->changed.wait(lock);
+        else
+            this->changed.wait_until(lock, next);
+    }
+    return false;
+}
+
+void WatchAgent::upload(WatchedFile& file) {
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(file.path, error)) {
+        LOG_DEBUG(file.path << " is gone, nothing to upload.");
+        return;
+    }
+    // Taken before the file is read, so a change during the upload is not recorded as confirmed
+    LocalFileState state;
+    if (this->uploadIndex != nullptr) {
+        state = LocalFileState::of(file.path);
+        std::shared_lock<std::shared_mutex> lock(this->indexMutex);
+        if (this->uploadIndex->isUnchanged(file.path, file.remoteName, state)) {
+            LOG_DEBUG(file.remoteName << " is unchanged since its last confirmed upload, skipping.");
+            return;
+        }
+    }
+
+    auto started = Clock::now();
+    FileHash hash;
+    {
+        auto session = this->pool.checkout();
+        hash = session->sendFile(file.path, file.remoteName);
+    }
+    auto confirmed = Clock::now();
+
+    if (this->uploadIndex != nullptr) {
+        std::shared_lock<std::shared_mutex> lock(this->indexMutex);
+        this->uploadIndex->recordConfirmed(file.path, file.remoteName, state, hash);
+    }
+    this->uploaded++;
+    LOG_INFO(file.remoteName << " confirmed " << millisecondsBetween(file.closedAt, confirmed) << " ms after it was closed ("
+             << millisecondsBetween(started, confirmed) << " ms upload).");
+}
+
+void WatchAgent::finish(const WatchedFile& file, bool retry) {
+    string key = file.path.string();
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->uploading.erase(key);
+        auto changedMeanwhile = this->dirty.find(key);
+        if (changedMeanwhile != this->dirty.end()) {
+            this->queued.insert(key);
+            this->queue.push_back(std::move(changedMeanwhile->second));
+            this->dirty.erase(changedMeanwhile);
+        }
+        else if (retry and file.attempts + 1 < WATCH_UPLOAD_ATTEMPTS) {
+            WatchedFile again = file;
+            again.attempts++;
+            again.notBefore = Clock::now() + WATCH_RETRY_DELAY;
+            this->queued.insert(key);
+            this->queue.push_back(std::move(again));
+        }
+        else if (retry) {
+            this->failed++;
+            LOG_ERROR("Giving up on " << file.remoteName << " after " << WATCH_UPLOAD_ATTEMPTS << " attempts, it is retried when it changes again.");
+        }
+    }
+    this->changed.notify_all();
+}
+
+void WatchAgent::worker() {
+    WatchedFile file;
+    while (take(file)) {
+        bool retry = false;
+        try {
+            upload(file);
+        }
+        catch (const std::exception& e) {
+            LOG_WARN("Upload of " << file.remoteName << " failed: " << e.what());
+            retry = true;
+        }
+        finish(file, retry);
+    }
+}
+
+void WatchAgent::saveIndex() {
+    if (this->uploadIndex == nullptr)
+        return;
+    std::unique_lock<std::shared_mutex> lock(this->indexMutex);
+    try {
+        this->uploadIndex->save();
+    }
+    catch (const std::exception& e) {
+        LOG_WARN("Could not save the upload index: " << e.what());
+    }
+}
+
+void WatchAgent::run() {
+    // Step 1: Catch up on what changed while the agent was not running
+    if (this->uploadIndex != nullptr)
+        catchUp();
+
+    // Step 2: Uploaders, and a thread writing confirmations to the index now and then
+    vector<std::thread> workers;
+    for (size_t i = 0; i < this->inFlight; i++)
+        workers.emplace_back(&WatchAgent::worker, this);
+    std::thread saver;
+    if (this->uploadIndex != nullptr) {
+        saver = std::thread([this] {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            while (!this->stopped.wait_for(lock, WATCH_INDEX_SAVE_INTERVAL, [this] { return this->stopping; })) {
+                lock.unlock();
+                saveIndex();
+                lock.lock();
+            }
+        });
+    }
+
+    // Step 3: Watch until stop(); completed files go to the queue
+    LOG_INFO("Watching " << this->watcher.getRoots().size() << " folders, up to " << this->inFlight << " uploads at once.");
+    this->watcher.run([this](const std::filesystem::path& root, const std::filesystem::path& file, Clock::time_point closedAt) {
+        string remoteName = (root.filename() / file.lexically_relative(root)).generic_string();
+        enqueue({ file, remoteName, closedAt, closedAt, 0 });
+    });
+
+    // Step 4: Let running uploads finish; whatever is still queued is caught up on next time with an index
+    size_t abandoned;
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+        abandoned = this->queue.size() + this->dirty.size();
+    }
+    this->changed.notify_all();
+    this->stopped.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+    if (saver.joinable())
+        saver.join();
+    saveIndex();
+    LOG_INFO("Watch agent stopped: " << this->uploaded << " files uploaded, " << this->failed << " given up, " << abandoned << " left queued.");
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "Client.h"
+#include "FolderWatcher.h"
+#include "SessionPool.h"
+#include "UploadIndex.h"
+
+using std::string, std::vector;
+
+constexpr auto WATCH_DEFAULT_DEBOUNCE = std::chrono::milliseconds(100); // Quiet time after a file was closed before it is uploaded
+constexpr size_t WATCH_DEFAULT_IN_FLIGHT = 4;                           // Uploads running at once, each on its own pooled session
+constexpr int WATCH_UPLOAD_ATTEMPTS = 3;                                // Per change of a file, before it is given up until it changes again
+constexpr auto WATCH_RETRY_DELAY = std::chrono::seconds(2);
+constexpr auto WATCH_INDEX_SAVE_INTERVAL = std::chrono::seconds(60);   // How often confirmations are written to the upload index
+
+struct WatchedFile {
+    std::filesystem::path path;
+    string remoteName;  // Path relative to the watched folder, prefixed with the folder's name like directory uploads
+    FolderWatcher::Clock::time_point closedAt;
+    FolderWatcher::Clock::time_point notBefore;  // Retries wait until then
+    int attempts = 0;
+};
+
+// Stays resident and uploads files as they are completed in a set of watched folders.
+// Completed files are queued once each (a file that changes again while queued keeps its
+// place, one that changes while it is uploading is queued again afterwards) and uploaded
+// by at most inFlight workers, each holding a session of a SessionPool, so no upload pays
+// for a connection or login. Every upload logs the time from the file's close to the
+// server's confirmation. With an upload index, files that changed while the agent was not
+// running are caught up on at start, and unchanged ones are skipped.
+class WatchAgent {
+private:
+    using Clock = FolderWatcher::Clock;
+
+    size_t inFlight;
+    UploadIndex* uploadIndex;
+    SessionPool pool;
+    FolderWatcher watcher;
+
+    std::mutex mutex;
+    std::condition_variable changed;       // Workers wait on it for the queue
+    std::condition_variable stopped;       // The index saver waits on it between saves
+    std::deque<WatchedFile> queue;
+    std::unordered_set<string> queued;     // Paths in queue
+    std::unordered_set<string> uploading;  // Paths a worker is sending
+    std::unordered_map<string, WatchedFile> dirty; // Paths that changed while they were uploading
+    bool stopping;
+    std::shared_mutex indexMutex;          // Shared for lookups and confirmations, exclusive for save()
+    std::atomic<uint64_t> uploaded;
+    std::atomic<uint64_t> failed;
+
+    void enqueue(WatchedFile file);
+    void catchUp();
+    bool take(WatchedFile& file);
+    void upload(WatchedFile& file);
+    void finish(const WatchedFile& file, bool retry);
+    void worker();
+    void saveIndex();
+
+public:
+    // primary must be logged in; it is the identity of the pooled sessions
+    WatchAgent(const Client& primary, vector<std::filesystem::path> roots, size_t inFlight = WATCH_DEFAULT_IN_FLIGHT,
+               std::chrono::milliseconds debounce = WATCH_DEFAULT_DEBOUNCE, UploadIndex* uploadIndex = nullptr);
+
+    // Watches and uploads until stop() is called, then lets running uploads finish
+    void run();
+    // May be called from any thread, including a signal handler
+    void stop();
+};
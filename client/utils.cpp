@@ -28,6 +28,15 @@ vector<uint8_t> serializeInt(uint32_t num)
 	return serializedInt;
 }
 
+vector<uint8_t> serializeLong(uint64_t num)
+{
+	vector<uint8_t> serializedLong(8);
+	for (size_t i = 0; i < 8; i++) {
+		serializedLong[i] = static_cast<uint8_t>((num >> (8 * i)) & 0xFF);
+	}
+	return serializedLong;
+}
+
 vector<uint8_t> serializeString(const string& input) {
 	vector<uint8_t> serialized(input.begin(), input.end());  // Copy each character as uint8_t
 	return serialized;
@@ -94,6 +103,17 @@ uint32_t deserializeInt(const vector<uint8_t>& data, size_t offset) {
 	return value;  // Already little-endian
 }
 
+uint64_t deserializeLong(const vector<uint8_t>& data, size_t offset) {
+	if (offset + 7 >= data.size()) {
+		throw std::out_of_range("Offset out of range for deserializing long");
+	}
+	uint64_t value = 0;
+	for (size_t i = 0; i < 8; i++) {
+		value |= static_cast<uint64_t>(data[offset + i]) << (8 * i);
+	}
+	return value;  // Already little-endian
+}
+
 string deserializeString(const vector<uint8_t>& data, size_t offset, size_t length) {
 	if (offset + length > data.size()) {
 		throw std::out_of_range("Offset out of range for deserializing string");
@@ -0,0 +1,141 @@
+import asyncio
+from concurrent.futures import ThreadPoolExecutor
+
+from client_handler import ClientHandler, CLIENT_HEADER_SIZE, MAX_FRAME_SIZE
+from database_management import ClientDBManager, FileDBManager, CLIENT_DB, FILE_DB
+from blob_store import BlobStore
+from group_sync import GroupSync
+from log import logger, log_packet
+from protocol.requests import RequestCode, RequestHeader
+
+try:
+    import resource
+except ImportError:  # Windows has no rlimits, its socket limit is not per process
+    resource = None
+
+
+WRITE_BUFFER_HIGH = 8 * 1024 * 1024  # Unsent response bytes one connection may hold before its reads pause
+READ_BUFFER_LIMIT = 64 * 1024  # Read ahead per connection (the stream pauses at twice this); readexactly still takes whole frames
+IDLE_TIMEOUT = 15 * 60  # Seconds a connection may sit between frames before it is dropped
+
+# Frames that touch no file, database or key material; they run on the event loop itself
+INLINE_CODES = {
+    RequestCode.NEGOTIATE_CHUNKS.value,
+}
+
+
+class ResponseBuffer:
+    """Stands in for the client socket of a ClientHandler run by AsyncServer.
+
+    Handlers send their responses as usual; the bytes are collected here and written to the
+    transport by the connection's coroutine once the frame is handled.
+    """
+
+    def __init__(self):
+        self._parts = []
+
+    def send(self, data):
+        self._parts.append(bytes(data))
+        return len(data)
+
+    def sendall(self, data):
+        self.send(data)
+
+    def take(self):
+        data = b''.join(self._parts)
+        self._parts.clear()
+        return data
+
+    def close(self):
+        pass
+
+
+class AsyncServer:
+    """Serves every connection from one asyncio event loop instead of a thread per client.
+
+    An idle or slow connection costs a coroutine and its stream buffers rather than a thread
+    stack, so tens of thousands of them fit in one process. Frames are read on the loop; the
+    handler work for each frame (disk, database, RSA/AES, finalizing uploads) runs on a
+    bounded thread pool, one frame at a time per connection, so requests keep their order.
+    """
+
+    def __init__(self, host, port, backlog, workers, durable=False):
+        self.server_host = host
+        self.server_port = port
+        self.backlog = backlog
+        self.workers = workers
+        self.executor = ThreadPoolExecutor(max_workers=workers, thread_name_prefix='handler')
+        self.client_db_manager = ClientDBManager(CLIENT_DB, durable)  # Initialize the Client DB Manager
+        self.file_db_manager = FileDBManager(FILE_DB, durable)  # Initialize the File DB Manager
+        self.files_path = './files/'  # Directory to store files
+        group_sync = GroupSync() if durable else None  # fsyncs for all connections at once, see GroupSync
+        self.blob_store = BlobStore(self.files_path, self.file_db_manager, group_sync)  # Shared, so identical uploads are stored once
+
+    def start_server(self):
+        raise_file_limit()
+        try:
+            asyncio.run(self.serve())
+        except KeyboardInterrupt:
+            logger.info("Server is shutting down...")
+        finally:
+            self.executor.shutdown(wait=False)
+
+    async def serve(self):
+        server = await asyncio.start_server(self.handle_client, self.server_host, self.server_port,
+                                            backlog=self.backlog, limit=READ_BUFFER_LIMIT)
+        logger.info(f"Server listening on {self.server_host}:{self.server_port} (event loop, {self.workers} workers)")
+        async with server:
+            await server.serve_forever()
+
+    async def handle_client(self, reader: asyncio.StreamReader, writer: asyncio.StreamWriter):
+        logger.info(f"Connection established with {writer.get_extra_info('peername')}")
+        writer.transport.set_write_buffer_limits(high=WRITE_BUFFER_HIGH)
+        responses = ResponseBuffer()
+        client_handler = ClientHandler(responses, self.client_db_manager, self.file_db_manager, self.files_path, self.blob_store)
+        loop = asyncio.get_running_loop()
+
+        try:
+            while True:
+                # Step 1: Read one whole frame; a payload size past the cap ends the connection
+                # before anything is buffered for it
+                header_data = await asyncio.wait_for(reader.readexactly(CLIENT_HEADER_SIZE), IDLE_TIMEOUT)
+                header = RequestHeader.deserialize_header(header_data)
+                if header._payload_size > MAX_FRAME_SIZE:
+                    logger.warning(f"Client announced a {header._payload_size} byte payload, over the {MAX_FRAME_SIZE} byte limit")
+                    return
+                log_packet("Received header code: %d, payload size: %d", header._code, header._payload_size)
+                payload_data = await reader.readexactly(header._payload_size)
+
+                # Step 2: Handle it, off the loop unless it is cheap
+                if header._code in INLINE_CODES:
+                    result = client_handler.dispatch(header, payload_data)
+                else:
+                    result = await loop.run_in_executor(self.executor, client_handler.dispatch, header, payload_data)
+
+                # Step 3: Write the responses; drain waits while the client is slow to read them
+                data = responses.take()
+                if data:
+                    writer.write(data)
+                    await writer.drain()
+                if result == "disconnect" or result == "error":
+                    return
+        except (asyncio.IncompleteReadError, asyncio.TimeoutError, ConnectionError):
+            pass
+        except Exception as e:
+            logger.error(f"Error handling client: {e}")
+        finally:
+            await loop.run_in_executor(self.executor, client_handler.close)
+            writer.close()
+            logger.info("Client connection closed")
+
+
+def raise_file_limit():
+    # Every connection holds a descriptor; the default soft limit is often 1024
+    if resource is None:
+        return
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    if hard == resource.RLIM_INFINITY or soft < hard:
+        try:
+            resource.setrlimit(resource.RLIMIT_NOFILE, (hard, hard))
+        except (ValueError, OSError):
+            pass
@@ -0,0 +1,177 @@
+import hashlib
+import os
+import threading
+import uuid
+
+from database_management import FileDBManager
+from log import logger
+from tracing import span
+
+
+BLOBS_DIR = 'blobs'
+SHARD_LEVELS = 2        # Directories between files/blobs and a blob
+SHARD_PREFIX_SIZE = 2   # Hex digits of the hash naming each of them, 256 entries per level
+
+
+class BlobStore:
+    """Content addressed storage for uploaded files.
+
+    Every distinct content is stored once, as files/blobs/ab/cd/<sha256 hex> for a hash starting
+    with "abcd". Hashes spread evenly, so no directory grows past a few hundred entries below
+    billions of blobs and creating or finding one costs the same at any store size. The path
+    is recorded in the blobs and files tables; migrate_store.py moves older layouts into this one.
+
+    The files table keeps one row per (client, name) pointing at its blob, and each blob counts
+    the rows pointing at it; the blob file is deleted when the last row goes. Every change of
+    references is one operation of the database's writer, which runs them in order and commits
+    concurrent uploads together. One store is shared by every handler; its lock only covers
+    putting blob files in place and deleting them, never a database write, and a blob stays in
+    _publishing from its rename until its row is committed, so a concurrent delete leaves it be.
+
+    With a GroupSync a new blob's data and directory entry are on disk before its row is
+    committed, so the database never names content a crash could lose. The sync happens
+    outside the lock, concurrent uploads share its rounds.
+    """
+
+    def __init__(self, files_path, file_db_manager: FileDBManager, group_sync=None):
+        self._blobs_path = os.path.join(files_path, BLOBS_DIR)
+        self._file_db_manager = file_db_manager
+        self._group_sync = group_sync
+        self._lock = threading.Lock()
+        self._published = threading.Condition(self._lock)
+        self._publishing = set()  # Hashes renamed into place whose rows wait for their sync
+        os.makedirs(self._blobs_path, exist_ok=True)
+
+    def blob_path(self, blob_hash):
+        prefixes = [blob_hash[i * SHARD_PREFIX_SIZE:(i + 1) * SHARD_PREFIX_SIZE] for i in range(SHARD_LEVELS)]
+        return os.path.join(self._blobs_path, *prefixes, blob_hash)
+
+    def make_shard(self, path_name):
+        """Creates the directories of a blob path; returns the directories whose entries changed, deepest first."""
+        changed = [os.path.dirname(path_name)]
+        while not os.path.isdir(changed[-1]):
+            changed.append(os.path.dirname(changed[-1]))
+        os.makedirs(changed[0], exist_ok=True)
+        return changed
+
+    def store(self, client_id, file_name, data, checksum, verified=False):
+        """Points (client_id, file_name) at a blob holding data. Returns True if data was new and written."""
+        with span('sha256', bytes=len(data)):
+            blob_hash = hashlib.sha256(data).hexdigest()
+        path_name = self.blob_path(blob_hash)
+
+        # Step 1: Content already stored by anyone only needs a new reference; uploads verified by
+        # hash come without a CRC, the blob may already know it
+        if self.link_stored(client_id, file_name, blob_hash, checksum, verified):
+            return False
+
+        # Step 2: Write new content without holding the lock, other uploads keep going meanwhile;
+        # next to its final name, so the rename only changes one directory
+        changed_directories = self.make_shard(path_name)
+        temp_path = os.path.join(os.path.dirname(path_name), f".{uuid.uuid4().hex}.tmp")
+        with span('blob write', bytes=len(data)), open(temp_path, 'wb') as file:
+            file.write(data)
+
+        # Step 3: Move it into place, unless an identical upload finished first. A blob whose
+        # last reference went since it was looked up is published again after all.
+        while True:
+            with self._lock:
+                while blob_hash in self._publishing:
+                    self._published.wait()
+                if self._file_db_manager.get_blob(blob_hash) is None:
+                    os.replace(temp_path, path_name)
+                    self._publishing.add(blob_hash)
+                    break
+            if self.link_stored(client_id, file_name, blob_hash, checksum, verified):
+                os.remove(temp_path)
+                return False
+
+        # Step 4: Make it durable, then record it; identical uploads wait for the row meanwhile
+        try:
+            if self._group_sync is not None:
+                with span('sync'):
+                    self._group_sync.sync(files=(path_name,), directories=changed_directories)
+            orphan = self._file_db_manager.add_blob(client_id, file_name, blob_hash, path_name, len(data), checksum, verified)
+        except Exception:
+            with self._lock:
+                os.remove(path_name)
+                self._publishing.discard(blob_hash)
+                self._published.notify_all()
+            raise
+        with self._lock:
+            self._publishing.discard(blob_hash)
+            self._published.notify_all()
+        self.delete_orphan(orphan)
+        return True
+
+    def link_existing(self, client_id, file_name, blob_hash, size, any_client=False):
+        """Points (client_id, file_name) at stored content with this SHA-256 and size, without any data.
+
+        Only content the client itself stored counts unless any_client is set: a hash alone proves
+        nothing about holding the data, so cross-client matches would let a client fetch content
+        it merely knows the hash of. The SHA-256 identifies the content by itself, so clients that
+        verify with XXH3 need not compute a CRC. Returns the blob's (path, refcount, size, checksum)
+        row, or None if there is no such content.
+        """
+        blob, orphan = self._file_db_manager.link_blob(client_id, file_name, blob_hash, None, False,
+                                                       size=size, owned_only=not any_client)
+        self.delete_orphan(orphan)
+        return blob
+
+    def adopt(self, client_id, file_name, path_name, blob_hash, size, checksum, verified):
+        """Turns an entry that owns its file at path_name into a reference to the blob with its content.
+
+        The file is hard linked into place rather than copied, and the original name goes once
+        the entry points at the blob, so an interrupted run leaves every entry readable.
+        """
+        target = self.blob_path(blob_hash)
+        while True:
+            if self.link_stored(client_id, file_name, blob_hash, checksum, verified):
+                return False
+            self.make_shard(target)
+            with self._lock:
+                while blob_hash in self._publishing:
+                    self._published.wait()
+                if self._file_db_manager.get_blob(blob_hash) is None:
+                    if os.path.exists(target):
+                        os.remove(target)  # Left by an interrupted run, it was never recorded
+                    os.link(path_name, target)
+                    self._publishing.add(blob_hash)
+                    break
+        try:
+            orphan = self._file_db_manager.add_blob(client_id, file_name, blob_hash, target, size, checksum, verified)
+        finally:
+            with self._lock:
+                self._publishing.discard(blob_hash)
+                self._published.notify_all()
+        self.delete_orphan(orphan)
+        return True
+
+    def link_stored(self, client_id, file_name, blob_hash, checksum, verified):
+        # Points the entry at the blob if it is stored; returns whether it was
+        blob, orphan = self._file_db_manager.link_blob(client_id, file_name, blob_hash, checksum, verified)
+        self.delete_orphan(orphan)
+        return blob is not None
+
+    def remove(self, client_id, file_name):
+        """Deletes the (client_id, file_name) entry, and its blob if nothing else refers to it."""
+        self.delete_orphan(self._file_db_manager.unlink_file(client_id, file_name))
+
+    def delete_orphan(self, orphan):
+        # Deletes a file whose last reference was committed away, see FileDBManager.release_reference.
+        # Entries stored before blobs existed own their file outright.
+        if orphan is None:
+            return
+        blob_hash, path_name = orphan
+        if blob_hash is None:
+            if os.path.exists(path_name):
+                os.remove(path_name)
+            return
+
+        # An identical upload may have put the blob back since; it is then publishing or recorded again
+        with self._lock:
+            if blob_hash in self._publishing or self._file_db_manager.get_blob(blob_hash) is not None:
+                return
+            if os.path.exists(path_name):
+                os.remove(path_name)
+        logger.info(f"Deleted blob {blob_hash}, no file refers to it anymore.")
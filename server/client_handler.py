@@ -1,18 +1,26 @@
 import socket 
 from database_management import ClientDBManager, CLIENT_DB, FileDBManager, FILE_DB
-import threading 
+from blob_store import BlobStore
 import uuid
 import crypto.rsa
 import crypto.aes
 import crypto.checksum
+import crypto.fasthash
 import os
+import zlib
 
 from protocol.requests import RequestCode, RequestHeader, RequestPayload, RegisterPayload, SendKeyPayload, LoginPayload, \
-    SendFilePayload, ChecksumCorrectPayload, ChecksumFailedPayload, ChecksumShutDownPayload, RequestPayloadFactory
+    SendFilePayload, SendPackPayload, SendFileChunkPayload, NegotiateChunksPayload, UploadPrecheckPayload, RequestFileInfoPayload, ReadRangePayload, ChecksumCorrectPayload, ChecksumFailedPayload, ChecksumShutDownPayload, RequestPayloadFactory
 
 from protocol.responses import ResponseCode, ResponseHeader, ResponsePayload, RegisterOkPayload, RegisterFailPayload, \
     AESSendKeyPayload, FileOkPayload, MessageOkPayload, LoginOkSendAesPayload, LoginFailPayload, \
-    GeneralErrorPayload, Packet
+    GeneralErrorPayload, PackOkPayload, PackFailureReason, ChunksBadPayload, ChunkBoundsPayload, ChunkAckPayload, \
+    FileInfoPayload, FileRangePayload, UploadNeededPayload, FileHashOkPayload, Packet
+
+from protocol.pack import parse_pack
+from protocol.framing import FrameReader
+from log import logger, log_packet
+from tracing import span
 
 
 CLIENT_HEADER_SIZE = 23
@@ -20,34 +28,80 @@ CLIENT_ID_SIZE = 16
 CLIENT_VERSION = 3
 SERVER_VERSION = 3
 NAME_SIZE = 255
+MAX_PACK_SIZE = 16 * 1024 * 1024  # Encrypted bytes buffered for one pack of small files
+SERVER_MIN_CHUNK_SIZE = 512
+SERVER_MAX_CHUNK_SIZE = 1024 * 1024  # Largest file chunk frame this server accepts
+MAX_FRAME_SIZE = SERVER_MAX_CHUNK_SIZE + 4 * NAME_SIZE  # Largest payload one frame may announce; a pack arrives in small frames
+UPLOAD_WRITE_BUFFER = 1024 * 1024  # Write buffer of the staging file of an upload
+SERVER_MAX_RANGE_SIZE = 4 * 1024 * 1024  # Largest plaintext range one READ_RANGE may ask for
+INCOMING_DIR = 'incoming'  # Uploads in progress, before their content moves into the blob store
+INSTANT_UPLOAD_ANY_CLIENT = False  # Let UPLOAD_PRECHECK match content stored by other clients, see BlobStore.link_existing
+
+def sanitize_relative_path(file_name):
+    parts = []
+    for part in file_name.replace('\\', '/').split('/'):
+        if part in ('', '.'):
+            continue
+        if part == '..' or ':' in part:
+            raise ValueError(f"Illegal path component in file name: {file_name}")
+        parts.append(part)
+    if not parts:
+        raise ValueError("Empty file name")
+    return '/'.join(parts)
+
 
 class ClientHandler:
-    def __init__(self, client_socket : socket.socket, client_db_manager : ClientDBManager, file_db_manager : FileDBManager, files_path) -> None:
+    def __init__(self, client_socket : socket.socket, client_db_manager : ClientDBManager, file_db_manager : FileDBManager, files_path, blob_store : BlobStore) -> None:
         self._client_socket = client_socket
         self._client_db_manager = client_db_manager
         self._file_db_manager = file_db_manager
         self._files_path = files_path
+        self._blob_store = blob_store
 
-        self._db_lock = threading.Lock()
         self._client_name = ""
         self._file_name = ""
         self._client_id = b""
         self._public_key = b""
         self._aes_key = b""
+        self._frame_reader = FrameReader(client_socket, MAX_FRAME_SIZE)
+        self._pack_buffer = bytearray()
+        self._upload_file = None  # Staging file of the upload in progress, open until it is finalized
+        self._upload_path = ""
+        self._upload_size = 0
+        self._bad_chunks = {}  # offset -> length of chunks that failed their CRC and await a resend
+        self._upload_failed = False
+        self._download_file = None  # Open handle of the file being downloaded, shared by all its ranges
+        self._download_name = ""
+        self._download_size = 0
+        self._hash_algorithm = crypto.fasthash.CKSUM_CRC  # Agreed on in chunk negotiation
 
     def handle(self) -> str:
         try:
-            header_data = self._client_socket.recv(CLIENT_HEADER_SIZE)
-            if not header_data:
+            frame = self.read_frame()
+            if frame is None:
                 return "disconnect"
-            
-            header = RequestHeader.deserialize_header(header_data)
-            print(f"Received header code: {header._code}, payload size: {header._payload_size}")
-            payload_data = self._client_socket.recv(header._payload_size)
-            
+            return self.dispatch(*frame)
+
+        except Exception as e:
+            logger.error(f"Error in client handler: {e}")
+            return "error"
+
+    def read_frame(self):
+        """Reads one request off the socket: (header, payload bytes), or None once the client is gone."""
+        frame = self._frame_reader.read_frame()
+        if frame is not None:
+            header = frame[0]
+            log_packet("Received header code: %d, payload size: %d", header._code, header._payload_size)
+        return frame
+
+    def dispatch(self, header: RequestHeader, payload_data: bytes) -> str:
+        """Handles one complete request; responses go out through self._client_socket."""
+        with span('frame', code=header._code, bytes=len(payload_data)):
+            return self.dispatch_request(header, payload_data)
+
+    def dispatch_request(self, header: RequestHeader, payload_data: bytes) -> str:
+        try:
             payload = RequestPayloadFactory.deserialize_payload(header._code, payload_data)
-            if not payload_data and header._payload_size > 0:
-                return "disconnect"
 
             if header._code == RequestCode.REGISTER.value:  # Registration packet code
                 self.handle_registration(header, payload)
@@ -57,6 +111,18 @@ class ClientHandler:
                 self.handle_login(header, payload)
             elif header._code == RequestCode.SEND_FILE.value:  # Send file packet code
                 self.handle_file_send(header, payload)
+            elif header._code == RequestCode.SEND_PACK.value:  # Send pack packet code
+                self.handle_pack_send(header, payload)
+            elif header._code in (RequestCode.SEND_FILE_CHUNK.value, RequestCode.RESEND_CHUNK.value):  # File chunk packet codes
+                self.handle_chunk_send(header, payload)
+            elif header._code == RequestCode.NEGOTIATE_CHUNKS.value:  # Chunk size negotiation packet code
+                self.handle_negotiate_chunks(header, payload)
+            elif header._code == RequestCode.UPLOAD_PRECHECK.value:  # Upload precheck packet code
+                self.handle_upload_precheck(header, payload)
+            elif header._code == RequestCode.REQUEST_FILE_INFO.value:  # File info packet code
+                self.handle_file_info(header, payload)
+            elif header._code == RequestCode.READ_RANGE.value:  # Read range packet code
+                self.handle_read_range(header, payload)
             elif header._code == RequestCode.CRC_OK.value:  # Checksum correct packet code
                 self.handle_checksum_ok(header, payload)
             elif header._code == RequestCode.CRC_FAIL_TRY_AGAIN.value:  # Checksum failed packet code
@@ -68,16 +134,15 @@ class ClientHandler:
             return "continue"
         
         except Exception as e:
-            print(f"Error in client handler: {e}")
+            logger.error(f"Error in client handler: {e}")
             return "error"
     
     def handle_registration(self, request_header : RequestHeader, request_payload : RegisterPayload):
-        print(f"Attempting to register {request_payload._name}:")
-        with self._db_lock:
-            client_exists = self._client_db_manager.client_exists_by_name(request_payload._name) 
+        logger.info(f"Attempting to register {request_payload._name}:")
+        client_exists = self._client_db_manager.client_exists_by_name(request_payload._name) 
         
         if (client_exists):
-            print(f"Client {request_payload._name} already exists. Registration failed.")
+            logger.warning(f"Client {request_payload._name} already exists. Registration failed.")
             try:
                 response_payload = RegisterFailPayload()
                 response_header = ResponseHeader(version=SERVER_VERSION, response_code=ResponseCode.REGISTER_FAIL, payload_size=0)
@@ -85,82 +150,80 @@ class ClientHandler:
                 self._client_socket.send(response_packet.serialize())        
 
             except Exception as e:
-                print(f"Exception raised in sending failed registration attempt: {e}")
+                logger.error(f"Exception raised in sending failed registration attempt: {e}")
                 self.send_general_error()
 
         else:
             self._client_name = request_payload._name
             self._client_id = uuid.uuid4().bytes
-            print(f"Generated client ID (printed in hex) to send to client: {self._client_id.hex()}")
-            with self._db_lock:
-                try:
-                    self._client_db_manager.create_client_table()
-                    self._client_db_manager.add_or_update_client(self._client_id, self._client_name, self._public_key, self._aes_key)
-                except Exception as e:
-                    print(f"Exception raised trying to add client to database: {e}")
-                    self.send_general_error()
-                    return
+            logger.debug(f"Generated client ID (printed in hex) to send to client: {self._client_id.hex()}")
+            try:
+                self._client_db_manager.create_client_table()
+                self._client_db_manager.add_or_update_client(self._client_id, self._client_name, self._public_key, self._aes_key)
+            except Exception as e:
+                logger.error(f"Exception raised trying to add client to database: {e}")
+                self.send_general_error()
+                return
             
             try:
-                print("Registration OK. Client updated.")
+                logger.info("Registration OK. Client updated.")
                 response_payload = RegisterOkPayload(self._client_id)
                 response_header = ResponseHeader(SERVER_VERSION, ResponseCode.REGISTER_OK, CLIENT_ID_SIZE)
                 response_packet = Packet(response_header, response_payload)
                 self._client_socket.send(response_packet.serialize())
                 return
             except Exception as e:
-                print(f"Exception raised in creation/sending response packet: {e}")
+                logger.error(f"Exception raised in creation/sending response packet: {e}")
                 self.send_general_error()
 
 
     def handle_key_send(self, request_header : RequestHeader, request_payload : SendKeyPayload):
-        print("Setting public key from client payload.")
+        logger.debug("Setting public key from client payload.")
         self._public_key = request_payload._public_key
-        print("Generating AES key.")
+        logger.debug("Generating AES key.")
         self._aes_key = crypto.aes.generate_key()
-        with self._db_lock:
-            try: 
-                print("Updating database with keys")
-                self._client_db_manager.update_client_aes_key(self._client_id, self._aes_key)
-                self._client_db_manager.update_client_public_key(self._client_id, self._public_key)
-            except Exception as e:
-                print(f"Exception raised in handle_key_send database update: {e}")
-                self.send_general_error()
-                return
+        try: 
+            logger.debug("Updating database with keys")
+            self._client_db_manager.update_client_aes_key(self._client_id, self._aes_key)
+            self._client_db_manager.update_client_public_key(self._client_id, self._public_key)
+        except Exception as e:
+            logger.error(f"Exception raised in handle_key_send database update: {e}")
+            self.send_general_error()
+            return
 
         try:
-            print("Sending AES key to user.")
+            logger.debug("Sending AES key to user.")
             encrypted_aes = crypto.rsa.encrypt(self._aes_key, self._public_key)
             response_payload = AESSendKeyPayload(self._client_id, encrypted_aes)
             response_header = ResponseHeader(SERVER_VERSION, ResponseCode.AES_SEND_KEY, CLIENT_ID_SIZE + len(encrypted_aes))
             response_packet = Packet(response_header, response_payload)
             self._client_socket.send(response_packet.serialize())
         except Exception as e:
-            print(f"Exception raised in creating and encrypting aes key: {e}")
+            logger.error(f"Exception raised in creating and encrypting aes key: {e}")
             self.send_general_error()
 
 
     def handle_login(self, request_header : RequestHeader, request_payload : LoginPayload):
-        print(f"Logging in. \nChecking that client by name {request_payload._name} exists:")
+        logger.info(f"Logging in. \nChecking that client by name {request_payload._name} exists:")
         self._client_id = request_header._client_id
-        with self._db_lock:
-            client_exists = self._client_db_manager.client_exists_by_name(request_payload._name) 
+        # A returning client's own row, usually cached, answers the name check without a query
+        client_data = self._client_db_manager.get_client(self._client_id)
+        client_exists = (client_data is not None and client_data[1] == request_payload._name) \
+            or self._client_db_manager.client_exists_by_name(request_payload._name)
 
         if (client_exists):
-            print("Client does exists. Attempting to retreive information from database:")
-            with self._db_lock:
-                client_data = self._client_db_manager.get_client(self._client_id)
-                try: 
-                    self._client_id, self._client_name, self._public_key, last_seen, self._aes_key = client_data
-                    print(f"Data received from database.")
+            logger.debug("Client does exists. Attempting to retreive information from database:")
+            try: 
+                self._client_id, self._client_name, self._public_key, last_seen, self._aes_key = client_data
+                logger.debug(f"Data received from database.")
                 
-                except Exception as e:
-                    print(f"Data could not be loaded from database: {e}")
-                    self.send_general_error()
-                    return
+            except Exception as e:
+                logger.error(f"Data could not be loaded from database: {e}")
+                self.send_general_error()
+                return
             
-                self._aes_key = crypto.aes.generate_key()
-                self._client_db_manager.update_client_aes_key(self._client_id, self._aes_key)
+            self._aes_key = crypto.aes.generate_key()
+            self._client_db_manager.update_client_aes_key(self._client_id, self._aes_key)
             
             try:
                 encrypted_aes = crypto.rsa.encrypt(self._aes_key, self._public_key)
@@ -169,11 +232,11 @@ class ClientHandler:
                 response_packet = Packet(response_header, response_payload)
                 self._client_socket.send(response_packet.serialize())
             except Exception as e:
-                print(f"Login failed: {e}")
+                logger.warning(f"Login failed: {e}")
                 self.send_login_failed()
 
         else:
-            print(f"Login failed: client does not exist in database.")
+            logger.warning(f"Login failed: client does not exist in database.")
             self.send_login_failed()
     
 
@@ -184,86 +247,350 @@ class ClientHandler:
         self._client_socket.send(response_packet.serialize())                
 
 
+    def open_upload(self, file_name):
+        # Directory uploads send paths relative to the upload root; they only name the entry, never a location on disk
+        file_name = sanitize_relative_path(file_name)
+        self.close_upload()
+        self._file_name = file_name
+
+        # The ciphertext is received into a staging file of this upload; finalize_file moves the content
+        # into the blob store and the previous version of the name stays downloadable until then. The
+        # file stays open with a large buffer until then, packets only copy into that buffer
+        incoming_dir = os.path.join(self._files_path, INCOMING_DIR)
+        os.makedirs(incoming_dir, exist_ok=True)  # Create the directory if it doesn't exist
+        self._upload_path = os.path.join(incoming_dir, f"{self._client_id.hex()}-{uuid.uuid4().hex}.part")
+        self._upload_file = open(self._upload_path, 'w+b', buffering=UPLOAD_WRITE_BUFFER)
+
+    def continue_upload(self, file_name):
+        if self._upload_file is None:
+            raise ValueError(f"No upload of {file_name} in progress")
+        if sanitize_relative_path(file_name) != self._file_name:
+            raise ValueError(f"Data for {file_name} while receiving {self._file_name}")
+
+    def flush_upload(self):
+        # Everything received is on disk afterwards; returns its size
+        self._upload_file.flush()
+        return os.fstat(self._upload_file.fileno()).st_size
+
+    def close_upload(self):
+        # Drops the staging file of an upload that was finalized or abandoned
+        if self._upload_file is not None:
+            self._upload_file.close()
+        if self._upload_path and os.path.exists(self._upload_path):
+            os.remove(self._upload_path)
+        self._upload_file = None
+        self._upload_path = ""
+
+    def close(self):
+        """Releases the files this connection still holds open; called once it ends."""
+        self.close_upload()
+        self.close_download()
+
     def handle_file_send(self, header: RequestHeader, payload: SendFilePayload):
         try:
-            # Step 1: Create/Open the directory for the client
-            client_dir = os.path.join(self._files_path, self._client_id.hex())
-            os.makedirs(client_dir, exist_ok=True)  # Create the directory if it doesn't exist
-
-            # make sure that the file name is only the actual name of the file, not a path
-            sanitized_file_name = os.path.basename(payload._file_name)
-            self._file_name = sanitized_file_name
-            file_path = os.path.join(client_dir, self._file_name)
-            
+            # Step 1: The first packet starts the upload's staging file, the others continue it
             if payload._packet_number == 1:
-                with self._db_lock:
-                        print(f"Client ID: {self._client_id.hex()}, file name: {self._file_name}")
-                        print(f"Check if file {self._file_name} already exists: ")
-                        if self._file_db_manager.file_exists(self._client_id, self._file_name):
-                            print("File does exist. Overwriting it.")
-                            # If it exists, delete the old entry and file
-                            
-                            self._file_db_manager.delete_file(self._client_id, self._file_name)
-                            if os.path.exists(file_path):
-                                os.remove(file_path)
-                                print(f"Deleted previous file with same name.")
-                        else:
-                            print(f"{self._file_name} does not exist. Adding it:")
-                
-            # Step 3: Open the file for writing (append mode if it already exists)
-            with open(file_path, 'ab') as file:  # 'ab' mode to append binary data
-                # Step 4: Write the message content to the file
-                file.write(payload._message_content)  # Write the current packet content
+                self.open_upload(payload._file_name)
+            else:
+                self.continue_upload(payload._file_name)
 
-            # Step 5: Check if this is the last packet
+            # Step 2: Append the packet content, it goes to the write buffer of the open file
+            self._upload_file.write(payload._message_content)
+
+            # Step 3: Check if this is the last packet
             if payload._packet_number == payload._total_packets:
-                print(f"Received all packets for file: {self._file_name}") 
-                self.finalize_file(file_path)
+                logger.info(f"Received all packets for file: {self._file_name}")
+                self.finalize_file()
                 # Step 6: Update the file metadata in the database
             else:
-                print(f"Received packet {payload._packet_number} of {payload._total_packets} for file {self._file_name}.")    
+                log_packet("Received packet %d of %d for file %s.", payload._packet_number, payload._total_packets, self._file_name)
             
         except Exception as e:
-            print(f"Exception occurred while handling file send: {e}")
+            logger.error(f"Exception occurred while handling file send: {e}")
+            self.send_general_error()
+
+    def handle_upload_precheck(self, header: RequestHeader, payload: UploadPrecheckPayload):
+        try:
+            self._file_name = sanitize_relative_path(payload._file_name)
+            blob_hash = payload._sha256.hex()
+            blob = self._blob_store.link_existing(self._client_id, self._file_name, blob_hash, payload._file_size,
+                                                  any_client=INSTANT_UPLOAD_ANY_CLIENT)
+            if blob is not None:
+                # Answered like a finished upload with the checksum the content is stored with, 0 if it was
+                # hash-verified; the client confirms with 900 as usual and nothing was transferred
+                logger.info(f"{self._file_name} matches stored content {blob_hash}, linked without an upload.")
+                stored_checksum = blob[3] if blob[3] is not None else 0
+                response_payload = FileOkPayload(self._client_id, 0, self._file_name.ljust(NAME_SIZE, '\0'), stored_checksum)
+                response_header = ResponseHeader(SERVER_VERSION, ResponseCode.FILE_OK, CLIENT_ID_SIZE + NAME_SIZE + 4 + 4)
+                response_packet = Packet(response_header, response_payload)
+                self._client_socket.send(response_packet.serialize())
+                return
+        except Exception as e:
+            logger.error(f"Exception occurred while handling upload precheck: {e}")
+
+        response_payload = UploadNeededPayload(self._client_id)
+        serialized_payload = response_payload.serialize()
+        response_header = ResponseHeader(SERVER_VERSION, ResponseCode.UPLOAD_NEEDED, len(serialized_payload))
+        self._client_socket.send(response_header.serialize() + serialized_payload)
+
+    def handle_negotiate_chunks(self, header: RequestHeader, payload: NegotiateChunksPayload):
+        min_chunk_size = max(payload._min_chunk_size, SERVER_MIN_CHUNK_SIZE)
+        max_chunk_size = min(payload._max_chunk_size, SERVER_MAX_CHUNK_SIZE)
+        if min_chunk_size > max_chunk_size:
+            logger.warning(f"No chunk size both sides support: client {payload._min_chunk_size}-{payload._max_chunk_size}")
             self.send_general_error()
+            return
+
+        hash_algorithm = None
+        if payload._hash_algorithms is not None:
+            hash_algorithm = crypto.fasthash.choose(payload._hash_algorithms)
+            self._hash_algorithm = hash_algorithm
+        logger.info(f"Chunk sizes negotiated: {min_chunk_size} to {max_chunk_size} bytes, files verified with "
+                    f"{crypto.fasthash.NAMES[self._hash_algorithm]}.")
+        response_payload = ChunkBoundsPayload(self._client_id, min_chunk_size, max_chunk_size, hash_algorithm)
+        serialized_payload = response_payload.serialize()
+        response_header = ResponseHeader(SERVER_VERSION, ResponseCode.CHUNK_BOUNDS, len(serialized_payload))
+        self._client_socket.send(response_header.serialize() + serialized_payload)
+
+    def handle_chunk_send(self, header: RequestHeader, payload: SendFileChunkPayload):
+        # Acknowledge on receipt so the client measures the round trip, not our disk; this also
+        # keeps the acknowledgement ahead of the response to a last frame
+        if payload._ack_requested:
+            response_payload = ChunkAckPayload(self._client_id, payload._offset)
+            serialized_payload = response_payload.serialize()
+            response_header = ResponseHeader(SERVER_VERSION, ResponseCode.CHUNK_ACK, len(serialized_payload))
+            self._client_socket.send(response_header.serialize() + serialized_payload)
+
+        try:
+            # Step 1: A first pass starting at offset 0 begins a new upload, anything else continues it
+            if header._code == RequestCode.SEND_FILE_CHUNK.value and payload._offset == 0:
+                self.open_upload(payload._file_name)
+                self._upload_size = payload._encrypted_size
+                self._bad_chunks = {}
+                self._upload_failed = False
+            else:
+                if self._upload_failed:
+                    raise ValueError("Upload already failed")
+                self.continue_upload(payload._file_name)
+
+            content = payload._message_content
+            if len(content) > SERVER_MAX_CHUNK_SIZE:
+                raise ValueError(f"Chunk of {len(content)} bytes is larger than {SERVER_MAX_CHUNK_SIZE}")
+            if payload._offset + len(content) > self._upload_size:
+                raise ValueError(f"Chunk at {payload._offset} runs past the end of {self._file_name}")
+
+            # Step 2: Write the chunk in place if its CRC matches, otherwise remember it for a resend
+            with span('chunk crc', bytes=len(content)):
+                chunk_intact = zlib.crc32(content) == payload._chunk_checksum
+            if chunk_intact:
+                # Chunks of a first pass arrive in order; seeking would flush the write buffer
+                if self._upload_file.tell() != payload._offset:
+                    self._upload_file.seek(payload._offset)
+                with span('write', bytes=len(content)):
+                    self._upload_file.write(content)
+                self._bad_chunks.pop(payload._offset, None)
+            else:
+                logger.warning(f"Chunk at offset {payload._offset} of {self._file_name} failed its checksum.")
+                self._bad_chunks[payload._offset] = len(content)
+
+            if not payload._last:
+                return
+
+            # Step 3: At the end of a pass, ask for the bad chunks or verify the whole file
+            if self._bad_chunks:
+                logger.warning(f"Requesting {len(self._bad_chunks)} corrupted chunks of {self._file_name} again.")
+                response_payload = ChunksBadPayload(self._client_id, sorted(self._bad_chunks.items()))
+                serialized_payload = response_payload.serialize()
+                response_header = ResponseHeader(SERVER_VERSION, ResponseCode.CHUNKS_BAD, len(serialized_payload))
+                self._client_socket.send(response_header.serialize() + serialized_payload)
+                return
 
-    def finalize_file(self, file_path):
+            if self.flush_upload() != self._upload_size:
+                raise ValueError(f"{self._file_name} is incomplete")
+            logger.info(f"Received all chunks for file: {self._file_name}")
+            self.finalize_file()
+
+        except Exception as e:
+            logger.error(f"Exception occurred while handling file chunk: {e}")
+            # Answer once per pass, the client only reads a response after its last frame
+            self._upload_failed = True
+            if payload._last:
+                self._upload_failed = False
+                self.send_general_error()
+
+    def finalize_file(self):
         try:
-            with self._db_lock:
-                self._file_db_manager.add_file(self._client_id, self._file_name, file_path, verified=False)
-            print(f"File {self._file_name} has been successfully saved and added to the database.")
-                    
-                # Step 7: Decrypt the entire file
-            with open(file_path, 'rb') as file:
-                encrypted_data = file.read()
-            print(f"Decrypting data for: {self._file_name}")
-            decrypted_data = crypto.aes.decrypt(encrypted_data, self._aes_key)
-
-                # Step 8: Write the decrypted data back to the file or another file as needed
-            print("Writing decrypted data back to file.")
-            with open(file_path, 'wb') as file:  # Overwrite the file with decrypted data
-                file.write(decrypted_data)
-
-                # Step 9: Calculate checksum
-            print("Calculating checksum.")
-            checksum_info = crypto.checksum.readfile(file_path)
-            checksum_str, content_size_str, filename = checksum_info.split('\t')
-
-                # Convert the values from string to integers
-            checksum = int(checksum_str)  # Convert checksum to int
+                # Step 7: Decrypt the entire file, read back through the handle it was written with
+            with span('read back', bytes=self._upload_size):
+                self._upload_file.flush()
+                self._upload_file.seek(0)
+                encrypted_data = self._upload_file.read()
+            logger.debug(f"Decrypting data for: {self._file_name}")
+            with span('decrypt', bytes=len(encrypted_data)):
+                decrypted_data = crypto.aes.decrypt(encrypted_data, self._aes_key)
+
+                # Step 8: Calculate checksum, on the decrypted data still in memory; with an agreed hash
+                # the CRC is skipped, downloads compute it on first use
             content_size = len(encrypted_data)  # Convert content size to int
-                
+            if self._hash_algorithm == crypto.fasthash.XXH3_64:
+                logger.debug("Calculating hash.")
+                checksum = None
+                with span('xxh3', bytes=len(decrypted_data)):
+                    file_hash = crypto.fasthash.xxh3_64(decrypted_data)
+            else:
+                logger.debug("Calculating checksum.")
+                with span('crc', bytes=len(decrypted_data)):
+                    checksum = crypto.checksum.memcrc(decrypted_data)
+
+                # Step 9: Store the content once; a copy any client already uploaded is only referenced
+            with span('store', bytes=len(decrypted_data)):
+                stored = self._blob_store.store(self._client_id, self._file_name, decrypted_data, checksum)
+            if stored:
+                logger.info(f"File {self._file_name} has been successfully saved and added to the database.")
+            else:
+                logger.info(f"File {self._file_name} is identical to stored content, added to the database without writing it.")
+            self.close_upload()
+
+            if checksum is None:
+                response_payload = FileHashOkPayload(self._client_id, content_size, self._file_name.ljust(NAME_SIZE, '\0'),
+                                                     self._hash_algorithm, file_hash)
+                serialized_payload = response_payload.serialize()
+                response_header = ResponseHeader(SERVER_VERSION, ResponseCode.FILE_HASH_OK, len(serialized_payload))
+                self._client_socket.send(response_header.serialize() + serialized_payload)
+                return
+
             response_payload = FileOkPayload(self._client_id, content_size, self._file_name.ljust(NAME_SIZE, '\0'), checksum)
             response_header = ResponseHeader(SERVER_VERSION, ResponseCode.FILE_OK, CLIENT_ID_SIZE + NAME_SIZE + 4 + 4)
             response_packet = Packet(response_header, response_payload)
             self._client_socket.send(response_packet.serialize())
 
         except Exception as e:
-            print(f"Exception occurred while finalizing file: {e}")
+            logger.error(f"Exception occurred while finalizing file: {e}")
+            self.close_upload()
+            self.send_general_error()
+
+    def handle_pack_send(self, header: RequestHeader, payload: SendPackPayload):
+        try:
+            # Step 1: Collect the encrypted pack, it is small enough to keep in memory
+            if payload._packet_number == 1:
+                self._pack_buffer = bytearray()
+            self._pack_buffer += payload._message_content
+            if len(self._pack_buffer) > MAX_PACK_SIZE:
+                self._pack_buffer = bytearray()
+                raise ValueError(f"Pack larger than {MAX_PACK_SIZE} bytes")
+
+            if payload._packet_number != payload._total_packets:
+                return
+
+            # Step 2: Decrypt and split it back into files
+            logger.info(f"Received pack of {payload._entry_count} files.")
+            decrypted_data = crypto.aes.decrypt(bytes(self._pack_buffer), self._aes_key)
+            self._pack_buffer = bytearray()
+            entries = parse_pack(decrypted_data, payload._entry_count)
+
+            # Step 3: Store every entry whose checksum matches; each failure is reported, not fatal
+            stored_count = 0
+            failures = []
+            for entry in entries:
+                try:
+                    file_name = sanitize_relative_path(entry._name)
+                except ValueError:
+                    failures.append((entry._name, PackFailureReason.INVALID_NAME))
+                    continue
+
+                if crypto.checksum.memcrc(entry._content) != entry._checksum:
+                    failures.append((entry._name, PackFailureReason.CHECKSUM_MISMATCH))
+                    continue
+
+                try:
+                    # The checksum was already verified against the client's, so the entry is verified
+                    self._blob_store.store(self._client_id, file_name, entry._content, entry._checksum, verified=True)
+                    stored_count += 1
+                except Exception as e:
+                    logger.warning(f"Failed to store {file_name} from pack: {e}")
+                    failures.append((entry._name, PackFailureReason.STORAGE_ERROR))
+
+            logger.info(f"Stored {stored_count} files from pack, {len(failures)} failed.")
+            response_payload = PackOkPayload(self._client_id, stored_count, failures)
+            serialized_payload = response_payload.serialize()
+            response_header = ResponseHeader(SERVER_VERSION, ResponseCode.PACK_OK, len(serialized_payload))
+            self._client_socket.send(response_header.serialize() + serialized_payload)
+
+        except Exception as e:
+            logger.error(f"Exception occurred while handling pack send: {e}")
+            self._pack_buffer = bytearray()
+            self.send_general_error()
+
+    def open_download(self, file_name):
+        # Every range of a file is read through one handle, reopened only when the client moves to another file
+        file_name = sanitize_relative_path(file_name)
+        if self._download_file is not None and self._download_name == file_name:
+            return
+        self.close_download()
+
+        row = self._file_db_manager.get_file(self._client_id, file_name)
+        if row is None or not row[1]:
+            raise ValueError(f"No verified file named {file_name}")
+        path_name = row[0]
+
+        self._download_file = open(path_name, 'rb')
+        self._download_name = file_name
+        self._download_size = os.fstat(self._download_file.fileno()).st_size
+
+    def close_download(self):
+        if self._download_file is not None:
+            self._download_file.close()
+        self._download_file = None
+        self._download_name = ""
+        self._download_size = 0
+
+    def handle_file_info(self, header: RequestHeader, payload: RequestFileInfoPayload):
+        try:
+            self.open_download(payload._file_name)
+            path_name, verified, checksum = self._file_db_manager.get_file(self._client_id, self._download_name)
+            if checksum is None:
+                # Stored before checksums were recorded; compute it once and keep it
+                checksum = crypto.checksum.file_crc(path_name)
+                self._file_db_manager.add_file(self._client_id, self._download_name, path_name, verified=bool(verified), checksum=checksum)
+
+            logger.info(f"Sending info for download of {self._download_name}: {self._download_size} bytes.")
+            response_payload = FileInfoPayload(self._client_id, self._download_size, checksum)
+            serialized_payload = response_payload.serialize()
+            response_header = ResponseHeader(SERVER_VERSION, ResponseCode.FILE_INFO, len(serialized_payload))
+            self._client_socket.send(response_header.serialize() + serialized_payload)
+
+        except Exception as e:
+            logger.error(f"Exception occurred while handling file info request: {e}")
+            self.close_download()
+            self.send_general_error()
+
+    def handle_read_range(self, header: RequestHeader, payload: ReadRangePayload):
+        try:
+            self.open_download(payload._file_name)
+            if payload._length == 0 or payload._length > SERVER_MAX_RANGE_SIZE:
+                raise ValueError(f"Range of {payload._length} bytes is outside 1 to {SERVER_MAX_RANGE_SIZE}")
+            if payload._offset + payload._length > self._download_size:
+                raise ValueError(f"Range at {payload._offset} runs past the end of {self._download_name}")
+
+            # Each range is encrypted on its own, so the client can decrypt ranges in any order
+            self._download_file.seek(payload._offset)
+            data = self._download_file.read(payload._length)
+            if len(data) != payload._length:
+                raise ValueError(f"{self._download_name} shrank while being downloaded")
+            encrypted_data = crypto.aes.encrypt(data, self._aes_key)
+
+            response_payload = FileRangePayload(self._client_id, payload._offset, payload._length, encrypted_data)
+            serialized_payload = response_payload.serialize()
+            response_header = ResponseHeader(SERVER_VERSION, ResponseCode.FILE_RANGE, len(serialized_payload))
+            # Ranges are megabytes, send may write only part of them
+            self._client_socket.sendall(response_header.serialize() + serialized_payload)
+
+        except Exception as e:
+            logger.error(f"Exception occurred while handling read range request: {e}")
             self.send_general_error()
 
     def handle_checksum_ok(self, header : RequestHeader, payload : ChecksumCorrectPayload):
-        print("Checksum was correct - file validated.")
+        logger.info("Checksum was correct - file validated.")
         response_payload = MessageOkPayload(self._client_id)
         response_header = ResponseHeader(SERVER_VERSION, ResponseCode.MESSAGE_OK, CLIENT_ID_SIZE)
         response_packet = Packet(response_header, response_payload)
@@ -273,27 +600,15 @@ class ClientHandler:
 
 
     def handle_checksum_fail(self, header : RequestHeader, payload : ChecksumFailedPayload):
-        print("Checksum was incorrect - deleting and trying again.")
-        client_dir = os.path.join(self._files_path, self._client_id.hex())
-        file_path = os.path.join(client_dir, self._file_name)
-        
-        if self._file_db_manager.file_exists(self._client_id, self._file_name):
-            self._file_db_manager.delete_file(self._client_id, self._file_name)
-            if os.path.exists(file_path):
-                os.remove(file_path)
-                print(f"Deleted file entry {self._file_name}.")
+        logger.warning("Checksum was incorrect - deleting and trying again.")
+        self._blob_store.remove(self._client_id, self._file_name)
+        logger.info(f"Deleted file entry {self._file_name}.")
 
 
     def handle_checksum_shutdown(self, header : RequestHeader, payload : ChecksumShutDownPayload):
-        print("Checksum was incorrect - deleting and shutting down.")
-        client_dir = os.path.join(self._files_path, self._client_id.hex())
-        file_path = os.path.join(client_dir, self._file_name)
-        
-        if self._file_db_manager.file_exists(self._client_id, self._file_name):            
-            self._file_db_manager.delete_file(self._client_id, self._file_name)
-            if os.path.exists(file_path):
-                os.remove(file_path)
-                print(f"Deleted file entry {self._file_name}.")
+        logger.warning("Checksum was incorrect - deleting and shutting down.")
+        self._blob_store.remove(self._client_id, self._file_name)
+        logger.info(f"Deleted file entry {self._file_name}.")
         response_payload = MessageOkPayload(self._client_id)
         response_header = ResponseHeader(SERVER_VERSION, ResponseCode.MESSAGE_OK, CLIENT_ID_SIZE)
         response_packet = Packet(response_header, response_payload)
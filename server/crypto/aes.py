@@ -1,17 +1,29 @@
 import random
 
 from Crypto.Cipher import AES
-from Crypto.Util.Padding import unpad
+from Crypto.Util.Padding import pad, unpad
+
+try:
+    from crypto import _native  # Built by setup.py; decrypts with the GIL released
+except ImportError:
+    _native = None
 
 
 DEFAULT_KEY_SIZE = 256 // 8
 
 
 def decrypt(data: bytes, key: bytes) -> bytes:
+    if _native is not None:
+        return _native.aes_cbc_decrypt(data, key)
     cipher = AES.new(key, AES.MODE_CBC, iv=bytes([0] * AES.block_size))
     decrypted_data = cipher.decrypt(data)
     return unpad(decrypted_data, AES.block_size)
 
 
+def encrypt(data: bytes, key: bytes) -> bytes:
+    cipher = AES.new(key, AES.MODE_CBC, iv=bytes([0] * AES.block_size))
+    return cipher.encrypt(pad(data, AES.block_size))
+
+
 def generate_key() -> bytes:
     return random.Random().randbytes(DEFAULT_KEY_SIZE)
\ No newline at end of file
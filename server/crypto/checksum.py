@@ -3,9 +3,19 @@ This module implements the cksum command found in most UNIXes in pure
 python.
 
 The constants and routine are cribbed from the POSIX man page
+
+When crypto._native is built (see setup.py) the same CRC runs in C++ with the GIL released;
+the Python loops below remain the fallback.
 """
 import sys
 
+try:
+    from crypto import _native
+except ImportError:
+    _native = None
+
+FILE_BLOCK_SIZE = 1024 * 1024
+
 crctab = [ 0x00000000, 0x04c11db7, 0x09823b6e, 0x0d4326d9, 0x130476dc,
         0x17c56b6b, 0x1a864db2, 0x1e475005, 0x2608edb8, 0x22c9f00f,
         0x2f8ad6d6, 0x2b4bcb61, 0x350c9b64, 0x31cd86d3, 0x3c8ea00a,
@@ -61,19 +71,39 @@ crctab = [ 0x00000000, 0x04c11db7, 0x09823b6e, 0x0d4326d9, 0x130476dc,
 
 UNSIGNED = lambda n: n & 0xffffffff
 
-def memcrc(b):
-    n = len(b)
-    i = c = s = 0
+def crc_update(s, b):
+    """Streaming form of memcrc: start from 0, feed every block, then call crc_final with the total length."""
+    if _native is not None:
+        return _native.crc_update(s, b)
     for ch in b:
         tabidx = (s>>24)^ch
         s = UNSIGNED((s << 8)) ^ crctab[tabidx]
+    return s
 
+def crc_final(s, n):
+    if _native is not None:
+        return _native.crc_final(s, n)
+    c = 0
     while n:
         c = n & 0o377
         n = n >> 8
         s = UNSIGNED(s << 8) ^ crctab[(s >> 24) ^ c]
     return UNSIGNED(~s)
 
+def memcrc(b):
+    if _native is not None:
+        return _native.memcrc(b)
+    return crc_final(crc_update(0, b), len(b))
+
+def file_crc(fname):
+    """memcrc of a file, read a block at a time instead of all at once."""
+    s = n = 0
+    with open(fname, 'rb') as file:
+        while block := file.read(FILE_BLOCK_SIZE):
+            s = crc_update(s, block)
+            n += len(block)
+    return crc_final(s, n)
+
 def readfile(fname):
     try:
         buffer = open(fname, 'rb').read()
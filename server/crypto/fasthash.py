@@ -0,0 +1,37 @@
+"""
+Whole-file hashes a connection can verify uploads with instead of the cksum CRC.
+
+XXH3-64 comes from the xxhash package, a binding of the reference C implementation with
+its SIMD code paths. Without it installed the server offers only the CRC, which every
+client understands.
+"""
+try:
+    import xxhash
+except ImportError:
+    xxhash = None
+
+
+CKSUM_CRC = 0
+XXH3_64 = 1
+
+NAMES = {CKSUM_CRC: 'cksum CRC', XXH3_64: 'XXH3-64'}
+
+
+def supported_algorithms():
+    algorithms = [CKSUM_CRC]
+    if xxhash is not None:
+        algorithms.append(XXH3_64)
+    return algorithms
+
+
+def choose(offered):
+    """First algorithm of the client's preference list this server supports, the CRC if none."""
+    supported = supported_algorithms()
+    for algorithm in offered:
+        if algorithm in supported:
+            return algorithm
+    return CKSUM_CRC
+
+
+def xxh3_64(data: bytes) -> int:
+    return xxhash.xxh3_64_intdigest(data)
@@ -1,17 +1,198 @@
+import queue
 import sqlite3
+import threading
+import time
+from collections import OrderedDict
+from concurrent.futures import Future
 from datetime import datetime
 
+from tracing import span
+
 # Database filenames
 CLIENT_DB = 'client_database.db'
 FILE_DB = 'file_database.db'
 
+DB_BUSY_TIMEOUT = 30.0     # Seconds a statement waits for another connection's write transaction
+CLIENT_CACHE_SIZE = 10000  # Client rows kept in memory for logins
+CLIENT_VERSION_STRIPES = 1024  # Change counters the client IDs hash into, see ClientCache
+DB_BATCH_WINDOW = 0        # Seconds the writer lingers for more operations; at 0 a batch is what queued during the last commit
+DB_BATCH_MAX = 256         # Operations committed together at most
+
+_connections = threading.local()
+
+def connect(db_path):
+    """Returns the calling thread's connection to db_path, opened on its first use and kept after.
+
+    Used as "with connect(path) as conn:", which commits or rolls back without closing. Every
+    connection runs in WAL mode, so readers never wait for the writer. A thread that serves one
+    client connection calls close_connections() when it ends; the async server's bounded pool
+    keeps its threads' connections for good.
+    """
+    connections = getattr(_connections, 'by_path', None)
+    if connections is None:
+        connections = _connections.by_path = {}
+    conn = connections.get(db_path)
+    if conn is None:
+        conn = connections[db_path] = open_connection(db_path)
+    return conn
+
+def close_connections():
+    """Closes every connection the calling thread opened through connect()."""
+    connections = getattr(_connections, 'by_path', None)
+    if connections is None:
+        return
+    for conn in connections.values():
+        conn.close()
+    connections.clear()
+
+def open_connection(db_path, durable=False, **kwargs):
+    conn = sqlite3.connect(db_path, timeout=DB_BUSY_TIMEOUT, **kwargs)
+    conn.execute('PRAGMA journal_mode=WAL')
+    # WAL stays consistent on a crash either way; without FULL a power loss may drop the last commits
+    conn.execute('PRAGMA synchronous=FULL' if durable else 'PRAGMA synchronous=NORMAL')
+    return conn
+
+
+class DBWriter:
+    """The one thread that writes to a database.
+
+    Write methods of the managers hand it their statements as a function of a cursor and block
+    until it returns. The thread takes whatever is queued, waiting up to DB_BATCH_WINDOW for more,
+    and runs it all in one transaction: concurrent uploads share a commit instead of fighting
+    over SQLite's write lock. Every operation runs in its own savepoint, so one that fails is
+    rolled back and raised to its caller alone. Reads stay on the callers' own connections and
+    see a write as soon as its call returned. A durable writer fsyncs every commit, which the
+    batching then pays for once per batch.
+    """
+
+    def __init__(self, db_path, durable=False):
+        self._db_path = db_path
+        self._durable = durable
+        self._queue = queue.Queue()
+        self._thread = threading.Thread(target=self.run, name=f"db-writer {db_path}", daemon=True)
+        self._thread.start()
+
+    def execute(self, operation):
+        """Runs operation(cursor) in the writer's next transaction; returns its result once committed."""
+        future = Future()
+        with span('db write'):  # Queued, then committed with whatever else the writer took
+            self._queue.put((operation, future))
+            return future.result()
+
+    def next_batch(self):
+        batch = [self._queue.get()]
+        deadline = time.monotonic() + DB_BATCH_WINDOW
+        while len(batch) < DB_BATCH_MAX:
+            timeout = deadline - time.monotonic()
+            try:
+                batch.append(self._queue.get(timeout=timeout) if timeout > 0 else self._queue.get_nowait())
+            except queue.Empty:
+                break
+        return batch
+
+    def run(self):
+        conn = open_connection(self._db_path, self._durable, isolation_level=None)  # Transactions are begun and committed here
+        cursor = conn.cursor()
+        while True:
+            batch = self.next_batch()
+            results = []
+            try:
+                with span('db batch', operations=len(batch)):
+                    cursor.execute('BEGIN IMMEDIATE')
+                    for operation, future in batch:
+                        cursor.execute('SAVEPOINT operation')
+                        try:
+                            results.append((future, operation(cursor), None))
+                            cursor.execute('RELEASE operation')
+                        except Exception as e:
+                            cursor.execute('ROLLBACK TO operation')
+                            cursor.execute('RELEASE operation')
+                            results.append((future, None, e))
+                    cursor.execute('COMMIT')
+            except Exception as e:
+                # Nothing of the batch was stored
+                if conn.in_transaction:
+                    cursor.execute('ROLLBACK')
+                for _, future in batch:
+                    future.set_exception(e)
+                continue
+
+            for future, result, error in results:
+                if error is None:
+                    future.set_result(result)
+                else:
+                    future.set_exception(error)
+
+
+class ClientCache:
+    """Least recently used client rows by client ID, shared by all connections.
+
+    Every change to a client bumps a version, one of CLIENT_VERSION_STRIPES its ID hashes to. A
+    row read from the database is only cached if no change landed since the reader took the
+    version, so a read that raced a write never puts the old row back after the writer updated or
+    dropped it. Writes never hold the lock while they wait for the database.
+    """
+
+    def __init__(self, capacity=CLIENT_CACHE_SIZE):
+        self._capacity = capacity
+        self._rows = OrderedDict()
+        self._versions = [0] * CLIENT_VERSION_STRIPES
+        self._lock = threading.Lock()
+
+    def _stripe(self, client_id):
+        return hash(bytes(client_id)) % CLIENT_VERSION_STRIPES
+
+    def version(self, client_id):
+        with self._lock:
+            return self._versions[self._stripe(client_id)]
+
+    def get(self, client_id):
+        with self._lock:
+            row = self._rows.get(bytes(client_id))
+            if row is not None:
+                self._rows.move_to_end(bytes(client_id))
+            return row
+
+    def put(self, client_id, row, version):
+        with self._lock:
+            if version != self._versions[self._stripe(client_id)]:
+                return
+            self._rows[bytes(client_id)] = row
+            self._rows.move_to_end(bytes(client_id))
+            if len(self._rows) > self._capacity:
+                self._rows.popitem(last=False)
+
+    def discard(self, client_id):
+        with self._lock:
+            self._versions[self._stripe(client_id)] += 1
+            self._rows.pop(bytes(client_id), None)
+
+    def update(self, client_id, version, **fields):
+        # Changes the cached row in place, if there is one; the columns follow the clients table.
+        # Another change since version may have committed in either order, so the row is dropped.
+        with self._lock:
+            stripe = self._stripe(client_id)
+            if version != self._versions[stripe]:
+                self._versions[stripe] += 1
+                self._rows.pop(bytes(client_id), None)
+                return
+            self._versions[stripe] += 1
+            row = self._rows.get(bytes(client_id))
+            if row is None:
+                return
+            columns = dict(zip(('client_id', 'client_name', 'public_key', 'last_seen', 'aes_key'), row))
+            columns.update(fields)
+            self._rows[bytes(client_id)] = tuple(columns.values())
+
 class ClientDBManager:
-    def __init__(self, db_path=CLIENT_DB):
+    def __init__(self, db_path=CLIENT_DB, durable=False):
         self.db_path = db_path
+        self.cache = ClientCache()
+        self._writer = DBWriter(db_path, durable)
         self.create_client_table()
 
     def create_client_table(self):
-        with sqlite3.connect(self.db_path) as conn:
+        with connect(self.db_path) as conn:
             cursor = conn.cursor()
             cursor.execute('''
                 CREATE TABLE IF NOT EXISTS clients (
@@ -22,18 +203,18 @@ class ClientDBManager:
                     aes_key BLOB
                 )
             ''')
+            cursor.execute('CREATE INDEX IF NOT EXISTS clients_by_name ON clients (client_name)')
             conn.commit()
 
     def client_exists_by_name(self, client_name):
-        with sqlite3.connect(self.db_path) as conn:
+        with connect(self.db_path) as conn:
             cursor = conn.cursor()
             cursor.execute('SELECT 1 FROM clients WHERE client_name = ?', (client_name,))
             result = cursor.fetchone()
             return result is not None
 
     def add_or_update_client(self, client_id, client_name, public_key, aes_key):
-        with sqlite3.connect(self.db_path) as conn:
-            cursor = conn.cursor()
+        def write(cursor):
             cursor.execute('''
                 INSERT INTO clients (client_id, client_name, public_key, last_seen, aes_key)
                 VALUES (?, ?, ?, ?, ?)
@@ -44,51 +225,67 @@ class ClientDBManager:
                     last_seen=excluded.last_seen, 
                     aes_key=excluded.aes_key;
             ''', (sqlite3.Binary(client_id), client_name, public_key, datetime.now(), aes_key))
-            conn.commit()
+
+        self._writer.execute(write)
+        self.cache.discard(client_id)
 
     def update_client_last_seen(self, client_id):
-        with sqlite3.connect(self.db_path) as conn:
-            cursor = conn.cursor()
+        def write(cursor):
             cursor.execute('''
                 UPDATE clients
                 SET last_seen = ?
                 WHERE client_id = ?;
             ''', (datetime.now(), sqlite3.Binary(client_id)))
-            conn.commit()
+
+        self._writer.execute(write)
+        self.cache.discard(client_id)
 
     def update_client_public_key(self, client_id, public_key):
-        with sqlite3.connect(self.db_path) as conn:
-            cursor = conn.cursor()
+        def write(cursor):
             cursor.execute('''
                 UPDATE clients
                 SET public_key = ?
                 WHERE client_id = ?;
             ''', (public_key, sqlite3.Binary(client_id)))
-            conn.commit()
+
+        version = self.cache.version(client_id)
+        self._writer.execute(write)
+        self.cache.update(client_id, version, public_key=public_key)
 
     def update_client_aes_key(self, client_id, aes_key):
-        with sqlite3.connect(self.db_path) as conn:
-            cursor = conn.cursor()
+        def write(cursor):
             cursor.execute('''
                 UPDATE clients
                 SET aes_key = ?
                 WHERE client_id = ?;
             ''', (aes_key, sqlite3.Binary(client_id)))
-            conn.commit()
+
+        version = self.cache.version(client_id)
+        self._writer.execute(write)
+        self.cache.update(client_id, version, aes_key=aes_key)
 
     def get_client(self, client_id):
-        with sqlite3.connect(self.db_path) as conn:
+        # Served from the cache when the client was seen recently; every write above keeps it current
+        row = self.cache.get(client_id)
+        if row is not None:
+            return row
+        version = self.cache.version(client_id)
+        with connect(self.db_path) as conn:
             cursor = conn.cursor()
             cursor.execute('SELECT * FROM clients WHERE client_id = ?', (sqlite3.Binary(client_id),))
-            return cursor.fetchone()
+            row = cursor.fetchone()
+        if row is not None:
+            self.cache.put(client_id, row, version)
+        return row
 
 class FileDBManager:
-    def __init__(self, db_path=FILE_DB):
+    def __init__(self, db_path=FILE_DB, durable=False):
         self.db_path = db_path
+        self._writer = DBWriter(db_path, durable)
         self.create_file_table()
 
     def create_file_table(self):
-        with sqlite3.connect(self.db_path) as conn:
+        with connect(self.db_path) as conn:
             cursor = conn.cursor()
             cursor.execute('''
                 CREATE TABLE IF NOT EXISTS files (
@@ -96,53 +293,177 @@ class FileDBManager:
                     file_name TEXT, 
                     path_name TEXT, 
                     verified INTEGER, 
+                    checksum INTEGER,
                     PRIMARY KEY (client_id, file_name)
                 )
             ''')
+            # Databases created before downloads and blobs existed lack these columns
+            columns = [row[1] for row in cursor.execute('PRAGMA table_info(files)')]
+            if 'checksum' not in columns:
+                cursor.execute('ALTER TABLE files ADD COLUMN checksum INTEGER')
+            if 'blob_hash' not in columns:
+                cursor.execute('ALTER TABLE files ADD COLUMN blob_hash TEXT')
+            cursor.execute('''
+                CREATE TABLE IF NOT EXISTS blobs (
+                    blob_hash TEXT PRIMARY KEY,
+                    path_name TEXT,
+                    size INTEGER,
+                    checksum INTEGER,
+                    ref_count INTEGER
+                )
+            ''')
             conn.commit()
 
-    def add_file(self, client_id, file_name, path_name, verified=False):
-        with sqlite3.connect(self.db_path) as conn:
-            cursor = conn.cursor()
+    def add_file(self, client_id, file_name, path_name, verified=False, checksum=None):
+        def write(cursor):
             cursor.execute('''
-                INSERT INTO files (client_id, file_name, path_name, verified)
-                VALUES (?, ?, ?, ?)
+                INSERT INTO files (client_id, file_name, path_name, verified, checksum)
+                VALUES (?, ?, ?, ?, ?)
                 ON CONFLICT(client_id, file_name)
                 DO UPDATE SET
                     path_name=excluded.path_name,
-                    verified=excluded.verified;
-            ''', (sqlite3.Binary(client_id), file_name, path_name, int(verified)))
-            conn.commit()
+                    verified=excluded.verified,
+                    checksum=excluded.checksum;
+            ''', (sqlite3.Binary(client_id), file_name, path_name, int(verified), checksum))
+        return self._writer.execute(write)
 
 
     def update_file_verification(self, client_id, file_name, verified):
-        with sqlite3.connect(self.db_path) as conn:
-            cursor = conn.cursor()
+        def write(cursor):
             cursor.execute('''
                 UPDATE files
                 SET verified = ?
                 WHERE client_id = ? AND file_name = ?;
             ''', (int(verified), sqlite3.Binary(client_id), file_name))
-            conn.commit()
+        return self._writer.execute(write)
 
     def get_files_by_client(self, client_id):
-        with sqlite3.connect(self.db_path) as conn:
+        with connect(self.db_path) as conn:
             cursor = conn.cursor()
             cursor.execute('SELECT * FROM files WHERE client_id = ?', (sqlite3.Binary(client_id),))
             return cursor.fetchall()
     
+    def get_file(self, client_id, file_name):
+        with connect(self.db_path) as conn:
+            cursor = conn.cursor()
+            cursor.execute('''
+                SELECT path_name, verified, checksum FROM files
+                WHERE client_id = ? AND file_name = ?
+            ''', (sqlite3.Binary(client_id), file_name))
+            return cursor.fetchone()
+
     def file_exists(self, client_id, file_name):
-        with sqlite3.connect(self.db_path) as conn:
+        with connect(self.db_path) as conn:
             cursor = conn.cursor()
             cursor.execute('SELECT 1 FROM files WHERE client_id = ? AND file_name = ?', (sqlite3.Binary(client_id), file_name))
             return cursor.fetchone() is not None
 
 
-    def delete_file(self, client_id, file_name):
-        with sqlite3.connect(self.db_path) as conn:
+    def get_blob(self, blob_hash):
+        with connect(self.db_path) as conn:
             cursor = conn.cursor()
+            cursor.execute('SELECT path_name, ref_count, size, checksum FROM blobs WHERE blob_hash = ?', (blob_hash,))
+            return cursor.fetchone()
+
+    def get_blobs(self):
+        with connect(self.db_path) as conn:
+            cursor = conn.cursor()
+            cursor.execute('SELECT blob_hash, path_name FROM blobs')
+            return cursor.fetchall()
+
+    def get_files_without_blob(self):
+        # Entries stored before the blob store, each owning its file outright
+        with connect(self.db_path) as conn:
+            cursor = conn.cursor()
+            cursor.execute('SELECT client_id, file_name, path_name, verified, checksum FROM files WHERE blob_hash IS NULL')
+            return cursor.fetchall()
+
+    def move_blob(self, blob_hash, path_name):
+        # Records a new location for a blob, in its row and in every file pointing at it
+        def write(cursor):
+            cursor.execute('UPDATE blobs SET path_name = ? WHERE blob_hash = ?', (path_name, blob_hash))
+            cursor.execute('UPDATE files SET path_name = ? WHERE blob_hash = ?', (path_name, blob_hash))
+        return self._writer.execute(write)
+
+    def add_blob(self, client_id, file_name, blob_hash, path_name, size, checksum, verified):
+        # Records a new blob and points the entry at it in one transaction; returns what release_reference left
+        def write(cursor):
+            cursor.execute('''
+                INSERT INTO blobs (blob_hash, path_name, size, checksum, ref_count)
+                VALUES (?, ?, ?, ?, 0)
+            ''', (blob_hash, path_name, size, checksum))
+            return self.link_reference(cursor, client_id, file_name, blob_hash, path_name, verified, checksum)
+        return self._writer.execute(write)
+
+    def link_blob(self, client_id, file_name, blob_hash, checksum, verified, size=None, owned_only=False):
+        """Points the entry at a stored blob in one transaction, if there is a matching one.
+
+        With size the blob must have that size, with owned_only the client must refer to it
+        already. checksum defaults to the blob's. Returns (blob, orphan): the blob's (path_name,
+        ref_count, size, checksum) row, None if nothing was linked, and what release_reference left.
+        """
+        def write(cursor):
+            cursor.execute('SELECT path_name, ref_count, size, checksum FROM blobs WHERE blob_hash = ?', (blob_hash,))
+            blob = cursor.fetchone()
+            if blob is None or (size is not None and blob[2] != size):
+                return None, None
+            if owned_only:
+                cursor.execute('SELECT 1 FROM files WHERE client_id = ? AND blob_hash = ? LIMIT 1', (sqlite3.Binary(client_id), blob_hash))
+                if cursor.fetchone() is None:
+                    return None, None
+            checksum_of_entry = checksum if checksum is not None else blob[3]
+            return blob, self.link_reference(cursor, client_id, file_name, blob_hash, blob[0], verified, checksum_of_entry)
+        return self._writer.execute(write)
+
+    def unlink_file(self, client_id, file_name):
+        # Deletes the entry and releases its reference; returns what release_reference left
+        def write(cursor):
+            cursor.execute('SELECT blob_hash, path_name FROM files WHERE client_id = ? AND file_name = ?',
+                           (sqlite3.Binary(client_id), file_name))
+            previous = cursor.fetchone()
+            if previous is None:
+                return None
             cursor.execute('DELETE FROM files WHERE client_id = ? AND file_name = ?', (sqlite3.Binary(client_id), file_name))
-            conn.commit()
+            return self.release_reference(cursor, *previous)
+        return self._writer.execute(write)
+
+    def link_reference(self, cursor, client_id, file_name, blob_hash, path_name, verified, checksum):
+        # Runs in a writer operation. The new reference is counted before the entry's old one is
+        # released, so re-storing a name with the same content never drops the blob.
+        cursor.execute('SELECT blob_hash, path_name FROM files WHERE client_id = ? AND file_name = ?',
+                       (sqlite3.Binary(client_id), file_name))
+        previous = cursor.fetchone()
+        cursor.execute('''
+            INSERT INTO files (client_id, file_name, path_name, verified, checksum, blob_hash)
+            VALUES (?, ?, ?, ?, ?, ?)
+            ON CONFLICT(client_id, file_name)
+            DO UPDATE SET
+                path_name=excluded.path_name,
+                verified=excluded.verified,
+                checksum=excluded.checksum,
+                blob_hash=excluded.blob_hash;
+        ''', (sqlite3.Binary(client_id), file_name, path_name, int(verified), checksum, blob_hash))
+        cursor.execute('UPDATE blobs SET ref_count = ref_count + 1 WHERE blob_hash = ?', (blob_hash,))
+        return self.release_reference(cursor, *previous) if previous is not None else None
+
+    def release_reference(self, cursor, blob_hash, path_name):
+        # Runs in a writer operation. Returns the (blob_hash, path_name) of a file nothing refers to
+        # anymore, for the caller to delete once committed, or None. Entries stored before blobs
+        # existed own their file outright and come back with a blob_hash of None.
+        if blob_hash is None:
+            return (None, path_name) if path_name else None
+        cursor.execute('UPDATE blobs SET ref_count = ref_count - 1 WHERE blob_hash = ?', (blob_hash,))
+        cursor.execute('SELECT ref_count FROM blobs WHERE blob_hash = ?', (blob_hash,))
+        row = cursor.fetchone()
+        if row is not None and row[0] > 0:
+            return None
+        cursor.execute('DELETE FROM blobs WHERE blob_hash = ?', (blob_hash,))
+        return blob_hash, path_name
+
+    def delete_file(self, client_id, file_name):
+        def write(cursor):
+            cursor.execute('DELETE FROM files WHERE client_id = ? AND file_name = ?', (sqlite3.Binary(client_id), file_name))
+        return self._writer.execute(write)
 
 
 # Usage example (optional)
@@ -0,0 +1,86 @@
+"""Logging of the server that never makes a connection wait for the console.
+
+Handlers format a message in the thread logging it and put it on a bounded queue; one listener
+thread writes the queue to stdout. When the queue is full the message is dropped and counted
+rather than blocking, and the count is reported with the next message that gets through.
+Per-packet messages go through log_packet: all of them at TRACE, one in PACKET_SAMPLE_RATE at
+DEBUG, and they cost one level check when neither is enabled.
+"""
+import itertools
+import logging
+import logging.handlers
+import queue
+import sys
+import threading
+
+TRACE = 5  # Below DEBUG: every frame and chunk
+LOG_QUEUE_SIZE = 8192     # Messages buffered before new ones are dropped
+PACKET_SAMPLE_RATE = 1000  # One in this many per-packet messages is logged at DEBUG
+LEVELS = {'trace': TRACE, 'debug': logging.DEBUG, 'info': logging.INFO, 'warn': logging.WARNING, 'error': logging.ERROR}
+
+logging.addLevelName(TRACE, 'TRACE')
+logger = logging.getLogger('server')
+
+_packet_count = itertools.count()
+_listener = None
+
+
+class DroppingQueueHandler(logging.handlers.QueueHandler):
+    def __init__(self, log_queue):
+        super().__init__(log_queue)
+        self._dropped_lock = threading.Lock()
+        self.dropped = 0
+
+    def handle(self, record):
+        # The queue is thread safe; the handler lock of the base class would serialize every caller
+        if self.filter(record):
+            self.emit(record)
+        return record
+
+    def enqueue(self, record):
+        try:
+            self.queue.put_nowait(record)
+        except queue.Full:
+            with self._dropped_lock:
+                self.dropped += 1
+            return
+        if self.dropped:
+            with self._dropped_lock:
+                dropped, self.dropped = self.dropped, 0
+            if dropped:
+                note = logging.makeLogRecord({'name': logger.name, 'levelno': logging.WARNING, 'levelname': 'WARNING',
+                                              'msg': f"({dropped} log messages dropped, the log queue was full)"})
+                try:
+                    self.queue.put_nowait(note)
+                except queue.Full:
+                    pass
+
+
+def setup_logging(level_name='info'):
+    """Starts the listener thread; call once before serving. Returns the logger."""
+    global _listener
+    logger.setLevel(LEVELS[level_name])
+    logger.propagate = False
+    output = logging.StreamHandler(sys.stdout)
+    output.setFormatter(logging.Formatter('%(message)s'))
+    log_queue = queue.Queue(LOG_QUEUE_SIZE)
+    logger.addHandler(DroppingQueueHandler(log_queue))
+    _listener = logging.handlers.QueueListener(log_queue, output)
+    _listener.start()
+    return logger
+
+
+def stop_logging():
+    """Writes out what is still queued."""
+    global _listener
+    if _listener is not None:
+        _listener.stop()
+        _listener = None
+
+
+def log_packet(message, *args):
+    """Logs a per-packet message: every one at TRACE, a sample of them at DEBUG."""
+    if logger.isEnabledFor(TRACE):
+        logger.log(TRACE, message, *args)
+    elif logger.isEnabledFor(logging.DEBUG) and next(_packet_count) % PACKET_SAMPLE_RATE == 0:
+        logger.debug(message + " (1 in %d sampled)", *args, PACKET_SAMPLE_RATE)
@@ -0,0 +1,105 @@
+"""Moves an existing file store into the sharded layout of BlobStore.
+
+Run it from the server's directory while the server is stopped:
+
+    python migrate_store.py [--dry-run]
+
+Blobs stored flat as files/blobs/<hash> move into their shard directory, and files from
+before the blob store, files/<client ID hex>/<name> owned by a single entry, become blobs
+(identical ones are stored once). Paths are updated in the database as each file moves, so
+the run can be interrupted and started again.
+"""
+import argparse
+import hashlib
+import os
+
+from blob_store import BlobStore, BLOBS_DIR
+from client_handler import INCOMING_DIR
+from database_management import FileDBManager, FILE_DB
+
+FILES_PATH = './files/'
+HASH_BLOCK_SIZE = 1024 * 1024
+
+
+def hash_file(path_name):
+    sha = hashlib.sha256()
+    size = 0
+    with open(path_name, 'rb') as file:
+        while block := file.read(HASH_BLOCK_SIZE):
+            sha.update(block)
+            size += len(block)
+    return sha.hexdigest(), size
+
+
+def shard_blobs(blob_store: BlobStore, file_db_manager: FileDBManager, dry_run):
+    moved = 0
+    for blob_hash, path_name in file_db_manager.get_blobs():
+        target = blob_store.blob_path(blob_hash)
+        if os.path.normpath(path_name) == os.path.normpath(target):
+            continue
+        if dry_run:
+            print(f"Would move {path_name} to {target}")
+            moved += 1
+            continue
+
+        # A run interrupted between the rename and the update finds the blob already in place
+        if os.path.exists(path_name):
+            blob_store.make_shard(target)
+            os.replace(path_name, target)
+        elif not os.path.exists(target):
+            print(f"Blob {blob_hash} is missing from {path_name}, left as it is.")
+            continue
+        file_db_manager.move_blob(blob_hash, target)
+        moved += 1
+    return moved
+
+
+def adopt_files(blob_store: BlobStore, file_db_manager: FileDBManager, dry_run):
+    adopted = 0
+    for client_id, file_name, path_name, verified, checksum in file_db_manager.get_files_without_blob():
+        if not path_name or not os.path.exists(path_name):
+            print(f"{file_name} of client {client_id.hex()} is missing from {path_name}, left as it is.")
+            continue
+        blob_hash, size = hash_file(path_name)
+        if dry_run:
+            print(f"Would store {path_name} as blob {blob_hash}")
+        else:
+            blob_store.adopt(client_id, file_name, path_name, blob_hash, size, checksum, bool(verified))
+        adopted += 1
+    return adopted
+
+
+def remove_empty_directories(files_path):
+    # The per-client directories of the old layout; the blob store's own directories stay
+    keep = {os.path.normpath(os.path.join(files_path, name)) for name in (BLOBS_DIR, INCOMING_DIR)}
+    for directory, _, _ in os.walk(files_path, topdown=False):
+        directory = os.path.normpath(directory)
+        if directory == os.path.normpath(files_path) or any(directory == k or directory.startswith(k + os.sep) for k in keep):
+            continue
+        try:
+            os.rmdir(directory)
+        except OSError:
+            pass  # Not empty
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Move the server's file store into the sharded blob layout")
+    parser.add_argument('--dry-run', action='store_true', help="only print what would be moved")
+    args = parser.parse_args()
+
+    file_db_manager = FileDBManager(FILE_DB)
+    blob_store = BlobStore(FILES_PATH, file_db_manager)
+
+    # Step 1: Flat blobs into their shards
+    moved = shard_blobs(blob_store, file_db_manager, args.dry_run)
+    # Step 2: Files from before the blob store into blobs
+    adopted = adopt_files(blob_store, file_db_manager, args.dry_run)
+    if not args.dry_run:
+        remove_empty_directories(FILES_PATH)
+
+    verb = "Would move" if args.dry_run else "Moved"
+    print(f"{verb} {moved} blobs into shards and {adopted} older files into the blob store.")
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,139 @@
+// crypto._native: C++ versions of the server's CRC and AES-CBC decrypt. The CRC is the
+// client's CrcKernel.cpp, compiled in as is, so both sides share one implementation. Every
+// function releases the GIL while it works, so one large upload being verified no longer
+// holds up the other connections' threads.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <openssl/evp.h>
+#include <climits>
+#include <algorithm>
+#include "CrcKernel.h"
+
+constexpr Py_ssize_t AES_BLOCK = 16;
+// EVP_DecryptUpdate takes an int length, so larger buffers are fed in whole blocks up to this
+constexpr Py_ssize_t DECRYPT_PIECE = INT_MAX - INT_MAX % AES_BLOCK;
+
+// crc_update(state, data) -> state, the streaming form of memcrc; start from 0
+static PyObject* crcUpdate(PyObject*, PyObject* args) {
+    unsigned long state;
+    Py_buffer data;
+    if (!PyArg_ParseTuple(args, "ky*", &state, &data))
+        return nullptr;
+
+    Py_BEGIN_ALLOW_THREADS
+    state = memcrcUpdate(state, static_cast<const char*>(data.buf), static_cast<size_t>(data.len));
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&data);
+    return PyLong_FromUnsignedLong(state);
+}
+
+// crc_final(state, length) -> checksum, appends the length like cksum and complements
+static PyObject* crcFinal(PyObject*, PyObject* args) {
+    unsigned long state;
+    unsigned long long length;
+    if (!PyArg_ParseTuple(args, "kK", &state, &length))
+        return nullptr;
+    return PyLong_FromUnsignedLong(memcrcFinal(state, static_cast<size_t>(length)));
+}
+
+// memcrc(data) -> checksum
+static PyObject* memcrcWhole(PyObject*, PyObject* args) {
+    Py_buffer data;
+    if (!PyArg_ParseTuple(args, "y*", &data))
+        return nullptr;
+
+    unsigned long checksum;
+    Py_BEGIN_ALLOW_THREADS
+    size_t length = static_cast<size_t>(data.len);
+    checksum = memcrcFinal(memcrcUpdate(0, static_cast<const char*>(data.buf), length), length);
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release(&data);
+    return PyLong_FromUnsignedLong(checksum);
+}
+
+// Same cipher selection as pycryptodome's AES.new: by key length
+static const EVP_CIPHER* cbcCipher(Py_ssize_t keyLength) {
+    switch (keyLength) {
+    case 16:
+        return EVP_aes_128_cbc();
+    case 24:
+        return EVP_aes_192_cbc();
+    case 32:
+        return EVP_aes_256_cbc();
+    }
+    return nullptr;
+}
+
+// aes_cbc_decrypt(data, key) -> bytes; zero IV and PKCS7 padding, as crypto.aes.decrypt
+static PyObject* aesCbcDecrypt(PyObject*, PyObject* args) {
+    Py_buffer data;
+    Py_buffer key;
+    if (!PyArg_ParseTuple(args, "y*y*", &data, &key))
+        return nullptr;
+
+    PyObject* result = nullptr;
+    const EVP_CIPHER* cipher = cbcCipher(key.len);
+    if (cipher == nullptr) {
+        PyErr_SetString(PyExc_ValueError, "Incorrect AES key length");
+    }
+    else if (data.len == 0 or data.len % AES_BLOCK != 0) {
+        PyErr_SetString(PyExc_ValueError, "Data must be padded to 16 byte boundary in CBC mode");
+    }
+    else {
+        // The output is never longer than the input; the buffer is sized before the GIL is let go
+        result = PyBytes_FromStringAndSize(nullptr, data.len + AES_BLOCK);
+    }
+
+    if (result != nullptr) {
+        unsigned char* out = reinterpret_cast<unsigned char*>(PyBytes_AS_STRING(result));
+        static const unsigned char iv[AES_BLOCK] = { 0 };
+        const unsigned char* in = static_cast<const unsigned char*>(data.buf);
+        Py_ssize_t written = 0;
+        int finalWritten = 0;
+        bool ok;
+
+        Py_BEGIN_ALLOW_THREADS
+        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+        ok = ctx != nullptr
+            and EVP_DecryptInit_ex(ctx, cipher, nullptr, static_cast<const unsigned char*>(key.buf), iv) == 1;
+        for (Py_ssize_t offset = 0; ok and offset < data.len; offset += DECRYPT_PIECE) {
+            int pieceWritten = 0;
+            int pieceLength = static_cast<int>(std::min(DECRYPT_PIECE, data.len - offset));
+            ok = EVP_DecryptUpdate(ctx, out + written, &pieceWritten, in + offset, pieceLength) == 1;
+            written += pieceWritten;
+        }
+        ok = ok and EVP_DecryptFinal_ex(ctx, out + written, &finalWritten) == 1;
+        EVP_CIPHER_CTX_free(ctx);
+        Py_END_ALLOW_THREADS
+
+        if (!ok) {
+            Py_CLEAR(result);
+            PyErr_SetString(PyExc_ValueError, "Padding is incorrect.");
+        }
+        else if (_PyBytes_Resize(&result, written + finalWritten) != 0) {
+            result = nullptr;
+        }
+    }
+
+    PyBuffer_Release(&data);
+    PyBuffer_Release(&key);
+    return result;
+}
+
+static PyMethodDef nativeMethods[] = {
+    { "crc_update", crcUpdate, METH_VARARGS, "crc_update(state, data) -> state" },
+    { "crc_final", crcFinal, METH_VARARGS, "crc_final(state, length) -> checksum" },
+    { "memcrc", memcrcWhole, METH_VARARGS, "memcrc(data) -> checksum" },
+    { "aes_cbc_decrypt", aesCbcDecrypt, METH_VARARGS, "aes_cbc_decrypt(data, key) -> plaintext" },
+    { nullptr, nullptr, 0, nullptr }
+};
+
+static struct PyModuleDef nativeModule = {
+    PyModuleDef_HEAD_INIT, "_native", "Native CRC and AES-CBC decrypt for the file server", -1, nativeMethods
+};
+
+PyMODINIT_FUNC PyInit__native(void) {
+    return PyModule_Create(&nativeModule);
+}
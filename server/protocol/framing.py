@@ -0,0 +1,73 @@
+import struct
+
+from protocol.requests import RequestHeader, CLIENT_ID_SIZE
+from tracing import span
+
+
+REQUEST_HEADER_SIZE = CLIENT_ID_SIZE + 7
+RECEIVE_BUFFER_SIZE = 256 * 1024  # Smallest receive buffer; one recv usually brings several small frames
+
+
+class FrameTooLarge(ValueError):
+    pass
+
+
+class FrameReader:
+    """Cuts the byte stream of one connection into request frames.
+
+    Bytes are received with recv_into straight into one preallocated buffer. A recv may end in
+    the middle of a header or payload, or carry several frames at once; whatever follows a
+    complete frame stays buffered for the next call, so frames are never split or merged
+    wrongly. The buffer is allocated once and only grows when a single frame is larger than it,
+    up to max_payload.
+    """
+
+    def __init__(self, sock, max_payload):
+        self._socket = sock
+        self._max_payload = max_payload
+        self._buffer = bytearray()  # Allocated on the first read
+        self._start = 0  # First byte not handed out yet
+        self._end = 0    # One past the last received byte
+
+    def read_frame(self):
+        """Returns (header, payload bytes) of the next request, or None once the client closed the connection."""
+        while True:
+            # Step 1: Hand out a frame if one is complete in the buffer
+            available = self._end - self._start
+            if available >= REQUEST_HEADER_SIZE:
+                payload_size, = struct.unpack_from('<I', self._buffer, self._start + CLIENT_ID_SIZE + 3)
+                if payload_size > self._max_payload:
+                    raise FrameTooLarge(f"Client announced a {payload_size} byte payload, over the {self._max_payload} byte limit")
+                frame_size = REQUEST_HEADER_SIZE + payload_size
+                if available >= frame_size:
+                    header = RequestHeader.deserialize_header(bytes(self._buffer[self._start:self._start + REQUEST_HEADER_SIZE]))
+                    payload = bytes(self._buffer[self._start + REQUEST_HEADER_SIZE:self._start + frame_size])
+                    self._start += frame_size
+                    return header, payload
+                self.reserve(frame_size)
+            else:
+                self.reserve(REQUEST_HEADER_SIZE)
+
+            # Step 2: Receive more, directly behind what is buffered
+            with span('recv') as recv:
+                received = self._socket.recv_into(memoryview(self._buffer)[self._end:])
+                recv.set(bytes=received)
+            if received == 0:
+                return None
+            self._end += received
+
+    def reserve(self, frame_size):
+        # Moves the partial frame to the front and grows the buffer if the frame can not fit otherwise
+        if self._start == self._end:
+            self._start = self._end = 0
+        if self._start + frame_size <= len(self._buffer) and self._end < len(self._buffer):
+            return
+        available = self._end - self._start
+        if frame_size > len(self._buffer):
+            buffer = bytearray(max(frame_size, RECEIVE_BUFFER_SIZE))
+            buffer[:available] = self._buffer[self._start:self._end]
+            self._buffer = buffer
+        else:
+            self._buffer[:available] = self._buffer[self._start:self._end]
+        self._start = 0
+        self._end = available
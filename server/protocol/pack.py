@@ -0,0 +1,40 @@
+import struct
+
+# Plaintext layout of a SEND_PACK upload, one entry per file:
+#   name length (2 bytes) | name | file size (4 bytes) | CRC (4 bytes) | file data
+ENTRY_HEADER_SIZE = 2
+ENTRY_FIELDS_SIZE = 8
+
+
+class PackEntry:
+    def __init__(self, name, checksum, content):
+        self._name = name
+        self._checksum = checksum
+        self._content = content
+
+
+def parse_pack(data: bytes, entry_count: int):
+    entries = []
+    offset = 0
+    view = memoryview(data)
+    for _ in range(entry_count):
+        if offset + ENTRY_HEADER_SIZE > len(data):
+            raise ValueError("Pack truncated in entry name length")
+        name_length, = struct.unpack_from('<H', data, offset)
+        offset += ENTRY_HEADER_SIZE
+
+        if offset + name_length + ENTRY_FIELDS_SIZE > len(data):
+            raise ValueError("Pack truncated in entry header")
+        name = bytes(view[offset:offset + name_length]).decode('utf-8')
+        offset += name_length
+        size, checksum = struct.unpack_from('<II', data, offset)
+        offset += ENTRY_FIELDS_SIZE
+
+        if offset + size > len(data):
+            raise ValueError(f"Pack truncated in data of {name}")
+        entries.append(PackEntry(name, checksum, bytes(view[offset:offset + size])))
+        offset += size
+
+    if offset != len(data):
+        raise ValueError("Trailing data after the last pack entry")
+    return entries
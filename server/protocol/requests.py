@@ -6,6 +6,7 @@ from abc import ABC, abstractmethod
 CLIENT_ID_SIZE = 16
 NAME_SIZE = 255
 KEY_SIZE = 160
+SHA256_SIZE = 32
 
 
 class RequestCode(enum.Enum):
@@ -13,6 +14,13 @@ class RequestCode(enum.Enum):
     SEND_RSA_PUBLIC_KEY = 826
     LOGIN = 827
     SEND_FILE = 828
+    SEND_PACK = 829
+    SEND_FILE_CHUNK = 830
+    RESEND_CHUNK = 831
+    NEGOTIATE_CHUNKS = 832
+    REQUEST_FILE_INFO = 833
+    READ_RANGE = 834
+    UPLOAD_PRECHECK = 835
 
     CRC_OK = 900
     CRC_FAIL_TRY_AGAIN = 901
@@ -111,6 +119,107 @@ class SendFilePayload(RequestPayload):
         return SendFilePayload(content_size, original_file_size, packet_number, total_packets, file_name, message_content)
 
 
+class SendPackPayload(RequestPayload):
+    def __init__(self, content_size, entry_count, packet_number, total_packets, message_content):
+        self._content_size = content_size
+        self._entry_count = entry_count
+        self._packet_number = packet_number
+        self._total_packets = total_packets
+        self._message_content = message_content
+
+    @staticmethod
+    def deserialize_payload(data: bytes):
+        content_size, entry_count, packet_number, total_packets = struct.unpack('<IIHH', data[:12])
+        message_content = data[12:]
+        return SendPackPayload(content_size, entry_count, packet_number, total_packets, message_content)
+
+
+# Flags of a SEND_FILE_CHUNK / RESEND_CHUNK frame
+CHUNK_FLAG_LAST = 0x01
+CHUNK_FLAG_ACK_REQUESTED = 0x02
+
+
+# Used by both SEND_FILE_CHUNK and RESEND_CHUNK
+class SendFileChunkPayload(RequestPayload):
+    HEADER_FORMAT = '<IQQQIB'
+    HEADER_SIZE = struct.calcsize(HEADER_FORMAT)
+
+    def __init__(self, content_size, original_file_size, encrypted_size, offset, chunk_checksum, flags, file_name, message_content):
+        self._content_size = content_size
+        self._original_file_size = original_file_size
+        self._encrypted_size = encrypted_size
+        self._offset = offset
+        self._chunk_checksum = chunk_checksum
+        self._last = bool(flags & CHUNK_FLAG_LAST)
+        self._ack_requested = bool(flags & CHUNK_FLAG_ACK_REQUESTED)
+        self._file_name = file_name
+        self._message_content = message_content
+
+    @staticmethod
+    def deserialize_payload(data: bytes):
+        size = SendFileChunkPayload.HEADER_SIZE
+        content_size, original_file_size, encrypted_size, offset, chunk_checksum, flags = \
+            struct.unpack(SendFileChunkPayload.HEADER_FORMAT, data[:size])
+        file_name = data[size:size + NAME_SIZE].decode('utf-8').strip('\x00')
+        message_content = data[size + NAME_SIZE:]
+        return SendFileChunkPayload(content_size, original_file_size, encrypted_size, offset, chunk_checksum, flags,
+                                    file_name, message_content)
+
+
+class NegotiateChunksPayload(RequestPayload):
+    def __init__(self, min_chunk_size, max_chunk_size, hash_algorithms):
+        self._min_chunk_size = min_chunk_size
+        self._max_chunk_size = max_chunk_size
+        self._hash_algorithms = hash_algorithms  # None from clients that only know the CRC
+
+    @staticmethod
+    def deserialize_payload(data: bytes):
+        min_chunk_size, max_chunk_size = struct.unpack('<II', data[:8])
+        hash_algorithms = None
+        if len(data) > 8:
+            count = data[8]
+            hash_algorithms = list(data[9:9 + count])
+        return NegotiateChunksPayload(min_chunk_size, max_chunk_size, hash_algorithms)
+
+
+class UploadPrecheckPayload(RequestPayload):
+    def __init__(self, file_size, checksum, sha256, file_name):
+        self._file_size = file_size
+        self._checksum = checksum
+        self._sha256 = sha256
+        self._file_name = file_name
+
+    @staticmethod
+    def deserialize_payload(data: bytes):
+        file_size, checksum = struct.unpack('<QI', data[:12])
+        sha256 = data[12:12 + SHA256_SIZE]
+        file_name = data[12 + SHA256_SIZE:12 + SHA256_SIZE + NAME_SIZE].decode('utf-8').strip('\x00')
+        return UploadPrecheckPayload(file_size, checksum, sha256, file_name)
+
+
+class RequestFileInfoPayload(RequestPayload):
+    def __init__(self, file_name):
+        self._file_name = file_name
+
+    @staticmethod
+    def deserialize_payload(data: bytes):
+        file_name = data[:NAME_SIZE].decode('utf-8').strip('\x00')
+        return RequestFileInfoPayload(file_name)
+
+
+class ReadRangePayload(RequestPayload):
+    def __init__(self, offset, length, file_name):
+        self._offset = offset
+        self._length = length
+        self._file_name = file_name
+
+    @staticmethod
+    def deserialize_payload(data: bytes):
+        offset, length = struct.unpack('<QI', data[:12])
+        file_name = data[12:12 + NAME_SIZE].decode('utf-8').strip('\x00')
+        return ReadRangePayload(offset, length, file_name)
+
+
 class ChecksumCorrectPayload(RequestPayload):
     def __init__(self, name):
         self._name = name
@@ -152,6 +261,18 @@ class RequestPayloadFactory:
             return LoginPayload.deserialize_payload(data)
         elif code == RequestCode.SEND_FILE.value:  # Send file packet code
             return SendFilePayload.deserialize_payload(data)
+        elif code == RequestCode.SEND_PACK.value:  # Send pack packet code
+            return SendPackPayload.deserialize_payload(data)
+        elif code in (RequestCode.SEND_FILE_CHUNK.value, RequestCode.RESEND_CHUNK.value):  # File chunk packet codes
+            return SendFileChunkPayload.deserialize_payload(data)
+        elif code == RequestCode.NEGOTIATE_CHUNKS.value:  # Chunk size negotiation packet code
+            return NegotiateChunksPayload.deserialize_payload(data)
+        elif code == RequestCode.UPLOAD_PRECHECK.value:  # Upload precheck packet code
+            return UploadPrecheckPayload.deserialize_payload(data)
+        elif code == RequestCode.REQUEST_FILE_INFO.value:  # File info packet code
+            return RequestFileInfoPayload.deserialize_payload(data)
+        elif code == RequestCode.READ_RANGE.value:  # Read range packet code
+            return ReadRangePayload.deserialize_payload(data)
         elif code == RequestCode.CRC_OK.value:  # Checksum correct packet code
             return ChecksumCorrectPayload.deserialize_payload(data)
         elif code == RequestCode.CRC_FAIL_TRY_AGAIN.value:  # Checksum failed packet code
@@ -12,6 +12,20 @@ class ResponseCode(enum.Enum):
     LOGIN_OK_SEND_AES = 1605
     LOGIN_FAIL = 1606
     GENERAL_ERROR = 1607
+    PACK_OK = 1608
+    CHUNKS_BAD = 1609
+    CHUNK_BOUNDS = 1610
+    CHUNK_ACK = 1611
+    FILE_INFO = 1612
+    FILE_RANGE = 1613
+    UPLOAD_NEEDED = 1614
+    FILE_HASH_OK = 1615
+
+# Why one file of a pack was rejected
+class PackFailureReason(enum.Enum):
+    CHECKSUM_MISMATCH = 1
+    INVALID_NAME = 2
+    STORAGE_ERROR = 3
 
 # Header class for packing the common header part
 class ResponseHeader:
@@ -76,6 +90,28 @@ class FileOkPayload(ResponsePayload):
             struct.pack('<I', self.checksum)  # 4 bytes checksum
         )
 
+# File Hash OK Payload: client ID (16 bytes), content size (4 bytes), file name (255 bytes),
+# hash algorithm (1 byte), hash (8 bytes)
+class FileHashOkPayload(ResponsePayload):
+    def __init__(self, client_id: bytes, content_size: int, file_name: str, hash_algorithm: int, file_hash: int):
+        if len(client_id) != 16:
+            raise ValueError("client_id must be 16 bytes")
+        if len(file_name) > 255:
+            raise ValueError("file_name must not exceed 255 bytes")
+        self.client_id = client_id
+        self.content_size = content_size
+        self.file_name = file_name.ljust(255, '\x00')  # Pad to 255 bytes
+        self.hash_algorithm = hash_algorithm
+        self.file_hash = file_hash
+
+    def serialize(self):
+        return (
+            self.client_id +
+            struct.pack('<I', self.content_size) +
+            self.file_name.encode('utf-8') +
+            struct.pack('<BQ', self.hash_algorithm, self.file_hash)
+        )
+
 # Message OK Payload: client ID (16 bytes)
 class MessageOkPayload(ResponsePayload):
     def __init__(self, client_id: bytes):
@@ -107,6 +143,99 @@ class LoginFailPayload(ResponsePayload):
     def serialize(self):
         return self.client_id
 
+# Pack OK Payload: client ID (16 bytes), stored count (4 bytes), failure count (4 bytes),
+# then per failure: name length (2 bytes), name, reason (1 byte)
+class PackOkPayload(ResponsePayload):
+    def __init__(self, client_id: bytes, stored_count: int, failures):
+        if len(client_id) != 16:
+            raise ValueError("client_id must be 16 bytes")
+        self.client_id = client_id
+        self.stored_count = stored_count
+        self.failures = failures  # list of (file name, PackFailureReason)
+
+    def serialize(self):
+        serialized = self.client_id + struct.pack('<II', self.stored_count, len(self.failures))
+        for file_name, reason in self.failures:
+            encoded_name = file_name.encode('utf-8')
+            serialized += struct.pack('<H', len(encoded_name)) + encoded_name + struct.pack('<B', reason.value)
+        return serialized
+
+# Chunks Bad Payload: client ID (16 bytes), count (4 bytes), then offset (8 bytes) and length (4 bytes) per chunk
+class ChunksBadPayload(ResponsePayload):
+    def __init__(self, client_id: bytes, chunks):
+        if len(client_id) != 16:
+            raise ValueError("client_id must be 16 bytes")
+        self.client_id = client_id
+        self.chunks = chunks  # list of (offset, length)
+
+    def serialize(self):
+        serialized = self.client_id + struct.pack('<I', len(self.chunks))
+        for offset, length in self.chunks:
+            serialized += struct.pack('<QI', offset, length)
+        return serialized
+
+# Chunk Bounds Payload: client ID (16 bytes), min chunk size (4 bytes), max chunk size (4 bytes)
+class ChunkBoundsPayload(ResponsePayload):
+    def __init__(self, client_id: bytes, min_chunk_size: int, max_chunk_size: int, hash_algorithm=None):
+        if len(client_id) != 16:
+            raise ValueError("client_id must be 16 bytes")
+        self.client_id = client_id
+        self.min_chunk_size = min_chunk_size
+        self.max_chunk_size = max_chunk_size
+        self.hash_algorithm = hash_algorithm  # Only answered to clients that offered hashes
+
+    def serialize(self):
+        data = self.client_id + struct.pack('<II', self.min_chunk_size, self.max_chunk_size)
+        if self.hash_algorithm is not None:
+            data += struct.pack('<B', self.hash_algorithm)
+        return data
+
+# Chunk Ack Payload: client ID (16 bytes), offset of the acknowledged chunk (8 bytes)
+class ChunkAckPayload(ResponsePayload):
+    def __init__(self, client_id: bytes, offset: int):
+        if len(client_id) != 16:
+            raise ValueError("client_id must be 16 bytes")
+        self.client_id = client_id
+        self.offset = offset
+
+    def serialize(self):
+        return self.client_id + struct.pack('<Q', self.offset)
+
+# File Info Payload: client ID (16 bytes), file size (8 bytes), checksum of the stored file (4 bytes)
+class FileInfoPayload(ResponsePayload):
+    def __init__(self, client_id: bytes, file_size: int, checksum: int):
+        if len(client_id) != 16:
+            raise ValueError("client_id must be 16 bytes")
+        self.client_id = client_id
+        self.file_size = file_size
+        self.checksum = checksum
+
+    def serialize(self):
+        return self.client_id + struct.pack('<QI', self.file_size, self.checksum)
+
+# File Range Payload: client ID (16 bytes), offset (8 bytes), plaintext length (4 bytes), encrypted range (dynamic size)
+class FileRangePayload(ResponsePayload):
+    def __init__(self, client_id: bytes, offset: int, length: int, content: bytes):
+        if len(client_id) != 16:
+            raise ValueError("client_id must be 16 bytes")
+        self.client_id = client_id
+        self.offset = offset
+        self.length = length
+        self.content = content
+
+    def serialize(self):
+        return self.client_id + struct.pack('<QI', self.offset, self.length) + self.content
+
+# Upload Needed Payload: client ID (16 bytes)
+class UploadNeededPayload(ResponsePayload):
+    def __init__(self, client_id: bytes):
+        if len(client_id) != 16:
+            raise ValueError("client_id must be 16 bytes")
+        self.client_id = client_id
+
+    def serialize(self):
+        return self.client_id
+
 # General Error Payload: empty payload
 class GeneralErrorPayload(ResponsePayload):
     def serialize(self):
@@ -1,37 +1,50 @@
 from client_handler import ClientHandler
+import argparse
+import os
 import socket
 import threading
-from database_management import ClientDBManager, FileDBManager, CLIENT_DB, FILE_DB
+from database_management import ClientDBManager, FileDBManager, CLIENT_DB, FILE_DB, close_connections
+from blob_store import BlobStore
+from group_sync import GroupSync
+from log import logger, setup_logging, stop_logging, LEVELS
+from tracing import start_tracing, stop_tracing
 
 SERVER_HOST = '127.0.0.1'  # Localhost
 SERVER_PORT = 12345        # Arbitrary non-privileged port
-MAX_CONNECTIONS = 5
+LISTEN_BACKLOG = 4096     # Pending connections the kernel queues before accept; capped by somaxconn
 
 class ThreadedServer:
-    def __init__(self, host, port):
+    def __init__(self, host, port, backlog=LISTEN_BACKLOG, durable=False):
         self.server_host = host
         self.server_port = port
+        self.backlog = backlog
         self.server_socket = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
-        self.client_db_manager = ClientDBManager(CLIENT_DB)  # Initialize the Client DB Manager
-        self.file_db_manager = FileDBManager(FILE_DB)  # Initialize the File DB Manager
+        if os.name != 'nt':  # Restart while the old connections are in TIME_WAIT; on Windows this would allow two servers on one port
+            self.server_socket.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self.client_db_manager = ClientDBManager(CLIENT_DB, durable)  # Initialize the Client DB Manager
+        self.file_db_manager = FileDBManager(FILE_DB, durable)  # Initialize the File DB Manager
         self.files_path = './files/'  # Directory to store files
+        group_sync = GroupSync() if durable else None  # fsyncs for all connections at once, see GroupSync
+        self.blob_store = BlobStore(self.files_path, self.file_db_manager, group_sync)  # Shared, so identical uploads are stored once
 
     def start_server(self):
         # Bind the server to the address and start listening for connections
         self.server_socket.bind((self.server_host, self.server_port))
-        self.server_socket.listen(MAX_CONNECTIONS)
-        print(f"Server listening on {self.server_host}:{self.server_port}")
+        self.server_socket.listen(self.backlog)
+        logger.info(f"Server listening on {self.server_host}:{self.server_port}")
 
         while True:
             try:
                 client_socket, client_address = self.server_socket.accept()
-                print(f"Connection established with {client_address}")
+                logger.info(f"Connection established with {client_address}")
+                # Responses are small and answer a waiting client, do not hold them back (asyncio does the same)
+                client_socket.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
                 # Create a new thread for each client
-                client_handler = ClientHandler(client_socket, self.client_db_manager, self.file_db_manager, self.files_path)
-                client_thread = threading.Thread(target=self.handle_client, args=(client_handler,))
+                client_handler = ClientHandler(client_socket, self.client_db_manager, self.file_db_manager, self.files_path, self.blob_store)
+                client_thread = threading.Thread(target=self.handle_client, args=(client_handler,), name=f"connection {client_address[0]}:{client_address[1]}")
                 client_thread.start()
             except KeyboardInterrupt:
-                print("Server is shutting down...")
+                logger.info("Server is shutting down...")
                 self.server_socket.close()
                 break
 
@@ -45,11 +58,40 @@ class ThreadedServer:
                 if result == "disconnect" or result == "error":  
                     return
         except Exception as e:
-            print(f"Error handling client: {e}")
+            logger.error(f"Error handling client: {e}")
         finally:
+            client_handler.close()
             client_handler._client_socket.close()  # Close the client's socket after handling
-            print("Client connection closed")
+            close_connections()  # This thread's database connections end with it
+            logger.info("Client connection closed")
 
 if __name__ == '__main__':
-    server = ThreadedServer(SERVER_HOST, SERVER_PORT)
-    server.start_server()
+    parser = argparse.ArgumentParser(description="Encrypted file backup server")
+    parser.add_argument('--async', dest='use_async', action='store_true',
+                        help="serve all connections from one event loop instead of a thread each")
+    parser.add_argument('--backlog', type=int, default=LISTEN_BACKLOG, help="listen backlog")
+    parser.add_argument('--durable', action='store_true',
+                        help="only confirm uploads once their data, directory entries and rows are on disk")
+    parser.add_argument('--workers', type=int, default=os.cpu_count() or 4,
+                        help="threads handling frames in --async mode")
+    parser.add_argument('--log-level', choices=LEVELS, default='info',
+                        help="least severe message printed; trace prints every frame, debug a sample of them")
+    parser.add_argument('--trace', metavar='FILE',
+                        help="record a timeline of the handler threads into FILE as Chrome trace-event JSON, written on shutdown")
+    args = parser.parse_args()
+    setup_logging(args.log_level)
+    if args.trace:
+        start_tracing(args.trace)
+
+    if args.use_async:
+        from async_server import AsyncServer
+        server = AsyncServer(SERVER_HOST, SERVER_PORT, args.backlog, args.workers, args.durable)
+    else:
+        server = ThreadedServer(SERVER_HOST, SERVER_PORT, args.backlog, args.durable)
+    try:
+        server.start_server()
+    finally:
+        traced = stop_tracing()
+        if traced is not None:
+            logger.info(f"Trace of {traced[0]} spans written to {args.trace}" + (f", {traced[1]} dropped." if traced[1] else "."))
+        stop_logging()
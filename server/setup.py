@@ -0,0 +1,31 @@
+"""
+Builds crypto._native, the optional C++ acceleration of crypto.checksum and crypto.aes.
+From this directory:
+
+    python setup.py build_ext --inplace
+
+The CRC is compiled from the client's CrcKernel.cpp and AES comes from OpenSSL's libcrypto.
+Without the module the server runs on the pure Python code, only slower.
+"""
+import sys
+
+from setuptools import setup, Extension
+
+
+if sys.platform == 'win32':
+    compile_args = ['/std:c++17', '/O2']
+    libraries = ['libcrypto']
+else:
+    compile_args = ['-std=c++17', '-O2']
+    libraries = ['crypto']
+
+native = Extension(
+    'crypto._native',
+    sources=['native/fastcrypto.cpp', '../client/CrcKernel.cpp'],
+    include_dirs=['../client'],
+    libraries=libraries,
+    extra_compile_args=compile_args,
+    language='c++',
+)
+
+setup(name='file-server-native', version='1.0', ext_modules=[native])
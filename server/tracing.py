@@ -0,0 +1,164 @@
+"""Opt-in timeline of where the server's threads spend their time, as Chrome trace-event JSON.
+
+Code marks a stretch of work with `with span('decrypt', bytes=n):`. Each finished span is
+appended to a list owned by the thread that ran it, so threads never contend over the trace.
+The spans of connection threads that ended move into one list shared by all of them and capped
+at RETIRED_EVENT_LIMIT, so a long trace of the threaded server stays bounded. stop_tracing()
+collects every list and writes one file that loads in chrome://tracing or ui.perfetto.dev. Timestamps are wall clock
+microseconds, the client's trace (--trace=<file>) uses the same base, so both can be loaded
+together. While no trace is running span() returns a shared do-nothing context manager.
+"""
+import json
+import os
+import threading
+import time
+
+THREAD_EVENT_LIMIT = 1 << 20   # Spans kept per thread, later ones are counted and dropped
+RETIRED_EVENT_LIMIT = 1 << 22  # Spans kept from all threads that ended during a trace, together
+
+_enabled = False
+_path = None
+_clock_offset = 0  # time.time_ns() - time.perf_counter_ns() when the trace started
+_local = threading.local()
+_buffers = []  # Every thread's buffer; those of ended threads until the next thread starts one
+_retired = []  # (tid, name, events) of threads that ended, RETIRED_EVENT_LIMIT events in all at most
+_retired_events = 0
+_retired_dropped = 0
+_buffers_lock = threading.Lock()
+
+
+class _ThreadBuffer:
+    __slots__ = ('thread', 'tid', 'name', 'events', 'dropped')
+
+    def __init__(self):
+        thread = threading.current_thread()
+        self.thread = thread
+        self.tid = thread.native_id
+        self.name = thread.name
+        self.events = []
+        self.dropped = 0
+
+
+def _thread_buffer():
+    buffer = getattr(_local, 'buffer', None)
+    if buffer is None:
+        buffer = _local.buffer = _ThreadBuffer()
+        with _buffers_lock:
+            _retire_ended()
+            _buffers.append(buffer)
+    return buffer
+
+
+def _retire_ended():
+    # Caller holds _buffers_lock. Moves the spans of threads that ended into _retired, as far as it has room.
+    global _retired_events, _retired_dropped
+    alive = []
+    for buffer in _buffers:
+        if buffer.thread.is_alive():
+            alive.append(buffer)
+            continue
+        if not _enabled:
+            continue  # Finished after the last trace was written
+        kept = buffer.events[:RETIRED_EVENT_LIMIT - _retired_events]
+        if kept:
+            _retired.append((buffer.tid, buffer.name, kept))
+            _retired_events += len(kept)
+        _retired_dropped += buffer.dropped + len(buffer.events) - len(kept)
+    _buffers[:] = alive
+
+
+class _NoSpan:
+    __slots__ = ()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        return False
+
+    def set(self, **args):
+        pass
+
+
+_NO_SPAN = _NoSpan()
+
+
+class _Span:
+    __slots__ = ('_name', '_args', '_start')
+
+    def __init__(self, name, args):
+        self._name = name
+        self._args = args
+
+    def __enter__(self):
+        self._start = time.perf_counter_ns()
+        return self
+
+    def __exit__(self, *exc):
+        end = time.perf_counter_ns()
+        buffer = _thread_buffer()
+        if len(buffer.events) < THREAD_EVENT_LIMIT:
+            buffer.events.append((self._name, self._start, end, self._args))
+        else:
+            buffer.dropped += 1
+        return False
+
+    def set(self, **args):
+        """Adds args known only once the work is done, e.g. the bytes a recv returned."""
+        self._args.update(args)
+
+
+def span(name, **args):
+    """Context manager recording one span of the calling thread; args (e.g. bytes=n) show up in the viewer."""
+    if not _enabled:
+        return _NO_SPAN
+    return _Span(name, args)
+
+
+def start_tracing(path):
+    global _enabled, _path, _clock_offset
+    _path = path
+    _clock_offset = time.time_ns() - time.perf_counter_ns()
+    _enabled = True
+
+
+def stop_tracing():
+    """Stops recording and writes the trace; returns (spans written, spans dropped), or None if no trace was running."""
+    global _enabled, _retired_events, _retired_dropped
+    if not _enabled:
+        return None
+    pid = os.getpid()
+    with _buffers_lock:
+        _retire_ended()
+        _enabled = False
+        buffers = list(_buffers)
+        threads = list(_retired)
+        dropped = _retired_dropped
+        _retired.clear()
+        _retired_events = _retired_dropped = 0
+    for buffer in buffers:
+        events, buffer.events = buffer.events, []  # Threads still running start a fresh list
+        threads.append((buffer.tid, buffer.name, events))
+        dropped += buffer.dropped
+        buffer.dropped = 0
+
+    written = 0
+    with open(_path, 'w') as out:
+        out.write('{"traceEvents":[\n')
+        out.write(json.dumps({'ph': 'M', 'name': 'process_name', 'pid': pid, 'tid': 0, 'args': {'name': 'server'}}))
+        for tid, thread_name, events in threads:
+            if not events:
+                continue
+            out.write(',\n' + json.dumps({'ph': 'M', 'name': 'thread_name', 'pid': pid, 'tid': tid, 'args': {'name': thread_name}}))
+            for name, start, end, args in events:
+                event = {'ph': 'X', 'name': name, 'pid': pid, 'tid': tid,
+                         'ts': (start + _clock_offset) / 1000, 'dur': (end - start) / 1000}
+                if args:
+                    event['args'] = args
+                out.write(',\n' + json.dumps(event))
+            written += len(events)
+        out.write('\n],"displayTimeUnit":"ms"}\n')
+    # Buffers of connection threads that ended are not needed for another trace
+    with _buffers_lock:
+        _buffers[:] = [buffer for buffer in _buffers if buffer.thread.is_alive()]
+    return written, dropped